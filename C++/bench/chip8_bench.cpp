@@ -0,0 +1,473 @@
+#include "../lib/chip8.hpp"
+#include "../lib/tela.hpp"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+
+// Microbenchmarks do núcleo: cada manipulador de instrução isolado, a conversão da tela para
+// RGBA, execuções completas das ROMs de c8games por um número fixo de frames e milhares de VMs
+// da mesma ROM intercaladas.
+//
+// Para que os números sejam comparáveis entre commits, cada medida calibra o número de
+// iterações até ~20 ms e repete REPETICOES vezes; o relatório usa o mínimo, que descarta
+// interrupções e migrações de CPU (ruído só soma tempo). A saída é "<nome> <ns> <unidade>" por
+// linha; --base compara com uma saída anterior e falha se algo ficou mais lento que o limiar.
+
+typedef std::chrono::steady_clock Relogio;
+
+static int REPETICOES = 7;
+static const double ALVO_S = 0.02; // duração mínima de uma repetição
+
+struct Medida
+{
+    std::string nome;
+    double ns;
+    const char *unidade;
+};
+
+static std::vector<Medida> medidas;
+static const char *filtro = nullptr;
+
+// Mínimo sobre as repetições de f(n) em ns por unidade; f executa n unidades de trabalho
+template <typename F>
+static double medir(F f)
+{
+    uint64_t n = 1; // cresce até a repetição durar ALVO_S
+    for (;;)
+    {
+        auto t0 = Relogio::now();
+        f(n);
+        double s = std::chrono::duration<double>(Relogio::now() - t0).count();
+        if (s >= ALVO_S || n >= (1ull << 40))
+            break;
+        n = s > 0.0 ? std::max(n * 2, (uint64_t)(double(n) * ALVO_S * 1.2 / s)) : n * 16;
+    }
+
+    double melhor = 1e300;
+    for (int r = 0; r < REPETICOES; ++r)
+    {
+        auto t0 = Relogio::now();
+        f(n);
+        double s = std::chrono::duration<double>(Relogio::now() - t0).count();
+        melhor = std::min(melhor, s * 1e9 / double(n));
+    }
+    return melhor;
+}
+
+static bool selecionada(const std::string &nome)
+{
+    return !filtro || nome.find(filtro) != std::string::npos;
+}
+
+static void registrar(const std::string &nome, double ns, const char *unidade)
+{
+    medidas.push_back(Medida{nome, ns, unidade});
+    printf("%-28s %12.3f %s\n", nome.c_str(), ns, unidade);
+    fflush(stdout);
+}
+
+// ---- instruções isoladas -------------------------------------------------------------------
+
+// Programa de teste: prefixo que fixa registradores e I, corpo com a instrução repetida e dois
+// saltos de volta ao início do corpo (um skip na última cópia pula o primeiro). A detecção de laço
+// ocioso fica desligada: uma volta que não muda o estado seria pulada inteira em vez de medida.
+static const uint16_t INICIO_CORPO = 0x240;
+static const int COPIAS = 1024;
+static const uint16_t DADOS = 0xE00; // I aponta aqui: sprites e destino de FX33/FX55
+
+struct CasoInstrucao
+{
+    const char *nome;
+    uint16_t inst;
+};
+
+// V0 = 0 (FX1E e BNNN não saem do lugar), V1..V9 pequenos, VA = 5, VB = 3 (x desalinhado),
+// VC = 0xC7 (BCD com três dígitos), VD = 60 (sprite cruzando a borda direita)
+static const uint8_t VALORES_REG[16] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                                        0x08, 0x09, 0x05, 0x03, 0xC7, 0x3C, 0x0E, 0x00};
+
+static const CasoInstrucao CASOS[] = {
+    {"00E0_CLS", 0x00E0},
+    {"3XNN_SE_BYTE", 0x3A05},
+    {"4XNN_SNE_BYTE", 0x4A00},
+    {"5XY0_SE_REG", 0x5AB0},
+    {"6XNN_LD_BYTE", 0x6E12},
+    {"7XNN_ADD_BYTE", 0x7E01},
+    {"8XY0_LD_REG", 0x8EB0},
+    {"8XY1_OR", 0x8EB1},
+    {"8XY2_AND", 0x8EB2},
+    {"8XY3_XOR", 0x8EB3},
+    {"8XY4_ADD_REG", 0x8EB4},
+    {"8XY5_SUB", 0x8EB5},
+    {"8XY6_SHR", 0x8EB6},
+    {"8XY7_SUBN", 0x8EB7},
+    {"8XYE_SHL", 0x8EBE},
+    {"9XY0_SNE_REG", 0x9AB0},
+    {"ANNN_LD_I", 0xAE00},
+    {"CXNN_RND", 0xCEFF},
+    {"DXYN_DRW_alinhado_1", 0xD011},
+    {"DXYN_DRW_alinhado_15", 0xD01F},
+    {"DXYN_DRW_desalinhado_8", 0xDAB8},
+    {"DXYN_DRW_borda_8", 0xDDB8},
+    {"EX9E_SKP", 0xEA9E},
+    {"EXA1_SKNP", 0xEAA1},
+    {"FX07_LD_VX_DT", 0xFE07},
+    {"FX15_LD_DT_VX", 0xFA15},
+    {"FX18_LD_ST_VX", 0xFA18},
+    {"FX1E_ADD_I_VX", 0xF01E},
+    {"FX29_LD_F_VX", 0xFA29},
+    {"FX33_BCD", 0xFC33},
+    {"FX55_LD_I_VX_4", 0xF355},
+    {"FX55_LD_I_VX_16", 0xFF55},
+    {"FX65_LD_VX_I_4", 0xF365},
+    {"FX65_LD_VX_I_16", 0xFF65},
+};
+
+static void escrever_inst(std::vector<uint8_t> &img, uint16_t endereco, uint16_t inst)
+{
+    img[endereco - 0x200] = (uint8_t)(inst >> 8);
+    img[endereco - 0x200 + 1] = (uint8_t)inst;
+}
+
+// Imagem carregável em 0x200: prefixo, corpo em INICIO_CORPO (ou corpo pronto) e dados em DADOS
+static std::vector<uint8_t> montar_programa(const std::vector<uint16_t> &corpo)
+{
+    std::vector<uint8_t> img(DADOS + 16 - 0x200, 0);
+    uint16_t end = 0x200;
+    for (int r = 0; r < 16; ++r, end += 2)
+        escrever_inst(img, end, (uint16_t)(0x6000 | r << 8 | VALORES_REG[r]));
+    escrever_inst(img, end, (uint16_t)(0xA000 | DADOS));
+    end += 2;
+    escrever_inst(img, end, (uint16_t)(0x1000 | INICIO_CORPO));
+
+    end = INICIO_CORPO;
+    for (uint16_t inst : corpo)
+    {
+        escrever_inst(img, end, inst);
+        end += 2;
+    }
+    // sprite de 16 linhas cheias
+    for (int i = 0; i < 16; ++i)
+        img[DADOS - 0x200 + i] = 0xFF;
+    return img;
+}
+
+static void bench_programa(const std::string &nome, const std::vector<uint16_t> &corpo, bool jit)
+{
+    if (!selecionada(nome))
+        return;
+    std::vector<uint8_t> img = montar_programa(corpo);
+    std::unique_ptr<Chip8> vm(new Chip8());
+    vm->VM_inicializar(0x200);
+    vm->VM_CarregarBytes(img.data(), img.size(), 0x200);
+    vm->VM_PularLacosOciosos(false);
+    if (jit && !vm->VM_AtivarJIT())
+        return;
+    vm->VM_Executar(20 + 4 * COPIAS); // prefixo e primeira passada (decodificação, compilação)
+    registrar(nome, medir([&](uint64_t n)
+                          {
+                              while (n > 0)
+                              {
+                                  uint32_t k = (uint32_t)std::min<uint64_t>(n, 1u << 20);
+                                  vm->VM_Executar(k);
+                                  n -= k;
+                              } }),
+              "ns/inst");
+}
+
+static void bench_instrucoes()
+{
+    for (const CasoInstrucao &c : CASOS)
+    {
+        std::vector<uint16_t> corpo(COPIAS, c.inst);
+        corpo.push_back((uint16_t)(0x1000 | INICIO_CORPO));
+        corpo.push_back((uint16_t)(0x1000 | INICIO_CORPO));
+        bench_programa(std::string("inst/") + c.nome, corpo, false);
+    }
+
+    // instruções de desvio não cabem no corpo repetido: laços de uma ou três instruções
+    bench_programa("inst/1NNN_JP", {(uint16_t)(0x1000 | INICIO_CORPO)}, false);
+    bench_programa("inst/BNNN_JP_V0", {(uint16_t)(0xB000 | INICIO_CORPO)}, false);
+    bench_programa("inst/2NNN_00EE_CALL_RET_JP",
+                   {(uint16_t)(0x2000 | (INICIO_CORPO + 4)), (uint16_t)(0x1000 | INICIO_CORPO), 0x00EE}, false);
+
+    // o mesmo corpo de ALU pelo JIT, para acompanhar o custo por instrução do código nativo
+    std::vector<uint16_t> alu;
+    for (int i = 0; i < COPIAS / 4; ++i)
+    {
+        alu.push_back(0x7E01);
+        alu.push_back(0x8EB4);
+        alu.push_back(0x8EB2);
+        alu.push_back(0x8EB3);
+    }
+    alu.push_back((uint16_t)(0x1000 | INICIO_CORPO));
+    bench_programa("inst/ALU_misto", alu, false);
+    bench_programa("jit/ALU_misto", alu, true);
+}
+
+// ---- conversão da tela ---------------------------------------------------------------------
+
+static void bench_tela()
+{
+    uint64_t linhas[ALTURA_TELA];
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    for (int y = 0; y < ALTURA_TELA; ++y)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        linhas[y] = x;
+    }
+    static uint32_t pixels[ALTURA_TELA * LARGURA_TELA];
+    const int pitch = LARGURA_TELA * 4;
+
+    struct
+    {
+        const char *nome;
+        int primeira, ultima;
+    } faixas[] = {{"tela/converter_32_linhas", 0, 31}, {"tela/converter_8_linhas", 12, 19}, {"tela/converter_1_linha", 7, 7}};
+
+    for (const auto &f : faixas)
+    {
+        if (!selecionada(f.nome))
+            continue;
+        registrar(f.nome, medir([&](uint64_t n)
+                                {
+                                    for (uint64_t i = 0; i < n; ++i)
+                                    {
+                                        converter_linhas_rgba(pixels, pitch, linhas, f.primeira, f.ultima);
+                                        // impede que o compilador junte as chamadas
+                                        __asm__ __volatile__("" : : "r"(pixels) : "memory");
+                                    } }),
+                  "ns/quadro");
+    }
+}
+
+// ---- ROMs completas ------------------------------------------------------------------------
+
+static const uint64_t FRAMES_ROM = 600; // 10 s virtuais
+static const int HZ_ROM = 60000;        // 1000 instruções por frame
+
+// Roda FRAMES_ROM frames sem entrada, do mesmo jeito que o modo headless, em uma VM nova
+static ResultadoHeadless rodar_rom(const ImagemROM &img, bool jit)
+{
+    std::unique_ptr<Chip8> vm(new Chip8());
+    vm->VM_inicializar(0x200);
+    vm->VM_CarregarImagem(img, 0x200);
+    if (jit)
+        vm->VM_AtivarJIT();
+    return vm->rodarHeadless(HZ_ROM, 0, FRAMES_ROM);
+}
+
+static void bench_roms(const char *diretorio)
+{
+    BibliotecaROM biblioteca;
+    biblioteca.indexar(diretorio);
+    for (const ImagemROM *img : biblioteca.imagens())
+    {
+        std::string base = img->caminho().substr(img->caminho().rfind('/') + 1);
+        for (int jit = 0; jit < 2; ++jit)
+        {
+            std::string nome = std::string(jit ? "rom_jit/" : "rom/") + base;
+            if (!selecionada(nome))
+                continue;
+            // uma unidade = uma execução inteira; reporta ms por execução e, só na tela, quanto do
+            // orçamento ficou sem executar (laços ociosos, FX0A), que deve ser o mesmo com e sem JIT
+            ResultadoHeadless res = {0, 0, 0, 0.0};
+            double ns = medir([&](uint64_t n)
+                              {
+                                  for (uint64_t i = 0; i < n; ++i)
+                                      res = rodar_rom(*img, jit != 0); });
+            registrar(nome, ns / 1e6, "ms/600frames");
+            uint64_t orcamento = res.instrucoes + res.puladas;
+            printf("%-28s %12.1f %% do orçamento pulado\n", "",
+                   orcamento ? 100.0 * double(res.puladas) / double(orcamento) : 0.0);
+        }
+    }
+}
+
+// ---- muitas instâncias --------------------------------------------------------------------
+
+static const int INSTANCIAS = 4096;
+
+// Um frame por vez de cada uma de INSTANCIAS VMs da primeira ROM do diretório, lado a lado num
+// std::vector, cada uma com a memória própria ou todas lendo a mesma imagem compartilhada
+static void bench_instancias(const char *diretorio)
+{
+    BibliotecaROM biblioteca;
+    biblioteca.indexar(diretorio);
+    std::vector<const ImagemROM *> imagens = biblioteca.imagens();
+    if (imagens.empty())
+        return;
+    for (int compartilhar = 0; compartilhar < 2; ++compartilhar)
+    {
+        std::string nome = compartilhar ? "instancias/compartilhadas" : "instancias/proprias";
+        if (!selecionada(nome))
+            continue;
+        std::vector<Chip8> vms(INSTANCIAS);
+        std::shared_ptr<const MemoriaChip8> imagem;
+        for (int i = 0; i < INSTANCIAS; ++i)
+        {
+            vms[i].VM_CarregarImagem(*imagens[0], 0x200);
+            vms[i].VM_DefinirSemente(i);
+            if (compartilhar && !imagem)
+                imagem = vms[i].VM_CompartilharMemoria();
+            else if (compartilhar)
+                vms[i].VM_UsarMemoria(imagem);
+        }
+        size_t k = 0;
+        registrar(nome, medir([&](uint64_t n)
+                              {
+                                  for (uint64_t i = 0; i < n; ++i)
+                                  {
+                                      vms[k].VM_Executar(HZ_ROM / 60);
+                                      vms[k].tickTimers();
+                                      k = k + 1 == vms.size() ? 0 : k + 1;
+                                  } }),
+                  "ns/frame");
+    }
+}
+
+// Volta ao estado de partida depois de umas poucas instruções: VM_ReiniciarDe copia só as páginas
+// que elas sujaram, contra a recarga completa da ROM (inicializar + carregar + decodificar). Um
+// frame inteiro (1000 instruções) custaria mais que o próprio reinício e esconderia a diferença.
+static const uint32_t INSTRUCOES_REINICIO = 16;
+
+static void bench_reinicio(const char *diretorio)
+{
+    BibliotecaROM biblioteca;
+    biblioteca.indexar(diretorio);
+    std::vector<const ImagemROM *> imagens = biblioteca.imagens();
+    if (imagens.empty())
+        return;
+    Chip8 modelo;
+    modelo.VM_CarregarImagem(*imagens[0], 0x200);
+    modelo.VM_CompartilharMemoria();
+    Chip8 vm;
+    vm.VM_ReiniciarDe(modelo);
+    if (selecionada("reinicio/recarregar"))
+        registrar("reinicio/recarregar", medir([&](uint64_t n)
+                                               {
+                                                   for (uint64_t i = 0; i < n; ++i)
+                                                   {
+                                                       vm.VM_Executar(INSTRUCOES_REINICIO);
+                                                       vm.VM_inicializar(0x200);
+                                                       vm.VM_CarregarImagem(*imagens[0], 0x200);
+                                                   } }),
+                  "ns/reinicio");
+    if (selecionada("reinicio/modelo"))
+        registrar("reinicio/modelo", medir([&](uint64_t n)
+                                           {
+                                               for (uint64_t i = 0; i < n; ++i)
+                                               {
+                                                   vm.VM_Executar(INSTRUCOES_REINICIO);
+                                                   vm.VM_ReiniciarDe(modelo);
+                                               } }),
+                  "ns/reinicio");
+    if (selecionada("reinicio/bifurcar"))
+        registrar("reinicio/bifurcar", medir([&](uint64_t n)
+                                             {
+                                                 for (uint64_t i = 0; i < n; ++i)
+                                                 {
+                                                     Chip8 filho = modelo.VM_Bifurcar();
+                                                     filho.VM_Executar(INSTRUCOES_REINICIO);
+                                                 } }),
+                  "ns/reinicio");
+}
+
+// ---- comparação com uma execução anterior --------------------------------------------------
+
+static bool ler_base(const char *arquivo, std::map<std::string, double> &base)
+{
+    FILE *f = fopen(arquivo, "r");
+    if (!f)
+    {
+        perror(arquivo);
+        return false;
+    }
+    char nome[256], unidade[64];
+    double v;
+    while (fscanf(f, "%255s %lf %63s", nome, &v, unidade) == 3)
+        base[nome] = v;
+    fclose(f);
+    return true;
+}
+
+static void imprimir_uso(const char *prog)
+{
+    fprintf(stderr, "Uso: %s [--filtro texto] [--repeticoes N] [--saida arq] [--base arq [--limiar pct]] [dir_roms]\n", prog);
+    fprintf(stderr, "     dir_roms padrão: c8games. --base falha (saída 1) se algo ficou mais de limiar%% (padrão 10) mais lento\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *arq_base = nullptr;
+    const char *arq_saida = nullptr;
+    const char *dir_roms = "c8games";
+    double limiar = 10.0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--filtro" && i + 1 < argc)
+            filtro = argv[++i];
+        else if (arg == "--repeticoes" && i + 1 < argc)
+            REPETICOES = std::max(1, atoi(argv[++i]));
+        else if (arg == "--saida" && i + 1 < argc)
+            arq_saida = argv[++i];
+        else if (arg == "--base" && i + 1 < argc)
+            arq_base = argv[++i];
+        else if (arg == "--limiar" && i + 1 < argc)
+            limiar = atof(argv[++i]);
+        else if (arg.rfind("--", 0) != 0)
+            dir_roms = argv[i];
+        else
+        {
+            imprimir_uso(argv[0]);
+            return 1;
+        }
+    }
+
+    std::map<std::string, double> base;
+    if (arq_base && !ler_base(arq_base, base))
+        return 1;
+
+    bench_instrucoes();
+    bench_tela();
+    bench_roms(dir_roms);
+    bench_instancias(dir_roms);
+    bench_reinicio(dir_roms);
+
+    if (arq_saida)
+    {
+        FILE *f = fopen(arq_saida, "w");
+        if (!f)
+        {
+            perror(arq_saida);
+            return 1;
+        }
+        for (const Medida &m : medidas)
+            fprintf(f, "%s %.3f %s\n", m.nome.c_str(), m.ns, m.unidade);
+        fclose(f);
+    }
+
+    if (!arq_base)
+        return 0;
+
+    int regressoes = 0;
+    printf("\n%-28s %12s %12s %8s\n", "comparação", "base", "atual", "delta");
+    for (const Medida &m : medidas)
+    {
+        auto it = base.find(m.nome);
+        if (it == base.end() || it->second <= 0.0)
+            continue;
+        double delta = 100.0 * (m.ns - it->second) / it->second;
+        bool pior = delta > limiar;
+        regressoes += pior;
+        printf("%-28s %12.3f %12.3f %+7.1f%%%s\n", m.nome.c_str(), it->second, m.ns, delta, pior ? "  REGRESSAO" : "");
+    }
+    if (regressoes)
+        printf("%d medidas mais de %.0f%% mais lentas que %s\n", regressoes, limiar, arq_base);
+    return regressoes ? 1 : 0;
+}
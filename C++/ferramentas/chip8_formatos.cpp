@@ -0,0 +1,534 @@
+#include "../lib/chip8.hpp"
+#include "../lib/escalonador.hpp"
+#include "../lib/estado.hpp"
+#include "../lib/gravacao.hpp"
+#include "../lib/rastro.hpp"
+#include "../lib/rom.hpp"
+#include "../lib/video.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Verificação dos leitores dos formatos de arquivo: cada um grava um arquivo com o próprio
+// gravador, lê de volta e compara, e depois lê cada prefixo do arquivo (e alguns cabeçalhos
+// corrompidos) conferindo que a entrada ruim é recusada sem travar nem alocar o que o arquivo
+// pede. A saída é "ok <nome>" ou "FALHOU <nome>" por verificação; o código de saída é 1 se
+// alguma falhou. Os arquivos ficam num diretório temporário, apagado no fim.
+
+static int falhas = 0;
+static std::string dir_temporario;
+static std::vector<std::string> temporarios;
+
+// Caminho de um arquivo no diretório temporário (apagado no fim)
+static std::string temporario(const char *nome)
+{
+    std::string caminho = dir_temporario + "/" + nome;
+    if (std::find(temporarios.begin(), temporarios.end(), caminho) == temporarios.end())
+        temporarios.push_back(caminho);
+    return caminho;
+}
+
+static void conferir(bool ok, const std::string &nome)
+{
+    printf("%-6s %s\n", ok ? "ok" : "FALHOU", nome.c_str());
+    if (!ok)
+        ++falhas;
+}
+
+// Os leitores explicam a recusa em stderr; nas entradas ruins isso é esperado e só polui a saída
+class SemErros
+{
+public:
+    SemErros()
+    {
+        fflush(stderr);
+        salvo = dup(2);
+        int nulo = open("/dev/null", O_WRONLY);
+        if (nulo >= 0)
+        {
+            dup2(nulo, 2);
+            close(nulo);
+        }
+    }
+    ~SemErros()
+    {
+        fflush(stderr);
+        if (salvo >= 0)
+        {
+            dup2(salvo, 2);
+            close(salvo);
+        }
+    }
+
+private:
+    int salvo;
+};
+
+static std::vector<uint8_t> ler_arquivo(const std::string &caminho)
+{
+    std::vector<uint8_t> dados;
+    FILE *f = fopen(caminho.c_str(), "rb");
+    if (!f)
+        return dados;
+    uint8_t bloco[4096];
+    size_t n;
+    while ((n = fread(bloco, 1, sizeof(bloco), f)) > 0)
+        dados.insert(dados.end(), bloco, bloco + n);
+    fclose(f);
+    return dados;
+}
+
+static bool escrever_arquivo(const std::string &caminho, const uint8_t *dados, size_t n)
+{
+    FILE *f = fopen(caminho.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(dados, 1, n, f) == n;
+    return fclose(f) == 0 && ok;
+}
+
+// Tamanhos de prefixo a testar: todos até 512 bytes e os 64 últimos; no meio, ~512 cortes espalhados
+static std::vector<size_t> cortes(size_t tam)
+{
+    std::vector<size_t> c;
+    size_t passo = std::max<size_t>(1, tam / 512);
+    for (size_t n = 0; n < tam; n += n < 512 ? 1 : passo)
+        c.push_back(n);
+    for (size_t n = tam > 64 ? tam - 64 : 0; n < tam; ++n)
+        if (c.empty() || n > c.back())
+            c.push_back(n);
+    return c;
+}
+
+// ---- gravações (.c8in) ----------------------------------------------------------------------
+
+static const int HZ = 700;
+static const uint64_t FRAMES_GRAVACAO = 10 * INTERVALO_CONFERENCIA + 17;
+
+// Sessão de FRAMES_GRAVACAO frames da ROM com teclas apertadas e soltas ao longo dela
+static bool gravar_sessao(const ImagemROM &rom, GravacaoEntrada &g)
+{
+    std::unique_ptr<Chip8> vm(new Chip8());
+    vm->VM_inicializar(0x200);
+    if (!vm->VM_CarregarImagem(rom, 0x200))
+        return false;
+    g.iniciar(*vm, HZ, 0);
+    DivisorCiclos ciclos(HZ);
+    for (uint64_t frame = 0; frame < FRAMES_GRAVACAO; ++frame)
+    {
+        // intervalos variados entre eventos, alguns longos o bastante para o LEB128 usar 2 bytes
+        if (frame % 37 == 5 || frame % 211 == 0)
+        {
+            uint8_t tecla = (uint8_t)(frame * 7 % 16);
+            bool pressionada = frame % 2 == 0;
+            g.tecla(tecla, pressionada);
+            vm->VM_DefinirTecla(tecla, pressionada);
+        }
+        vm->VM_Executar(ciclos.proximo());
+        vm->tickTimers();
+        g.fim_de_frame(*vm);
+    }
+    return true;
+}
+
+static bool gravacoes_iguais(const GravacaoEntrada &a, const GravacaoEntrada &b)
+{
+    if (a.hz != b.hz || a.instr_por_frame != b.instr_por_frame || a.frames != b.frames ||
+        a.eventos.size() != b.eventos.size() || a.hashes != b.hashes ||
+        !estados_iguais(*a.inicial, *b.inicial))
+        return false;
+    for (size_t i = 0; i < a.eventos.size(); ++i)
+        if (a.eventos[i].frame != b.eventos[i].frame || a.eventos[i].tecla != b.eventos[i].tecla ||
+            a.eventos[i].pressionada != b.eventos[i].pressionada)
+            return false;
+    return true;
+}
+
+static void verificar_gravacao(const ImagemROM &rom)
+{
+    std::string arquivo = temporario("sessao.c8in");
+    std::string cortado = temporario("cortado.c8in");
+
+    GravacaoEntrada g;
+    bool ok = gravar_sessao(rom, g) && salvar_gravacao(g, arquivo.c_str());
+    conferir(ok, "gravacao/salvar");
+    if (!ok)
+        return;
+
+    GravacaoEntrada lida;
+    ok = carregar_gravacao(lida, arquivo.c_str()) && gravacoes_iguais(g, lida);
+    conferir(ok, "gravacao/ida_e_volta");
+    if (ok)
+    {
+        ResultadoReproducao res;
+        reproduzir_gravacao(lida, false, res);
+        conferir(res.identica, "gravacao/reproducao");
+    }
+
+    // todo prefixo próprio perde ao menos o último hash: tem de ser recusado
+    std::vector<uint8_t> dados = ler_arquivo(arquivo);
+    bool recusou = !dados.empty();
+    {
+        SemErros silencio;
+        for (size_t n : cortes(dados.size()))
+        {
+            GravacaoEntrada t;
+            if (!escrever_arquivo(cortado, dados.data(), n) || carregar_gravacao(t, cortado.c_str()))
+            {
+                recusou = false;
+                break;
+            }
+        }
+    }
+    conferir(recusou, "gravacao/truncada");
+
+    // contagens do cabeçalho que não batem com a duração ou não cabem no arquivo
+    auto corrompido = [&](void (*alterar)(CabecalhoGravacao &)) -> bool
+    {
+        std::vector<uint8_t> c = dados;
+        CabecalhoGravacao cab;
+        std::memcpy(&cab, c.data(), sizeof(cab));
+        alterar(cab);
+        std::memcpy(c.data(), &cab, sizeof(cab));
+        GravacaoEntrada t;
+        SemErros silencio;
+        return escrever_arquivo(cortado, c.data(), c.size()) && !carregar_gravacao(t, cortado.c_str());
+    };
+    conferir(dados.size() >= sizeof(CabecalhoGravacao) &&
+                 corrompido([](CabecalhoGravacao &c) { c.n_hashes++; }) &&
+                 corrompido([](CabecalhoGravacao &c) { c.frames += INTERVALO_CONFERENCIA; }) &&
+                 corrompido([](CabecalhoGravacao &c) { c.n_eventos = 0xFFFFFFFFu; }) &&
+                 corrompido([](CabecalhoGravacao &c)
+                            { c.frames = 0xFFFFFFFFull * INTERVALO_CONFERENCIA;
+                              c.n_hashes = 0xFFFFFFFFu; }),
+             "gravacao/cabecalho_corrompido");
+}
+
+// ---- vídeos (.c8v) --------------------------------------------------------------------------
+
+// Sequência de quadros: pixels mudando aos poucos, trechos parados e telas apagadas
+static std::vector<QuadroVideo> gerar_quadros(size_t n, int largura, int planos)
+{
+    std::vector<QuadroVideo> quadros;
+    QuadroVideo q;
+    q.largura = largura;
+    q.altura = largura / 2;
+    q.planos = planos;
+    std::memset(q.palavras, 0, sizeof(q.palavras));
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < n; ++i)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        if (i % 500 == 250)
+            std::memset(q.palavras, 0, sizeof(q.palavras));
+        else if (x % 4 != 0) // um quarto dos quadros repete o anterior
+            for (int k = 0; k < 1 + (int)(x >> 60); ++k)
+                q.palavras[(x >> (8 * k)) % q.n_palavras()] ^= x * (k + 1);
+        quadros.push_back(q);
+    }
+    return quadros;
+}
+
+static bool quadros_iguais(const QuadroVideo &a, const QuadroVideo &b)
+{
+    return a.largura == b.largura && a.altura == b.altura && a.planos == b.planos &&
+           std::memcmp(a.palavras, b.palavras, a.n_palavras() * sizeof(uint64_t)) == 0;
+}
+
+// Grava os quadros pelo GravadorVideo; as repetições seguidas vão por repetir() como no headless
+static bool gravar_video(const std::string &arquivo, const std::vector<QuadroVideo> &quadros)
+{
+    GravadorVideo video;
+    const QuadroVideo &q0 = quadros[0];
+    if (!video.abrir(arquivo, VIDEO_C8V, q0.largura, q0.altura, q0.planos, 1))
+        return false;
+    for (size_t i = 0; i < quadros.size(); ++i)
+    {
+        if (i > 0 && i % 3 == 0 && quadros_iguais(quadros[i], quadros[i - 1]))
+            video.repetir(1);
+        else
+            video.quadro(quadros[i]);
+    }
+    return video.fechar() && video.quadros() == quadros.size();
+}
+
+// Lê o arquivo inteiro; n_lidos quadros conferem com o começo de esperados
+static bool ler_video(const std::string &arquivo, const std::vector<QuadroVideo> &esperados, size_t &n_lidos,
+                      bool &erro)
+{
+    n_lidos = 0;
+    erro = false;
+    LeitorVideo leitor;
+    if (!leitor.abrir(arquivo.c_str()))
+        return false;
+    QuadroVideo q;
+    while (leitor.proximo(q))
+    {
+        if (n_lidos >= esperados.size() || !quadros_iguais(q, esperados[n_lidos]))
+            return false;
+        ++n_lidos;
+    }
+    erro = leitor.erro();
+    return true;
+}
+
+static void verificar_video(int largura, int planos)
+{
+    std::string nome = "video/" + std::to_string(largura) + "x" + std::to_string(largura / 2) +
+                       (planos > 1 ? "x2" : "");
+    std::string arquivo = temporario("video.c8v");
+    std::string cortado = temporario("cortado.c8v");
+
+    // passa de INTERVALO_CHAVE para incluir um quadro-chave no meio
+    std::vector<QuadroVideo> quadros = gerar_quadros(INTERVALO_CHAVE + 300, largura, planos);
+    size_t n_lidos;
+    bool erro;
+    bool ok = gravar_video(arquivo, quadros) && ler_video(arquivo, quadros, n_lidos, erro) && !erro &&
+              n_lidos == quadros.size();
+    conferir(ok, nome + "/ida_e_volta");
+
+    // prefixos de um vídeo curto: ou o cabeçalho é recusado, ou sai um começo correto do vídeo,
+    // sem o último quadro
+    quadros.resize(300);
+    ok = gravar_video(arquivo, quadros);
+    std::vector<uint8_t> dados = ler_arquivo(arquivo);
+    {
+        SemErros silencio;
+        for (size_t n : cortes(dados.size()))
+        {
+            if (!ok || !escrever_arquivo(cortado, dados.data(), n))
+            {
+                ok = false;
+                break;
+            }
+            LeitorVideo leitor;
+            if (!leitor.abrir(cortado.c_str()))
+            {
+                if (n >= sizeof(CabecalhoVideo))
+                    ok = false;
+                continue;
+            }
+            if (!ler_video(cortado, quadros, n_lidos, erro) || n_lidos >= quadros.size())
+                ok = false;
+        }
+    }
+    conferir(ok, nome + "/truncado");
+}
+
+// Registros inválidos depois de um cabeçalho válido
+static void verificar_video_corrompido()
+{
+    std::string arquivo = temporario("corrompido.c8v");
+    CabecalhoVideo cab = {MAGICA_VIDEO, VERSAO_VIDEO, LARGURA_TELA, ALTURA_TELA, 1, 60, 0};
+    auto ler = [&](const std::vector<uint8_t> &registros, size_t &n_lidos, bool &erro) -> bool
+    {
+        std::vector<uint8_t> dados((const uint8_t *)&cab, (const uint8_t *)&cab + sizeof(cab));
+        dados.insert(dados.end(), registros.begin(), registros.end());
+        if (!escrever_arquivo(arquivo, dados.data(), dados.size()))
+            return false;
+        n_lidos = 0;
+        LeitorVideo leitor;
+        if (!leitor.abrir(arquivo.c_str()))
+            return false;
+        QuadroVideo q;
+        while (leitor.proximo(q))
+            ++n_lidos;
+        erro = leitor.erro();
+        return true;
+    };
+    size_t n_lidos;
+    bool erro;
+
+    // DELTA anunciando ~2^63 bytes: recusado antes de alocar
+    std::vector<uint8_t> enorme = {REGISTRO_DELTA, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x40};
+    conferir(ler(enorme, n_lidos, erro) && erro && n_lidos == 0, "video/registro_enorme");
+
+    // tipo desconhecido
+    std::vector<uint8_t> tipo = {REGISTRO_CHAVE, 0, 7, 0};
+    conferir(ler(tipo, n_lidos, erro) && erro && n_lidos == 1, "video/tipo_invalido");
+
+    // um milhão de REPETIR 0 seguidos: nenhum quadro, sem esgotar a pilha
+    std::vector<uint8_t> vazios(2000000, 0);
+    vazios.insert(vazios.begin(), {REGISTRO_CHAVE, 0});
+    conferir(ler(vazios, n_lidos, erro) && !erro && n_lidos == 1, "video/repeticoes_vazias");
+}
+
+// ---- rastros (.c8t) -------------------------------------------------------------------------
+
+static const uint64_t FRAMES_RASTRO = 120;
+
+static bool registros_iguais(const RegistroRastro &a, const RegistroRastro &b)
+{
+    return a.tipo == b.tipo && a.pc == b.pc && a.opcode == b.opcode && a.mudou == b.mudou && a.n == b.n &&
+           a.indice == b.indice && a.frame == b.frame && std::memcmp(a.v, b.v, sizeof(a.v)) == 0 &&
+           a.i == b.i && a.sp == b.sp && a.dt == b.dt && a.st == b.st;
+}
+
+// Lê o rastro inteiro: com guardar acumula os registros em esperados; sem, os n_lidos registros
+// conferem com o começo de esperados
+static bool ler_rastro(const std::string &arquivo, std::vector<RegistroRastro> &esperados, bool guardar,
+                       size_t &n_lidos, bool &erro)
+{
+    n_lidos = 0;
+    erro = false;
+    LeitorRastro leitor;
+    if (!leitor.abrir(arquivo.c_str()))
+        return false;
+    RegistroRastro r;
+    while (leitor.proximo(r))
+    {
+        if (guardar)
+            esperados.push_back(r);
+        else if (n_lidos >= esperados.size() || !registros_iguais(r, esperados[n_lidos]))
+            return false;
+        ++n_lidos;
+    }
+    erro = leitor.erro();
+    return true;
+}
+
+static void verificar_rastro(const ImagemROM &rom)
+{
+    std::string arquivo = temporario("rastro.c8t");
+    std::string cortado = temporario("cortado.c8t");
+
+    // a ROM pelo interpretador com os laços ociosos pulados, para o rastro ter marcas de pulo
+    std::unique_ptr<Chip8> vm(new Chip8());
+    vm->VM_inicializar(0x200);
+    RastroChip8 rastro;
+    bool ok = vm->VM_CarregarImagem(rom, 0x200) && rastro.abrir(arquivo.c_str(), vm->VM_Quirks());
+    ResultadoHeadless res = {0, 0, 0, 0.0};
+    if (ok)
+    {
+        vm->VM_Rastrear(&rastro);
+        res = vm->rodarHeadless(HZ, 0, FRAMES_RASTRO);
+        vm->VM_Rastrear(nullptr);
+        ok = rastro.fechar();
+    }
+    conferir(ok, "rastro/gravar");
+    if (!ok)
+        return;
+
+    // os totais do cabeçalho, a numeração dos registros e os registradores no fim conferem com a
+    // execução
+    std::vector<RegistroRastro> registros;
+    size_t n_lidos;
+    bool erro;
+    ok = ler_rastro(arquivo, registros, true, n_lidos, erro) && !erro;
+    uint64_t instrucoes = 0, puladas = 0, frames = 0;
+    const RegistroRastro *ultima = nullptr;
+    for (const RegistroRastro &r : registros)
+    {
+        if (r.indice != instrucoes + puladas || r.frame != frames)
+            ok = false;
+        if (r.tipo == RASTRO_INSTRUCAO)
+        {
+            ++instrucoes;
+            ultima = &r;
+        }
+        else
+        {
+            (r.tipo == RASTRO_FRAMES ? frames : puladas) += r.n;
+        }
+    }
+    std::unique_ptr<EstadoChip8> estado(new EstadoChip8());
+    vm->VM_SalvarEstado(*estado);
+    LeitorRastro leitor;
+    ok = ok && leitor.abrir(arquivo.c_str()) && leitor.cabecalho().quirks == (uint8_t)vm->VM_Quirks() &&
+         leitor.cabecalho().instrucoes == instrucoes + puladas && leitor.cabecalho().frames == frames &&
+         instrucoes == res.instrucoes && frames == res.frames && puladas > 0 && ultima &&
+         std::memcmp(ultima->v, estado->registradores, sizeof(ultima->v)) == 0 && ultima->i == estado->indiceI &&
+         ultima->sp == estado->ponteiro_pilha;
+    conferir(ok, "rastro/ida_e_volta");
+
+    // prefixos: ou o cabeçalho é recusado, ou sai um começo correto do rastro, sem o último registro
+    std::vector<uint8_t> dados = ler_arquivo(arquivo);
+    ok = !dados.empty();
+    {
+        SemErros silencio;
+        for (size_t n : cortes(dados.size()))
+        {
+            if (!escrever_arquivo(cortado, dados.data(), n))
+            {
+                ok = false;
+                break;
+            }
+            LeitorRastro t;
+            if (!t.abrir(cortado.c_str()))
+            {
+                if (n >= sizeof(CabecalhoRastro))
+                    ok = false;
+                continue;
+            }
+            if (!ler_rastro(cortado, registros, false, n_lidos, erro) || n_lidos >= registros.size())
+                ok = false;
+        }
+    }
+    conferir(ok, "rastro/truncado");
+
+    // marca desconhecida e bits de mudança além de MUDOU_ST depois de uma instrução válida
+    CabecalhoRastro cab = {MAGICA_RASTRO, VERSAO_RASTRO, 0, 0, 0, 0};
+    auto recusado = [&](std::vector<uint8_t> registros_arq) -> bool
+    {
+        std::vector<uint8_t> d((const uint8_t *)&cab, (const uint8_t *)&cab + sizeof(cab));
+        std::vector<uint8_t> valida = {MARCA_PC, 0x00, 0x02, 0x60, 0x01};
+        d.insert(d.end(), valida.begin(), valida.end());
+        d.insert(d.end(), registros_arq.begin(), registros_arq.end());
+        std::vector<RegistroRastro> nenhum;
+        return escrever_arquivo(cortado, d.data(), d.size()) &&
+               ler_rastro(cortado, nenhum, true, n_lidos, erro) && erro && n_lidos == 1;
+    };
+    conferir(recusado({0x07}) && recusado({MARCA_MUDANCAS, 0x00, 0x60, 0x80, 0x80, 0x40}),
+             "rastro/registro_invalido");
+}
+
+// ---- main -----------------------------------------------------------------------------------
+
+static void imprimir_uso(const char *prog)
+{
+    fprintf(stderr, "Uso: %s [rom]   (padrão: c8games/BRIX)\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *arq_rom = "c8games/BRIX";
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-'))
+    {
+        imprimir_uso(argv[0]);
+        return 1;
+    }
+    if (argc == 2)
+        arq_rom = argv[1];
+
+    ImagemROM rom;
+    std::string erro;
+    if (!rom.abrir(arq_rom, erro))
+    {
+        fprintf(stderr, "%s: %s\n", arq_rom, erro.c_str());
+        return 1;
+    }
+    char modelo[] = "/tmp/chip8-formatosXXXXXX";
+    if (!mkdtemp(modelo))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    dir_temporario = modelo;
+
+    verificar_gravacao(rom);
+    verificar_video(LARGURA_TELA, 1);
+    verificar_video(LARGURA_ALTA, PLANOS);
+    verificar_video_corrompido();
+    verificar_rastro(rom);
+
+    for (const std::string &caminho : temporarios)
+        remove(caminho.c_str());
+    rmdir(dir_temporario.c_str());
+    return falhas ? 1 : 0;
+}
@@ -0,0 +1,435 @@
+#include "../lib/rastro.hpp"
+#include "../lib/quirks.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Analisador dos rastros gravados com --rastro (rastro.hpp). Sem opções imprime um resumo:
+// totais, classes de instrução, os trechos sequenciais mais executados (blocos básicos como
+// executados: de um desvio até o próximo) e os laços, identificados pelos saltos para trás. Com
+// --listar imprime as instruções, opcionalmente filtradas.
+
+static void imprimir_uso(const char *prog)
+{
+    fprintf(stderr, "Uso: %s [--top N] <rastro.c8t>   resumo: opcodes, blocos e laços mais executados\n", prog);
+    fprintf(stderr, "     %s --listar [filtros] <rastro.c8t>\n", prog);
+    fprintf(stderr, "Filtros (combinam com E):\n");
+    fprintf(stderr, "     --pc A[-B]          pcs em hexadecimal\n");
+    fprintf(stderr, "     --op PADRAO         opcode com 4 dígitos hexadecimais; outros caracteres valem qualquer um (Dxyn, 8xy4, Fx1E)\n");
+    fprintf(stderr, "     --reg R             instruções que mudaram R (V0..VF, I, SP, DT, ST)\n");
+    fprintf(stderr, "     --frames A[-B]      frames\n");
+    fprintf(stderr, "     --instrucoes A[-B]  números de instrução\n");
+    fprintf(stderr, "     --limite N          para depois de N linhas\n");
+}
+
+struct Faixa
+{
+    uint64_t de = 0;
+    uint64_t ate = UINT64_MAX;
+
+    bool contem(uint64_t x) const { return x >= de && x <= ate; }
+};
+
+static bool ler_faixa(const char *texto, int base, Faixa &f)
+{
+    char *fim;
+    f.de = strtoull(texto, &fim, base);
+    if (fim == texto)
+        return false;
+    if (*fim == '-')
+    {
+        const char *resto = fim + 1;
+        f.ate = strtoull(resto, &fim, base);
+        if (fim == resto)
+            return false;
+    }
+    else
+    {
+        f.ate = f.de;
+    }
+    return *fim == '\0' && f.de <= f.ate;
+}
+
+struct Filtros
+{
+    Faixa pc;
+    Faixa frames;
+    Faixa instrucoes;
+    uint16_t op_mascara = 0; // dígitos fixos do padrão de --op
+    uint16_t op_valor = 0;
+    uint32_t reg = 0; // bits MUDOU_* (0 = qualquer)
+    uint64_t limite = UINT64_MAX;
+    bool algum = false;
+
+    bool aceita(const RegistroRastro &r) const
+    {
+        return pc.contem(r.pc) && frames.contem(r.frame) && instrucoes.contem(r.indice) &&
+               (r.opcode & op_mascara) == op_valor && (!reg || (r.mudou & reg));
+    }
+};
+
+static bool ler_padrao_opcode(const char *texto, Filtros &f)
+{
+    if (strlen(texto) != 4)
+        return false;
+    for (int k = 0; k < 4; ++k)
+    {
+        char c = texto[k];
+        int desloc = 12 - 4 * k;
+        // x, y, n etc. valem qualquer dígito; um dígito hexadecimal maiúsculo ou numérico é fixo
+        if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'F'))
+        {
+            f.op_mascara |= 0xF << desloc;
+            f.op_valor |= (uint16_t)((c <= '9' ? c - '0' : c - 'A' + 10) << desloc);
+        }
+    }
+    return true;
+}
+
+static bool ler_registrador(const char *nome, uint32_t &bits)
+{
+    std::string n = nome;
+    for (char &c : n)
+        c = (char)toupper((unsigned char)c);
+    if (n == "I")
+        bits = MUDOU_I;
+    else if (n == "SP")
+        bits = MUDOU_SP;
+    else if (n == "DT")
+        bits = MUDOU_DT;
+    else if (n == "ST")
+        bits = MUDOU_ST;
+    else if (n.size() == 2 && n[0] == 'V' && isxdigit((unsigned char)n[1]))
+        bits = MUDOU_V0 << strtoul(n.c_str() + 1, nullptr, 16);
+    else
+        return false;
+    return true;
+}
+
+// "VA=02 I=0x2A0 SP=1"
+static std::string descrever_mudancas(const RegistroRastro &r)
+{
+    std::string s;
+    char buf[16];
+    for (int k = 0; k < 16; ++k)
+    {
+        if (r.mudou & (MUDOU_V0 << k))
+        {
+            snprintf(buf, sizeof(buf), " V%X=%02X", k, r.v[k]);
+            s += buf;
+        }
+    }
+    if (r.mudou & MUDOU_I)
+    {
+        snprintf(buf, sizeof(buf), " I=%03X", r.i);
+        s += buf;
+    }
+    if (r.mudou & MUDOU_SP)
+    {
+        snprintf(buf, sizeof(buf), " SP=%u", r.sp);
+        s += buf;
+    }
+    if (r.mudou & MUDOU_DT)
+    {
+        snprintf(buf, sizeof(buf), " DT=%02X", r.dt);
+        s += buf;
+    }
+    if (r.mudou & MUDOU_ST)
+    {
+        snprintf(buf, sizeof(buf), " ST=%02X", r.st);
+        s += buf;
+    }
+    return s;
+}
+
+static int listar(LeitorRastro &leitor, const Filtros &f)
+{
+    RegistroRastro r;
+    uint64_t linhas = 0;
+    printf("%12s %8s %4s %4s  %-18s %s\n", "instrucao", "frame", "pc", "op", "", "mudou");
+    while (linhas < f.limite && leitor.proximo(r))
+    {
+        if (r.tipo == RASTRO_INSTRUCAO)
+        {
+            if (!f.aceita(r))
+                continue;
+            printf("%12llu %8llu %4X %04X  %-18s%s\n", (unsigned long long)r.indice, (unsigned long long)r.frame, r.pc,
+                   r.opcode, desmontar_opcode(r.opcode).c_str(), descrever_mudancas(r).c_str());
+            ++linhas;
+        }
+        else if (!f.algum)
+        {
+            // sem filtros, os marcadores também aparecem
+            if (r.tipo == RASTRO_PULO)
+                printf("%12s %8s %4s %4s  (%llu instruções do laço ocioso puladas)\n", "", "", "", "",
+                       (unsigned long long)r.n);
+            else
+                printf("%12s %8s %4s %4s  -- fim do frame %llu%s\n", "", "", "", "",
+                       (unsigned long long)(r.frame + r.n - 1),
+                       r.n > 1 ? " (parada em FX0A)" : "");
+            ++linhas;
+        }
+    }
+    if (leitor.erro())
+    {
+        fprintf(stderr, "rastro truncado ou inválido depois da instrução %llu\n", (unsigned long long)r.indice);
+        return 1;
+    }
+    return 0;
+}
+
+// Classe do opcode para o histograma: os campos variáveis viram letras (8XY4, FX1E, DXYN)
+static std::string classe_opcode(uint16_t op)
+{
+    char s[8];
+    unsigned n = op & 0xF, nn = op & 0xFF;
+    switch (op >> 12)
+    {
+    case 0x0:
+        if ((op & 0xFFF0) == 0x00C0 || (op & 0xFFF0) == 0x00D0)
+            snprintf(s, sizeof(s), "00%XN", (op >> 4) & 0xF);
+        else if ((op & 0xFF00) == 0)
+            snprintf(s, sizeof(s), "%04X", op);
+        else
+            snprintf(s, sizeof(s), "0NNN");
+        break;
+    case 0x5:
+    case 0x8:
+    case 0x9:
+        snprintf(s, sizeof(s), "%XXY%X", op >> 12, n);
+        break;
+    case 0xD:
+        snprintf(s, sizeof(s), "DXYN");
+        break;
+    case 0xE:
+    case 0xF:
+        if (op == 0xF000)
+            snprintf(s, sizeof(s), "F000");
+        else
+            snprintf(s, sizeof(s), "%XX%02X", op >> 12, nn);
+        break;
+    case 0x3:
+    case 0x4:
+    case 0x6:
+    case 0x7:
+    case 0xC:
+        snprintf(s, sizeof(s), "%XXNN", op >> 12);
+        break;
+    default:
+        snprintf(s, sizeof(s), "%XNNN", op >> 12);
+        break;
+    }
+    return s;
+}
+
+struct Classe
+{
+    uint64_t execucoes = 0;
+    uint16_t exemplo = 0; // primeiro opcode da classe, desmontado como exemplo na listagem
+};
+
+struct Bloco
+{
+    uint64_t execucoes = 0;
+    uint64_t instrucoes = 0;
+};
+
+struct Laco
+{
+    uint64_t voltas = 0;
+    uint64_t instrucoes = 0; // das voltas executadas, medidas entre duas passagens pela cabeça
+    uint64_t puladas = 0;    // instruções que o interpretador pulou (laço ocioso), não voltas
+};
+
+static double porcento(uint64_t parte, uint64_t total)
+{
+    return total ? 100.0 * double(parte) / double(total) : 0.0;
+}
+
+// Ordena as chaves de m pelo critério e devolve as top primeiras
+template <typename M, typename F>
+static std::vector<typename M::const_iterator> mais(const M &m, size_t top, F criterio)
+{
+    std::vector<typename M::const_iterator> v;
+    for (auto it = m.begin(); it != m.end(); ++it)
+        v.push_back(it);
+    std::sort(v.begin(), v.end(), [&](const typename M::const_iterator &a, const typename M::const_iterator &b)
+              { return criterio(a->second) != criterio(b->second) ? criterio(a->second) > criterio(b->second)
+                                                                  : a->first < b->first; });
+    if (v.size() > top)
+        v.resize(top);
+    return v;
+}
+
+static int resumir(LeitorRastro &leitor, const char *arquivo, size_t top)
+{
+    std::unordered_map<std::string, Classe> classes;
+    std::unordered_map<uint32_t, Bloco> blocos; // (início << 16) | fim
+    std::unordered_map<uint32_t, Laco> lacos;   // (cabeça << 16) | cauda
+    std::vector<uint64_t> ultima_passagem(0x10000, UINT64_MAX); // instrução em que cada pc rodou por último
+    std::vector<bool> visto(0x10000, false);
+
+    uint64_t gravadas = 0, puladas = 0, frames = 0, pcs = 0;
+    bool tem_anterior = false;
+    RegistroRastro anterior = {};
+    uint16_t inicio_bloco = 0;
+    uint64_t tam_bloco = 0;
+
+    auto fechar_bloco = [&]()
+    {
+        if (!tam_bloco)
+            return;
+        Bloco &b = blocos[(uint32_t)inicio_bloco << 16 | anterior.pc];
+        ++b.execucoes;
+        b.instrucoes += tam_bloco;
+        tam_bloco = 0;
+    };
+
+    RegistroRastro r;
+    while (leitor.proximo(r))
+    {
+        if (r.tipo == RASTRO_FRAMES)
+        {
+            frames += r.n;
+            continue;
+        }
+        if (r.tipo == RASTRO_PULO)
+        {
+            // o salto anterior é o fim do laço pulado
+            puladas += r.n;
+            if (tem_anterior)
+            {
+                uint16_t cabeca = anterior.opcode & 0x0FFF;
+                lacos[(uint32_t)cabeca << 16 | anterior.pc].puladas += r.n;
+            }
+            continue;
+        }
+
+        ++gravadas;
+        if (!visto[r.pc])
+        {
+            visto[r.pc] = true;
+            ++pcs;
+        }
+        Classe &c = classes[classe_opcode(r.opcode)];
+        if (c.execucoes++ == 0)
+            c.exemplo = r.opcode;
+
+        bool sequencial = tem_anterior && r.pc == (uint16_t)(anterior.pc + 2);
+        if (!sequencial)
+        {
+            fechar_bloco();
+            inicio_bloco = r.pc;
+            // salto para trás que não seja chamada nem retorno: volta de um laço
+            uint16_t tipo = anterior.opcode >> 12;
+            if (tem_anterior && r.pc <= anterior.pc && tipo != 0x2 && anterior.opcode != 0x00EE)
+            {
+                Laco &l = lacos[(uint32_t)r.pc << 16 | anterior.pc];
+                ++l.voltas;
+                if (ultima_passagem[r.pc] != UINT64_MAX)
+                    l.instrucoes += r.indice - ultima_passagem[r.pc];
+            }
+        }
+        ++tam_bloco;
+        ultima_passagem[r.pc] = r.indice;
+        anterior = r;
+        tem_anterior = true;
+    }
+    fechar_bloco();
+    bool truncado = leitor.erro();
+
+    const CabecalhoRastro &cab = leitor.cabecalho();
+    uint64_t total = gravadas + puladas;
+    printf("rastro:      %s (perfil %s)%s\n", arquivo, nome_quirks((Quirks)cab.quirks),
+           truncado ? " TRUNCADO" : cab.instrucoes != total ? " (incompleto: gravação não fechada)" : "");
+    printf("instrucoes:  %llu (%llu gravadas, %llu puladas em laços ociosos)\n", (unsigned long long)total,
+           (unsigned long long)gravadas, (unsigned long long)puladas);
+    printf("frames:      %llu\n", (unsigned long long)frames);
+    printf("pcs:         %llu endereços distintos\n", (unsigned long long)pcs);
+
+    printf("\nclasses de instrução (gravadas):\n");
+    printf("  %-6s %-18s %14s %7s\n", "classe", "exemplo", "execucoes", "%");
+    for (auto it : mais(classes, top, [](const Classe &c)
+                        { return c.execucoes; }))
+        printf("  %-6s %-18s %14llu %6.2f%%\n", it->first.c_str(), desmontar_opcode(it->second.exemplo).c_str(),
+               (unsigned long long)it->second.execucoes, porcento(it->second.execucoes, gravadas));
+
+    printf("\nblocos mais quentes (trechos sequenciais, por instruções):\n");
+    printf("  %-11s %14s %14s %8s\n", "pcs", "execucoes", "instrucoes", "%");
+    for (auto it : mais(blocos, top, [](const Bloco &b)
+                        { return b.instrucoes; }))
+    {
+        char faixa[16];
+        snprintf(faixa, sizeof(faixa), "%03X-%03X", it->first >> 16, it->first & 0xFFFF);
+        printf("  %-11s %14llu %14llu %7.2f%%\n", faixa, (unsigned long long)it->second.execucoes,
+               (unsigned long long)it->second.instrucoes, porcento(it->second.instrucoes, gravadas));
+    }
+
+    printf("\nlaços (salto para trás, por instruções):\n");
+    printf("  %-11s %12s %14s %10s %14s\n", "cabeca-fim", "voltas", "instrucoes", "por volta", "puladas");
+    for (auto it : mais(lacos, top, [](const Laco &l)
+                        { return l.instrucoes + l.puladas; }))
+    {
+        const Laco &l = it->second;
+        char faixa[16];
+        snprintf(faixa, sizeof(faixa), "%03X-%03X", it->first >> 16, it->first & 0xFFFF);
+        printf("  %-11s %12llu %14llu %10.1f %14llu%s\n", faixa, (unsigned long long)l.voltas,
+               (unsigned long long)l.instrucoes, l.voltas ? double(l.instrucoes) / double(l.voltas) : 0.0,
+               (unsigned long long)l.puladas, l.puladas ? "  ocioso" : "");
+    }
+    return truncado ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    bool lista = false;
+    size_t top = 10;
+    Filtros filtros;
+    const char *arquivo = nullptr;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool ok = true;
+        if (arg == "--listar")
+            lista = true;
+        else if (arg == "--top" && i + 1 < argc)
+            top = (size_t)std::max(1, atoi(argv[++i]));
+        else if (arg == "--pc" && i + 1 < argc)
+            ok = ler_faixa(argv[++i], 16, filtros.pc);
+        else if (arg == "--frames" && i + 1 < argc)
+            ok = ler_faixa(argv[++i], 10, filtros.frames);
+        else if (arg == "--instrucoes" && i + 1 < argc)
+            ok = ler_faixa(argv[++i], 10, filtros.instrucoes);
+        else if (arg == "--op" && i + 1 < argc)
+            ok = ler_padrao_opcode(argv[++i], filtros);
+        else if (arg == "--reg" && i + 1 < argc)
+            ok = ler_registrador(argv[++i], filtros.reg);
+        else if (arg == "--limite" && i + 1 < argc)
+            filtros.limite = strtoull(argv[++i], nullptr, 10);
+        else if (arg.rfind("--", 0) != 0 && !arquivo)
+            arquivo = argv[i];
+        else
+            ok = false;
+        if (!ok)
+        {
+            imprimir_uso(argv[0]);
+            return 1;
+        }
+        filtros.algum |= arg == "--pc" || arg == "--frames" || arg == "--instrucoes" || arg == "--op" || arg == "--reg";
+    }
+    if (!arquivo)
+    {
+        imprimir_uso(argv[0]);
+        return 1;
+    }
+
+    LeitorRastro leitor;
+    if (!leitor.abrir(arquivo))
+        return 1;
+    return lista ? listar(leitor, filtros) : resumir(leitor, arquivo, top);
+}
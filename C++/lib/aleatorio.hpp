@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+
+// PCG32 (XSH-RR) com incremento fixo: 8 bytes de estado por instância, sem estado global.
+// A mesma semente produz sempre a mesma sequência, em qualquer thread ou backend.
+static const uint64_t PCG32_MULTIPLICADOR = 6364136223846793005ULL;
+static const uint64_t PCG32_INCREMENTO = 1442695040888963407ULL;
+
+inline uint32_t pcg32_proximo(uint64_t &estado)
+{
+    uint64_t anterior = estado;
+    estado = anterior * PCG32_MULTIPLICADOR + PCG32_INCREMENTO;
+    uint32_t xorshifted = (uint32_t)(((anterior >> 18) ^ anterior) >> 27);
+    uint32_t rot = (uint32_t)(anterior >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+}
+
+// Estado inicial para uma semente (procedimento de semeadura da referência do PCG)
+inline uint64_t pcg32_semear(uint64_t semente)
+{
+    uint64_t estado = 0;
+    pcg32_proximo(estado);
+    estado += semente;
+    pcg32_proximo(estado);
+    return estado;
+}
@@ -1,41 +1,448 @@
+#pragma once
 #include <cstdint>
 #include <array>
 #include <string>
-#include <SDL2/SDL.h>
 #include <cstring>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
 #include <cstdlib>
 #include <cstdio>
+#include <memory>
+#include <vector>
+#include "jit_x64.hpp"
+#include "aleatorio.hpp"
+#include "rom.hpp"
+#include "estado.hpp"
+#include "quirks.hpp"
 
+// Resultado de uma execução headless (sem janela e sem limite de velocidade)
+struct ResultadoHeadless
+{
+    uint64_t instrucoes; // instruções efetivamente executadas
+    uint64_t puladas;    // orçamento dos frames não executado: laços ociosos pulados e espera em FX0A
+    uint64_t frames;     // frames virtuais de 60Hz simulados
+    double segundos;     // tempo de parede gasto na execução
+};
+
+void imprimir_resultado_headless(const ResultadoHeadless &res);
+
+// Opções do frontend SDL além de velocidade e escala
+struct OpcoesSDL
+{
+    int instr_por_frame = 0;            // > 0 fixa as instruções de cada frame de 60Hz em vez de derivá-las de fps
+    int amostras_audio = 512;           // buffer do dispositivo de áudio (latência); 0 desliga o som
+    const char *arq_gravacao = nullptr; // grava as teclas da sessão para reprodução (gravacao.hpp)
+};
+
+class FeixeChip8; // feixe.hpp
+ResultadoHeadless rodar_feixe_headless(FeixeChip8 &feixe, int fps, uint64_t max_instrucoes, uint64_t max_frames,
+                                       int instr_por_frame = 0);
+
+struct TarefaLote;   // lote.hpp
+struct ResultadoLote; // lote.hpp
+struct ColetaFuzz;    // fuzz.hpp
+struct EntradaFuzz;   // fuzz.hpp
+struct EventoTecla;   // lote.hpp
+class RastroChip8;    // rastro.hpp
+struct EntradaRastro; // rastro.hpp
+class GravadorVideo;  // video.hpp
+
+const int TAM_MEMORIA = 0x1000; // memória endereçável do CHIP-8 (o XO-CHIP estende em ExtensaoChip8)
+const int TAM_PAGINA = 0x100;   // granularidade do rastreio de escritas para VM_ReiniciarDe
+const int LARGURA_TELA = 64;
+const int ALTURA_TELA = 32;
+const int LARGURA_ALTA = 128; // SUPER-CHIP/XO-CHIP
+const int ALTURA_ALTA = 64;
+const int PLANOS = 2;         // XO-CHIP
+
+// Estado só dos perfis SUPER-CHIP e XO-CHIP, alocado quando um deles é ativado. A tela tem
+// 128x64 pixels por plano com cada linha em duas palavras (bit 63 da primeira = coluna 0): um
+// sprite ou um scroll horizontal é um deslocamento de 128 bits por linha e o scroll vertical um
+// memmove de linhas, então 4x mais pixels custam 2x mais palavras. Em baixa resolução cada
+// pixel vira um bloco 2x2 na mesma tela.
+struct ExtensaoChip8
+{
+    uint64_t tela[PLANOS][ALTURA_ALTA][2];
+    bool alta_resolucao;           // 00FF / 00FE
+    uint8_t planos;                // planos afetados por DXYN, 00E0 e scroll (FN01): bit p = plano p
+    uint8_t tom;                   // FX3A: taxa do padrão de som
+    uint8_t flags[16];             // FX75/FX85 (flags RPL do HP-48)
+    uint8_t padrao_som[16];        // F002: 128 amostras de 1 bit
+    uint8_t memoria_alta[0x10000 - 0x1000]; // XO-CHIP: 0x1000..0xFFFF (os 4 KB de baixo são Chip8::memoria)
+};
+
+// Instrução pré-decodificada para um endereço da memória: manipulador e operandos já extraídos
+struct Decodificada
+{
+    uint8_t op; // OpCode (OP_NAO_DECODIFICADA = ainda não decodificada)
+    uint8_t x;
+    uint8_t y;
+    uint8_t n;
+    uint8_t nn;
+    uint16_t nnn;
+};
+
+// Classes de instrução; cada uma tem um manipulador op_* na classe Chip8
+enum OpCode : uint8_t
+{
+    OP_NAO_DECODIFICADA = 0,
+    OP_NOP,
+    OP_CLS,
+    OP_RET,
+    OP_JP,
+    OP_CALL,
+    OP_SE_BYTE,
+    OP_SNE_BYTE,
+    OP_SE_REG,
+    OP_LD_BYTE,
+    OP_ADD_BYTE,
+    OP_LD_REG,
+    OP_OR,
+    OP_AND,
+    OP_XOR,
+    OP_ADD_REG,
+    OP_SUB,
+    OP_SHR,
+    OP_SUBN,
+    OP_SHL,
+    OP_SNE_REG,
+    OP_LD_I,
+    OP_JP_V0,
+    OP_RND,
+    OP_DRW,
+    OP_SKP,
+    OP_SKNP,
+    OP_LD_VX_DT,
+    OP_LD_VX_K,
+    OP_LD_DT_VX,
+    OP_LD_ST_VX,
+    OP_ADD_I_VX,
+    OP_LD_F_VX,
+    OP_LD_B_VX,
+    OP_LD_I_VX,
+    OP_LD_VX_I,
+    // SUPER-CHIP e XO-CHIP (NOP nos outros perfis)
+    OP_SCD,          // 00CN scroll para baixo
+    OP_SCU,          // 00DN scroll para cima (XO-CHIP)
+    OP_SCR,          // 00FB scroll 4 pixels para a direita
+    OP_SCL,          // 00FC scroll 4 pixels para a esquerda
+    OP_EXIT,         // 00FD
+    OP_LOW,          // 00FE
+    OP_HIGH,         // 00FF
+    OP_SAVE_VX_VY,   // 5XY2 (XO-CHIP)
+    OP_LOAD_VX_VY,   // 5XY3 (XO-CHIP)
+    OP_LD_I_LONGO,   // F000 NNNN (XO-CHIP)
+    OP_PLANO,        // FN01 (XO-CHIP)
+    OP_AUDIO,        // F002 (XO-CHIP)
+    OP_LD_HF_VX,     // FX30
+    OP_LD_TOM_VX,    // FX3A (XO-CHIP)
+    OP_LD_R_VX,      // FX75
+    OP_LD_VX_R,      // FX85
+    OP_TOTAL
+};
+
+// Memória baixa (fonte e ROM) e a decodificação de cada endereço. Uma VM lê por ponteiros, da sua
+// própria cópia ou de uma imagem somente leitura compartilhada com outras VMs da mesma ROM
+// (VM_CompartilharMemoria); a imagem compartilhada vem com todos os endereços decodificados, então
+// ninguém escreve nela, e a primeira escrita em memória de uma VM copia a imagem para ela.
+struct MemoriaChip8
+{
+    uint8_t bytes[TAM_MEMORIA];
+    Decodificada decod[TAM_MEMORIA]; // op == OP_NAO_DECODIFICADA: decodificar na primeira execução
+};
+
+// Instrumentação opcional (make PERFIL=1 define CHIP8_PERFIL). Desligada, PERFIL(...) não gera
+// código e o laço quente fica idêntico ao de release.
+#ifdef CHIP8_PERFIL
+#define PERFIL(...) __VA_ARGS__
+struct PerfilChip8
+{
+    uint64_t por_opcode[OP_TOTAL]; // execuções interpretadas por classe de instrução
+    uint64_t por_pc[4096];         // execuções interpretadas por endereço
+    uint64_t instrucoes_jit;       // executadas em código nativo (sem classe nem pc)
+    uint64_t ns_execucao;          // tempo total dentro de VM_Executar
+    uint64_t ns_drw;               // parte desse tempo gasta em DXYN
+    uint64_t frames_desenhados;    // frames em que alguma linha mudou
+    uint64_t frames_pulados;       // frames sem mudança na tela (nada a desenhar)
+    uint64_t frames_atrasados;     // frames executados para recuperar um engasgo (nunca exibidos)
+
+    void contar_frame(bool desenhou) { ++(desenhou ? frames_desenhados : frames_pulados); }
+};
+#else
+#define PERFIL(...)
+#endif
+
+// Instâncias do laço do interpretador (Chip8::interpretar): a normal, a que alimenta a coleta do
+// modo fuzz e a que grava o rastro de execução
+enum Instrumentacao
+{
+    SEM_INSTRUMENTACAO,
+    INSTRUMENTACAO_FUZZ,
+    INSTRUMENTACAO_RASTRO,
+};
+
+// Layout pensado para vetores densos de VMs (sizeof ~448 bytes sem PERFIL): tudo que o laço do
+// interpretador lê a cada instrução fica na primeira linha de cache; pilha e tela vêm em seguida;
+// memória, cache de decodificação, JIT e extensões ficam fora do objeto.
 class Chip8
 {
 private:
-    uint8_t memoria[4096];            // memória do CHIP-8
-    uint16_t pc;                      // contador de programa
+    // linha quente (64 bytes)
+    alignas(64) uint16_t pc;          // contador de programa
+    uint16_t indiceI;                 // registrador I
     uint8_t registradores[16];        // registradores V0..VF
     uint8_t ponteiro_pilha;           // ponteiro da pilha (SP)
-    uint16_t indiceI;                 // registrador I
-    uint16_t pilha[16];               // pilha de retorno
-    uint8_t tela[64 * 32];            // buffer de vídeo (DISPLAY)
     uint8_t temporizador_delay;       // delay timer
     uint8_t temporizador_som;         // sound timer
-    bool deveDesenhar;                // flag indicando que a nova imagem deve ser desenhada
-    uint8_t teclas[16];               // estado das 16 teclas do CHIP-8
-    bool aguardando_tecla = false;    // espera por tecla (FX0A)
-    uint8_t reg_aguardando_tecla = 0; // registrador a preencher quando a tecla for pressionada
+    Quirks quirks;                    // perfil de compatibilidade (quirks.hpp); faz parte do savestate
+    uint16_t teclas;                  // bit k = tecla k pressionada
+    bool aguardando_tecla;            // espera por tecla (FX0A)
+    uint8_t reg_aguardando_tecla;     // registrador a preencher quando a tecla for pressionada
+    uint32_t linhas_sujas;            // bit y = linha y da tela mudou desde o último desenho (perfis estendidos: só != 0)
+    uint64_t estado_rng;              // estado do PCG32 usado pelo CXNN
+    uint32_t efeitos;                 // escritas na memória e na tela (só para detectar laços ociosos)
+    uint16_t paginas_sujas;           // bit p = página p da memória própria difere de compartilhada
+    bool pular_ociosos;               // detecção de laços ociosos ligada (VM_PularLacosOciosos)
+    const uint8_t *memoria;           // TAM_MEMORIA bytes: privada->bytes ou compartilhada->bytes
+    const Decodificada *cache_decod;  // instrução pré-decodificada por endereço (invalidada em escritas)
+
+    uint16_t pilha[16];               // pilha de retorno
+    uint64_t tela[ALTURA_TELA];       // buffer de vídeo: uma linha por palavra, bit 63 = coluna 0
+
+    std::unique_ptr<MemoriaChip8> privada;             // nullptr enquanto lê da imagem compartilhada
+    std::shared_ptr<const MemoriaChip8> compartilhada; // imagem lida ou, com privada, a de onde ela foi copiada
+    std::unique_ptr<JitX64> jit;      // backend JIT opcional (nullptr = só interpretador)
+    std::unique_ptr<ExtensaoChip8> ext; // só nos perfis SUPER-CHIP e XO-CHIP
+    ColetaFuzz *coleta;               // modo fuzz (VM_ColetarFuzz); nullptr = interpretador sem instrumentação
+    RastroChip8 *rastro;              // rastro de execução (VM_Rastrear); nullptr = sem rastro
+    PERFIL(PerfilChip8 perfil;)
+
+    static Decodificada decodificar(uint16_t inst);
+    const Decodificada &buscar_decodificada(uint16_t endereco);
+    void escrever_memoria(uint16_t endereco, uint8_t valor);
+    void invalidar_cache_decod();
+    // Bytes graváveis da memória para escritas em bloco (todas as páginas ficam sujas); copia
+    // antes a imagem compartilhada, se a VM estiver lendo dela
+    uint8_t *memoria_propria();
+    void copiar_imagem();
+    void restaurar_paginas();
+
+    // VM sem memória alocada nem estado inicializado, para VM_Bifurcar preencher
+    struct SemMemoria
+    {
+    };
+    explicit Chip8(SemMemoria);
+    // acessos a dados por I: no XO-CHIP vão até 0xFFFF, nos outros perfis dão a volta em 0x1000
+    template <Quirks Q>
+    uint8_t ler_dado(uint32_t endereco) const;
+    template <Quirks Q>
+    void escrever_dado(uint32_t endereco, uint8_t valor);
+    // busca de instrução: o pc também dá a volta em 0x1000, menos no XO-CHIP, que executa código na
+    // memória alta (decodificado a cada busca, em alta, porque o cache só cobre 4 KB)
+    template <Quirks Q>
+    const Decodificada &buscar_instrucao(uint16_t endereco, Decodificada &alta);
+    template <Quirks Q>
+    uint16_t ler_opcode(uint16_t endereco) const;
+    template <Quirks Q>
+    uint16_t pular(uint16_t pc_atual) const;
+    template <Quirks Q>
+    uint8_t desenhar_estendido(const Decodificada &d);
+    void rolar_vertical(int linhas);
+    void rolar_horizontal(int colunas);
+    void limpar_planos();
+    // devolvem quantas das n instruções foram de fato executadas (sem as voltas de laço ocioso
+    // puladas e sem o que sobrou ao parar em FX0A)
+    uint32_t interpretar(uint32_t n);
+    template <Instrumentacao Modo>
+    uint32_t interpretar_perfil(uint32_t n);
+    template <Quirks Q, Instrumentacao Modo>
+    uint32_t interpretar_quirks(uint32_t n);
+    void copiar_registros_rastro(EntradaRastro &e) const;
+    template <Quirks Q>
+    void conferir_acessos(const Decodificada &d, uint16_t pc_atual);
+
+    // Estado no último salto para trás, para detectar laços ociosos (ver interpretar)
+    struct LacoOcioso
+    {
+        uint16_t alvo; // 0xFFFF = nenhum
+        uint32_t restantes;
+        uint32_t efeitos;
+        uint16_t indiceI;
+        uint8_t ponteiro_pilha;
+        uint8_t temporizador_delay, temporizador_som; // FX15/FX18 no corpo
+        uint8_t registradores[16];
+        uint16_t pilha[16];
+        uint64_t estado_rng;
+    };
+    uint32_t pular_laco_ocioso(LacoOcioso &laco, uint16_t alvo, uint32_t restantes);
+    uint32_t executar_jit(uint32_t n);
+
+    // manipuladores de instrução (um por OpCode): recebem o pc da instrução e devolvem o próximo pc;
+    // os que dependem do perfil de quirks são templates instanciados por interpretar_quirks<Q, ...>
+    uint16_t op_NOP(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_CLS(const Decodificada &d, uint16_t pc_atual);
+    uint16_t op_RET(const Decodificada &d, uint16_t pc_atual);
+    uint16_t op_JP(const Decodificada &d, uint16_t pc_atual);
+    uint16_t op_CALL(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_SE_BYTE(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_SNE_BYTE(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_SE_REG(const Decodificada &d, uint16_t pc_atual);
+    uint16_t op_LD_BYTE(const Decodificada &d, uint16_t pc_atual);
+    uint16_t op_ADD_BYTE(const Decodificada &d, uint16_t pc_atual);
+    uint16_t op_LD_REG(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_OR(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_AND(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_XOR(const Decodificada &d, uint16_t pc_atual);
+    uint16_t op_ADD_REG(const Decodificada &d, uint16_t pc_atual);
+    uint16_t op_SUB(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_SHR(const Decodificada &d, uint16_t pc_atual);
+    uint16_t op_SUBN(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_SHL(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_SNE_REG(const Decodificada &d, uint16_t pc_atual);
+    uint16_t op_LD_I(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_JP_V0(const Decodificada &d, uint16_t pc_atual);
+    uint16_t op_RND(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_DRW(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_SKP(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_SKNP(const Decodificada &d, uint16_t pc_atual);
+    uint16_t op_LD_VX_DT(const Decodificada &d, uint16_t pc_atual);
+    uint16_t op_LD_VX_K(const Decodificada &d, uint16_t pc_atual);
+    uint16_t op_LD_DT_VX(const Decodificada &d, uint16_t pc_atual);
+    uint16_t op_LD_ST_VX(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_ADD_I_VX(const Decodificada &d, uint16_t pc_atual);
+    uint16_t op_LD_F_VX(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_LD_B_VX(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_LD_I_VX(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_LD_VX_I(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_SCD(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_SCU(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_SCR(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_SCL(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_EXIT(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_LOW(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_HIGH(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_SAVE_VX_VY(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_LOAD_VX_VY(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_LD_I_LONGO(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_PLANO(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_AUDIO(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_LD_HF_VX(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_LD_TOM_VX(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_LD_R_VX(const Decodificada &d, uint16_t pc_atual);
+    template <Quirks Q>
+    uint16_t op_LD_VX_R(const Decodificada &d, uint16_t pc_atual);
 
 public:
     Chip8();
     ~Chip8() = default;
+    // movíveis (std::vector<Chip8>): memória, JIT e extensões estão no heap e mudam só de dono
+    Chip8(Chip8 &&) = default;
+    Chip8 &operator=(Chip8 &&) = default;
 
     void VM_inicializar(uint16_t pc_inicial);
-    void VM_CarregarROM(char *arq_rom, uint16_t pc_inicial);
+    bool VM_CarregarROM(const char *arq_rom, uint16_t pc_inicial);
+    bool VM_CarregarImagem(const ImagemROM &imagem, uint16_t pc_inicial);
+    bool VM_CarregarBytes(const uint8_t *dados, size_t tamanho, uint16_t pc_inicial);
+    void VM_SalvarEstado(EstadoChip8 &destino) const;
+    void VM_RestaurarEstado(const EstadoChip8 &origem);
     void VM_ExecutarInstrucao();
+    // Consome um orçamento de n instruções e devolve quantas foram executadas; a diferença são
+    // voltas de laço ocioso puladas (o resultado é o mesmo de executá-las) ou a espera em FX0A
+    uint32_t VM_Executar(uint32_t n);
+    // O JIT só implementa o perfil moderno; com outro perfil VM_Executar usa o interpretador
+    bool VM_AtivarJIT();
+    // VM_CarregarImagem já escolhe o perfil da ROM (quirks_da_rom); isto força outro. Entrar num
+    // perfil estendido vindo de um básico aloca a ExtensaoChip8 (tela de 128x64 limpa, fonte grande
+    // em 0xA0); sair para um básico a descarta. Entre SUPER-CHIP e XO-CHIP a extensão fica, com a
+    // tela, a resolução e os planos; só a memória acima de 0x1000 é zerada ao sair do XO-CHIP.
+    void VM_DefinirQuirks(Quirks q);
+    Quirks VM_Quirks() const { return quirks; }
+    // XO-CHIP com padrão de som carregado (F002): copia as 128 amostras e a taxa em Hz
+    bool VM_PadraoSom(uint8_t padrao[16], double &taxa_hz) const;
+    // Cópia na escrita da memória baixa entre VMs da mesma ROM, para manter milhares de instâncias
+    // em pouco espaço: VM_CompartilharMemoria congela a memória atual numa imagem decodificada e
+    // passa a ler dela; VM_UsarMemoria aponta outra VM (já no mesmo perfil de quirks) para a
+    // imagem. Escritas que não mudam o byte não copiam; a primeira que muda copia os 36 KB.
+    std::shared_ptr<const MemoriaChip8> VM_CompartilharMemoria();
+    void VM_UsarMemoria(std::shared_ptr<const MemoriaChip8> imagem);
+    bool VM_MemoriaCompartilhada() const { return !privada; }
+    // Clone barato de uma VM em execução (busca, fuzzing): congela a memória desta VM e devolve
+    // outra com os mesmos registradores, pilha, tela e timers lendo a mesma imagem; cada uma
+    // copia a memória só quando escrever nela. O JIT não é clonado.
+    Chip8 VM_Bifurcar();
+    // Volta ao estado de modelo restaurando só o que uma execução muda: registradores, pilha e
+    // tela sempre, e da memória apenas as páginas de TAM_PAGINA bytes escritas desde que esta VM
+    // saiu da imagem de modelo. Com modelo congelado (VM_Bifurcar, VM_CompartilharMemoria) o
+    // modelo não é alterado e várias threads podem reiniciar dele ao mesmo tempo.
+    void VM_ReiniciarDe(const Chip8 &modelo);
+    // Liga (coleta != nullptr) ou desliga a instrumentação do modo fuzz (fuzz.hpp): o interpretador
+    // passa para uma instância que marca pcs e arestas e confere os acessos de cada instrução. A
+    // coleta continua sendo de quem chamou; enquanto ligada o JIT fica parado.
+    void VM_ColetarFuzz(ColetaFuzz *c) { coleta = c; }
+    // Liga (r != nullptr) ou desliga o rastro de execução (rastro.hpp): cada instrução interpretada
+    // vira uma entrada no anel de r, e tickTimers marca os frames. Como na coleta do fuzz, o JIT
+    // fica parado e r continua sendo de quem chamou (que o fecha depois de desligar).
+    void VM_Rastrear(RastroChip8 *r) { rastro = r; }
+    // Liga (padrão) ou desliga o salto de laços ociosos do interpretador e do JIT (ver pular_laco_ocioso).
+    // Desligado, toda volta é executada: é o que o bench quer ao medir laços que não mudam o estado.
+    void VM_PularLacosOciosos(bool ligado) { pular_ociosos = ligado; }
+    void VM_DefinirSemente(uint64_t semente);
+    void VM_DefinirTecla(uint8_t tecla, bool pressionada);
+    uint64_t VM_HashTela() const;
+    // Parada em FX0A: até uma tecla, frames só decrementam os timers
+    bool VM_AguardandoTecla() const { return aguardando_tecla; }
+    // Avança frames de uma VM parada em FX0A de uma vez (equivale a frames chamadas de tickTimers)
+    void VM_AvancarOcioso(uint64_t frames);
+    // Enquanto o timer de som não zera o frontend deve tocar o tom
+    bool VM_SomAtivo() const { return temporizador_som > 0; }
     void VM_ImprimirRegistradores();
-    void rodarSDL(int fps, int scale);
+    // Relatório da instrumentação: texto legível e JSON (qualquer um pode ser nullptr). Num
+    // build sem CHIP8_PERFIL só avisa que não há dados.
+    void VM_ImprimirPerfil(FILE *texto, FILE *json) const;
+    void rodarSDL(int fps, int scale, const OpcoesSDL &opcoes = OpcoesSDL());
+    // instr_por_frame > 0 fixa as instruções de cada frame de 60Hz em vez de derivá-las de fps
+    ResultadoHeadless rodarHeadless(int fps, uint64_t max_instrucoes, uint64_t max_frames, int instr_por_frame = 0);
     void tickTimers();
     // friend para permitir que a camada SDL acesse os internos para renderização/entrada
-    friend void rodar_loop_sdl(Chip8 &vm, int fps, int scale);
+    friend void rodar_loop_sdl(Chip8 &vm, int fps, int scale, const OpcoesSDL &opcoes);
+    friend ResultadoHeadless rodar_loop_headless(Chip8 &vm, int fps, uint64_t max_instrucoes, uint64_t max_frames, int instr_por_frame);
+    friend void executar_tarefa_lote(Chip8 &vm, const TarefaLote &tarefa, int fps, ResultadoLote &res);
+    friend void aplicar_remendos_fuzz(Chip8 &vm, const EntradaFuzz &entrada);
+    friend ResultadoHeadless exportar_video(Chip8 &vm, int hz, int instr_por_frame, uint64_t frames,
+                                            const std::vector<EventoTecla> &eventos, GravadorVideo &video);
+    friend class FeixeChip8; // feixe SIMD: copia estado de/para as faixas e reusa decodificar()
 };
\ No newline at end of file
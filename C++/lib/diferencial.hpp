@@ -0,0 +1,54 @@
+#pragma once
+#include "chip8.hpp"
+#include "feixe.hpp"
+#include "lote.hpp"
+#include <memory>
+#include <vector>
+
+// Execução diferencial: dois backends rodam a mesma ROM com as mesmas entradas em passo travado e
+// o estado observável (registradores, pc, I, pilha, timers, memória e tela) é comparado ao fim
+// de cada frame ou de cada instrução. Comparar por frame deixa o JIT compilar blocos inteiros;
+// quando um frame diverge, ele é refeito dos dois lados a partir do snapshot do início do frame,
+// uma instrução por vez (com o JIT, por busca binária no orçamento), até achar a primeira
+// instrução cujo resultado difere.
+enum BackendDiferencial
+{
+    BACKEND_INTERPRETADOR,
+    BACKEND_JIT,
+    BACKEND_FEIXE, // faixa 0 de um FeixeChip8 (todas as faixas recebem as mesmas entradas)
+};
+
+// "interp", "jit" ou "feixe"; false se o nome não existe
+bool ler_backend_diferencial(const char *nome, BackendDiferencial &b);
+const char *nome_backend_diferencial(BackendDiferencial b);
+
+struct ConfigDiferencial
+{
+    BackendDiferencial a, b;
+    int hz;
+    int instr_por_frame;
+    uint64_t frames;
+    // compara depois de cada instrução; não vale com o JIT, cujos blocos só rodam quando cabem
+    // inteiros no orçamento: com orçamento 1 tudo cairia no interpretador
+    bool por_instrucao;
+    std::vector<EventoTecla> eventos; // em ordem de frame
+};
+
+struct ResultadoDiferencial
+{
+    bool divergiu;
+    uint64_t frames;          // frames conferidos (inclui o divergente)
+    uint64_t instrucoes;      // orçamento de instruções conferido (o mesmo nos dois backends)
+    uint64_t puladas_a;       // desse orçamento, o que cada lado não executou (laços ociosos, FX0A)
+    uint64_t puladas_b;
+    uint64_t frame;           // frame da divergência
+    uint32_t instrucao;       // instrução do frame (1 = primeira) após a qual os estados diferem; 0 = só nos timers
+    std::unique_ptr<EstadoChip8> estado_a, estado_b; // estados divergentes
+    // últimas instruções (até TAM_RASTRO) do frame divergente até a divergência, pelo interpretador: pc e opcode
+    std::vector<std::pair<uint16_t, uint16_t>> rastro;
+};
+
+// Roda a partir de inicial (ROM já na memória do estado) até frames ou até a primeira divergência
+void executar_diferencial(const EstadoChip8 &inicial, const ConfigDiferencial &cfg, ResultadoDiferencial &res);
+
+void imprimir_resultado_diferencial(FILE *saida, const ConfigDiferencial &cfg, const ResultadoDiferencial &res);
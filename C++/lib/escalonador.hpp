@@ -0,0 +1,78 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// Divide as instruções de um segundo entre os 60 frames em aritmética inteira: o frame n executa
+// floor((n+1)*hz/60) - floor(n*hz/60) instruções, então 60 frames dão exatamente hz instruções,
+// sem erro de ponto flutuante acumulado e sem o mínimo artificial de uma instrução por frame
+// (abaixo de 60 Hz alguns frames simplesmente não executam nada).
+// Com instr_por_frame > 0 o número é fixo e hz é ignorado.
+class DivisorCiclos
+{
+public:
+    explicit DivisorCiclos(int hz, int instr_por_frame = 0)
+        : hz(hz > 0 ? (uint32_t)hz : 0), fixo(instr_por_frame > 0 ? (uint32_t)instr_por_frame : 0), resto(0) {}
+
+    uint32_t proximo()
+    {
+        if (fixo)
+            return fixo;
+        resto += hz;
+        uint32_t n = resto / 60;
+        resto %= 60;
+        return n;
+    }
+
+    // Soma de proximo() pelos próximos frames, sem chamá-lo frame a frame
+    uint64_t avancar(uint64_t frames)
+    {
+        if (fixo)
+            return fixo * frames;
+        // resto < 60 e hz cabe em 32 bits: o produto só estoura com ~2^32 frames
+        uint64_t total = resto + (uint64_t)hz * frames;
+        resto = (uint32_t)(total % 60);
+        return total / 60;
+    }
+
+private:
+    uint32_t hz;
+    uint32_t fixo;
+    uint32_t resto;
+};
+
+// Relógio de frames de tempo real. Os prazos são absolutos (inicio + n/hz) sobre steady_clock,
+// então o erro de cada espera não se acumula. A espera é híbrida: dorme até pouco antes do prazo
+// (a granularidade do sleep do SO fica em ~1 ms) e gira o restante.
+// Depois de um engasgo (janela arrastada, depurador, swap) aguardar() devolve vários frames de
+// uma vez para recuperar o tempo perdido, até max_atraso; além disso o atraso é descartado e o
+// relógio recomeça do instante atual, em vez de acelerar por segundos.
+class RelogioFrames
+{
+public:
+    typedef std::chrono::steady_clock Relogio;
+
+    explicit RelogioFrames(double hz_alvo = 60.0, uint32_t max_atraso = 6);
+
+    void iniciar();
+    // Espera o próximo prazo e devolve quantos frames executar agora (1..max_atraso)
+    uint32_t aguardar();
+
+    double hz_alvo() const { return alvo; }
+    double hz_alcancado() const; // frames contados desde iniciar() / tempo decorrido
+    uint64_t frames_recuperados() const { return n_recuperados; }
+    uint64_t frames_descartados() const { return n_descartados; }
+    void imprimir_relatorio(FILE *saida) const;
+
+private:
+    double alvo;
+    uint32_t max_atraso;
+    Relogio::time_point inicio;     // instante do frame de referência
+    uint64_t proximo;               // índice do próximo frame desde inicio
+    Relogio::time_point t_iniciar;  // para o relatório
+    uint64_t n_frames;              // frames entregues desde iniciar()
+    uint64_t n_recuperados;
+    uint64_t n_descartados;
+
+    Relogio::time_point prazo(uint64_t frame) const;
+};
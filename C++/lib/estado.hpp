@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <vector>
+#include "quirks.hpp"
+
+class Chip8;
+
+// Savestate: todo o estado observável de um Chip8 num bloco de tamanho fixo, sem ponteiros nem
+// alocação. A memória tem espaço para os 64 KB do XO-CHIP, mas só os tamanho_estado() primeiros
+// bytes valem: nos outros perfis a memória acima de 0x1000 não é escrita nem lida, e o arquivo em
+// disco (ordem de bytes do host) traz só esse prefixo, ~6,5 KB fora do XO-CHIP.
+// O cache de decodificação e o código do JIT não fazem parte do estado: são reconstruídos.
+struct EstadoChip8
+{
+    uint32_t magica; // MAGICA_ESTADO
+    uint16_t versao; // VERSAO_ESTADO
+    uint16_t pc;
+    uint64_t estado_rng;
+    uint64_t tela[32];
+    uint16_t indiceI;
+    uint16_t teclas; // bit k = tecla k pressionada
+    uint16_t pilha[16];
+    uint8_t registradores[16];
+    uint8_t ponteiro_pilha;
+    uint8_t temporizador_delay;
+    uint8_t temporizador_som;
+    uint8_t aguardando_tecla;
+    uint8_t reg_aguardando_tecla;
+    uint8_t quirks;          // Quirks (0 = moderno)
+    uint8_t alta_resolucao;  // SUPER-CHIP/XO-CHIP: campos até tela_alta só valem nesses perfis (zero nos demais)
+    uint8_t planos;          // FN01
+    uint8_t tom;             // FX3A
+    uint8_t reservado[3];
+    uint8_t flags[16];       // FX75/FX85
+    uint8_t padrao_som[16];  // F002
+    uint64_t tela_alta[2][64][2]; // plano, linha, metade (ver ExtensaoChip8)
+    uint8_t memoria[0x10000];
+};
+
+const uint32_t MAGICA_ESTADO = 0x53453843; // "C8ES"
+const uint16_t VERSAO_ESTADO = 2;          // 1: só 4 KB de memória e sem os campos estendidos (ainda lida)
+
+// Bytes de e que fazem parte do estado: tudo até a memória, mais 4 KB ou 64 KB (XO-CHIP) dela
+size_t tamanho_estado(const EstadoChip8 &e);
+// Compara só os bytes válidos (tamanho_estado)
+bool estados_iguais(const EstadoChip8 &a, const EstadoChip8 &b);
+// Mesmo valor de Chip8::VM_HashTela() para a VM de onde o estado saiu
+uint64_t hash_tela_estado(const EstadoChip8 &e);
+
+// Leitura e escrita no formato de arquivo, para os savestates e para quem embute um estado no
+// próprio arquivo (gravações). ler_estado aceita a versão 1 e a converte.
+bool escrever_estado(FILE *f, const EstadoChip8 &e);
+bool ler_estado(FILE *f, EstadoChip8 &e);
+
+bool salvar_estado_arquivo(const EstadoChip8 &estado, const char *arquivo);
+bool carregar_estado_arquivo(EstadoChip8 &estado, const char *arquivo);
+
+// Anel de snapshots em memória, alocado uma vez na construção. registrar() guarda um snapshot a
+// cada intervalo_frames chamadas; quando cheio, sobrescreve o mais antigo. voltar() restaura o
+// mais recente e o descarta, então chamadas repetidas andam para trás no tempo. Cada posição guarda
+// só os tamanho_estado() bytes do snapshot; o primeiro estado XO-CHIP aumenta as posições (e
+// esvazia o anel).
+class AnelEstados
+{
+public:
+    AnelEstados(size_t capacidade, uint32_t intervalo_frames);
+
+    void registrar(const Chip8 &vm); // chamar uma vez por frame
+    bool voltar(Chip8 &vm);          // false se o anel está vazio
+    size_t tamanho() const { return n; }
+    void limpar();
+
+private:
+    std::vector<uint8_t> dados;              // capacidade posições de tam_posicao bytes
+    std::unique_ptr<EstadoChip8> temporario; // snapshot completo entre a VM e o anel
+    size_t capacidade;
+    size_t tam_posicao;
+    size_t inicio; // índice do mais antigo
+    size_t n;      // snapshots válidos
+    uint32_t intervalo;
+    uint32_t frames_desde_ultimo;
+};
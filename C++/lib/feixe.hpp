@@ -0,0 +1,65 @@
+#pragma once
+#include "chip8.hpp"
+
+// Feixe de VMs CHIP-8 executando a mesma ROM em passo travado (lockstep), com o estado em
+// estrutura de vetores: cada registrador guarda o valor de todas as faixas lado a lado, de forma
+// que uma instrução de ALU vira uma operação vetorial sobre FAIXAS instâncias de uma vez.
+//
+// A cada passo, se todas as faixas ativas estão no mesmo pc, a instrução é decodificada uma vez e
+// aplicada a todas. Quando os pcs divergem (skips, BNNN, RET com pilhas diferentes), as faixas são
+// agrupadas por pc e cada grupo executa com uma máscara; uma faixa sozinha no seu pc é, na
+// prática, execução escalar. Os grupos voltam a se juntar quando os pcs coincidem de novo.
+// Toda faixa executa exatamente uma instrução por passo, então o resultado de cada faixa é o mesmo
+// de um Chip8 separado com as mesmas entradas.
+class FeixeChip8
+{
+public:
+    static const int FAIXAS = 32;
+
+    FeixeChip8();
+
+    // Copia o estado de modelo (ROM já carregada, pc inicial, semente...) para todas as faixas.
+    // Faixas com a mesma semente e as mesmas teclas seguem juntas pelo caminho vetorial.
+    // O feixe executa só o perfil de quirks moderno; quem o usa confere VM_Quirks() do modelo.
+    void VM_Iniciar(const Chip8 &modelo);
+    // Copia o estado de uma faixa para um Chip8 comum (inspeção ou continuar em escalar)
+    void VM_ExportarFaixa(int faixa, Chip8 &destino) const;
+
+    void VM_DefinirSemente(int faixa, uint64_t semente);
+    void VM_DefinirTecla(int faixa, uint8_t tecla, bool pressionada);
+    void VM_Executar(uint32_t n); // n instruções em cada faixa
+    void tickTimers();
+    uint64_t VM_HashTela(int faixa) const;
+
+    uint64_t passos_uniformes() const { return n_uniformes; }
+    uint64_t passos_divergentes() const { return n_divergentes; }
+
+private:
+    // estado por faixa; arrays [campo][faixa] para que cada linha seja um vetor
+    alignas(64) uint8_t registradores[16][FAIXAS];
+    alignas(64) uint16_t pc[FAIXAS];
+    alignas(64) uint16_t indiceI[FAIXAS];
+    alignas(64) uint8_t temporizador_delay[FAIXAS];
+    alignas(64) uint8_t temporizador_som[FAIXAS];
+    alignas(64) uint8_t ponteiro_pilha[FAIXAS];
+    alignas(64) uint8_t ativa[FAIXAS]; // 0xFF = executa; 0 = parada em FX0A
+    alignas(64) uint16_t pilha[16][FAIXAS];
+    uint8_t reg_aguardando_tecla[FAIXAS];
+    uint16_t teclas[FAIXAS]; // bit k = tecla k pressionada
+    uint64_t estado_rng[FAIXAS];
+    uint64_t tela[FAIXAS][ALTURA_TELA];
+    uint8_t memoria[FAIXAS][4096];
+
+    // Instruções decodificadas a partir da memória da faixa 0. Endereços que alguma faixa já
+    // escreveu ficam marcados em pode_diferir e são comparados entre as faixas antes do uso.
+    Decodificada cache_decod[4096];
+    bool pode_diferir[4096];
+
+    uint64_t n_uniformes;
+    uint64_t n_divergentes;
+
+    void escrever_memoria(int faixa, uint16_t endereco, uint8_t valor);
+    bool mesma_instrucao(uint16_t endereco, const uint8_t *mascara) const;
+    void executar_grupo(const Decodificada &d, const uint8_t *mascara);
+    void executar_faixa(int faixa);
+};
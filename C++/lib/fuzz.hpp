@@ -0,0 +1,123 @@
+#pragma once
+#include "chip8.hpp"
+#include "lote.hpp"
+#include <string>
+#include <vector>
+
+// Modo fuzz: muitas execuções curtas de uma ROM, cada uma com uma sequência de teclas (e,
+// opcionalmente, bytes da ROM) obtida por mutação de uma entrada do corpus. O interpretador
+// instrumentado (Chip8::VM_ColetarFuzz) marca os pcs executados e conta as arestas pc anterior ->
+// pc num mapa no estilo do AFL; uma entrada que alcança uma aresta ou uma faixa de contagem nova
+// entra no corpus. Cada thread reinicia a sua VM a partir da ROM congelada (VM_ReiniciarDe), então
+// uma execução custa as instruções dela mais as páginas de memória que escreveu.
+//
+// Acessos que num CHIP-8 real sairiam dos limites (o emulador dá a volta e segue) são violações
+// da ROM; a primeira entrada de cada par (violação, pc) é gravada como uma sessão que
+// --reproduzir repete (gravacao.hpp).
+
+const int TAM_MAPA_ARESTAS = 1 << 14; // com o mapa de faixas já vistas, cabe no L1
+const int TAM_PCS_FUZZ = 0x10000;      // pcs possíveis: o XO-CHIP executa código até 0xFFFF
+
+enum Violacao : uint8_t
+{
+    VIOLACAO_PILHA_CHEIA,     // 2NNN com a pilha cheia: o ponteiro dá a volta
+    VIOLACAO_PILHA_VAZIA,     // 00EE sem endereço de retorno
+    VIOLACAO_LEITURA,         // leitura por I além do fim da memória (DXYN, FX65, 5XY3, F002)
+    VIOLACAO_ESCRITA,         // escrita por I além do fim da memória (FX33, FX55, 5XY2)
+    VIOLACAO_ESCRITA_SISTEMA, // escrita por I abaixo de 0x200 (fontes)
+    VIOLACAO_PC,              // instrução buscada fora de 0x200..0xFFE
+    VIOLACAO_INSTRUCAO,       // opcode que o perfil não define (executado como NOP)
+    VIOLACAO_TOTAL
+};
+
+const char *nome_violacao(Violacao v);
+
+// Preenchida pela VM durante uma execução; limpar() antes de cada uma
+struct ColetaFuzz
+{
+    uint8_t arestas[TAM_MAPA_ARESTAS]; // execuções de cada aresta (por hash), saturadas em 255
+    uint64_t pcs[TAM_PCS_FUZZ / 64];   // bit = endereço executado
+    uint16_t anterior;                 // hash do pc anterior >> 1: A->B e B->A caem em posições diferentes
+    uint32_t violacoes;                // bit v = Violacao v ocorreu
+    uint16_t pc_violacao[VIOLACAO_TOTAL];       // primeira ocorrência de cada uma
+    uint32_t endereco_violacao[VIOLACAO_TOTAL]; // I, SP, pc ou o opcode, conforme a violação
+
+    void limpar();
+
+    // Marca pc e a aresta vinda do pc cujo hash deu anterior; devolve o anterior da próxima
+    // (o laço do interpretador o mantém num registrador)
+    uint16_t visitar(uint16_t pc, uint16_t anterior)
+    {
+        pcs[pc >> 6] |= 1ull << (pc & 63);
+        uint16_t h = (uint16_t)((pc * 0x9E3779B1u) >> 18);
+        uint8_t &c = arestas[h ^ anterior];
+        c += c != 255;
+        return h >> 1;
+    }
+
+    void registrar(Violacao v, uint16_t pc, uint32_t endereco)
+    {
+        if (violacoes & (1u << v))
+            return;
+        violacoes |= 1u << v;
+        pc_violacao[v] = pc;
+        endereco_violacao[v] = endereco;
+    }
+};
+
+// Byte trocado na memória logo depois do reset (mutação da ROM)
+struct RemendoROM
+{
+    uint16_t endereco;
+    uint8_t valor;
+};
+
+struct EntradaFuzz
+{
+    std::vector<EventoTecla> eventos; // em ordem de frame, como num roteiro do lote
+    std::vector<RemendoROM> remendos;
+};
+
+// Escreve os remendos na memória da VM (como escritas da própria ROM: o cache de decodificação
+// e as páginas sujas acompanham; no XO-CHIP os acima de 0x0FFF vão para a memória alta)
+void aplicar_remendos_fuzz(Chip8 &vm, const EntradaFuzz &entrada);
+
+struct ConfigFuzz
+{
+    int hz;
+    uint64_t frames;        // duração de cada execução
+    uint64_t execucoes;     // para depois de tantas execuções (0 = sem limite) ...
+    double segundos;        // ... ou de tanto tempo de parede (0 = sem limite)
+    unsigned n_threads;     // 0 = uma por núcleo
+    uint64_t semente;       // das mutações; o CXNN segue a semente da VM modelo
+    bool mutar_rom;         // além das teclas, troca bytes da ROM
+    uint32_t tam_rom;       // bytes a partir de 0x200 que mutar_rom pode trocar (até o fim da memória do perfil)
+    std::string dir_achados; // onde gravar as sessões das violações ("" = não grava)
+    bool progresso;         // uma linha de andamento em stderr por segundo
+};
+
+struct AchadoFuzz
+{
+    Violacao tipo;
+    uint16_t pc;
+    uint32_t endereco;
+    uint64_t execucao; // número da execução que achou
+    std::string arquivo; // gravação ("" se não gravada)
+};
+
+struct ResultadoFuzz
+{
+    uint64_t execucoes;
+    uint64_t instrucoes;
+    double segundos;
+    size_t corpus;    // entradas guardadas (inclui a inicial, sem teclas)
+    uint32_t arestas; // posições do mapa alcançadas
+    uint32_t pcs;     // endereços executados
+    std::vector<AchadoFuzz> achados;
+};
+
+// Roda o fuzz a partir do estado atual de modelo (ROM carregada, perfil e semente definidos). A
+// memória do modelo é congelada (VM_CompartilharMemoria) e ele não é executado.
+void executar_fuzz(Chip8 &modelo, const ConfigFuzz &cfg, ResultadoFuzz &res);
+
+void imprimir_resultado_fuzz(FILE *saida, const ResultadoFuzz &res);
@@ -0,0 +1,64 @@
+#pragma once
+#include "chip8.hpp"
+#include "lote.hpp"
+#include <memory>
+#include <vector>
+
+// Gravação de uma sessão para reprodução determinística. Guarda o estado de partida inteiro (a
+// ROM vai junto, na memória do savestate), o ritmo de instruções, os eventos de tecla com o
+// frame em que foram aplicados e um hash da tela a cada INTERVALO_CONFERENCIA frames. Como a
+// VM é determinística (semente no estado, timers por frame), reproduzir os eventos nos mesmos
+// frames gera as mesmas telas; os hashes confirmam isso e apontam o primeiro trecho divergente.
+//
+// Arquivo (ordem de bytes do host, como os savestates): CabecalhoGravacao, EstadoChip8 (como em
+// escrever_estado), eventos compactados (distância em frames do evento anterior em LEB128 + um
+// byte tecla | pressionada << 4) e os hashes de 8 bytes. Uma partida típica de poucos minutos fica
+// em ~7 KB (~70 KB no XO-CHIP, por causa da memória).
+struct CabecalhoGravacao
+{
+    uint32_t magica; // MAGICA_GRAVACAO
+    uint16_t versao; // VERSAO_GRAVACAO
+    uint16_t reservado;
+    uint32_t hz;              // instruções por segundo (DivisorCiclos)
+    uint32_t instr_por_frame; // 0 = derivado de hz
+    uint64_t frames;          // duração da sessão
+    uint32_t n_eventos;
+    uint32_t n_hashes;
+};
+
+const uint32_t MAGICA_GRAVACAO = 0x4E493843; // "C8IN"
+const uint16_t VERSAO_GRAVACAO = 1;
+const uint64_t INTERVALO_CONFERENCIA = 60;
+
+struct GravacaoEntrada
+{
+    int hz;
+    int instr_por_frame;
+    uint64_t frames;
+    std::unique_ptr<EstadoChip8> inicial;
+    std::vector<EventoTecla> eventos;  // em ordem de frame
+    std::vector<uint64_t> hashes;      // hashes[i] = VM_HashTela() após (i+1)*INTERVALO_CONFERENCIA frames
+
+    // Começa uma gravação a partir do estado atual da VM
+    void iniciar(const Chip8 &vm, int hz, int instr_por_frame);
+    // Evento aplicado antes do próximo frame
+    void tecla(uint8_t tecla, bool pressionada);
+    // Chamar depois de cada frame executado
+    void fim_de_frame(const Chip8 &vm);
+};
+
+bool salvar_gravacao(const GravacaoEntrada &g, const char *arquivo);
+bool carregar_gravacao(GravacaoEntrada &g, const char *arquivo);
+
+struct ResultadoReproducao
+{
+    ResultadoHeadless execucao;
+    bool identica;             // todos os hashes conferiram
+    uint64_t frame_divergente; // primeiro frame de conferência com hash diferente (se !identica)
+    uint64_t hash_final;
+};
+
+// Reproduz a sessão sem limite de velocidade numa VM nova (JIT opcional; com rastro, a VM grava
+// nele cada instrução e o JIT fica parado)
+void reproduzir_gravacao(const GravacaoEntrada &g, bool usar_jit, ResultadoReproducao &res,
+                         RastroChip8 *rastro = nullptr);
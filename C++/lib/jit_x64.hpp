@@ -0,0 +1,102 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Entrada/saída de uma chamada ao código nativo
+struct ControleJIT
+{
+    uint32_t orcamento; // entrada: instruções que ainda podem ser executadas; saída: o que sobrou
+    uint16_t pc;        // saída: próximo pc
+    uint16_t teclas;    // entrada: bit k = tecla k pressionada (EX9E/EXA1)
+    uint8_t *ligacao;   // saída: saída do bloco que pode ser ligada direto ao destino (ou nullptr)
+    uint8_t volta;      // saída: 1 se o bloco saiu por um JP para trás (quem chama zera)
+    const uint8_t *voltas;  // entrada: por destino, == geracao_voltas se o JP para trás segue ligado
+    uint8_t geracao_voltas; // (ver JitX64::iniciar_voltas)
+};
+
+// Bloco de código nativo. Argumentos: V0..VF, I, delay timer, sound timer, memória e controle.
+using FuncaoBloco = void (*)(uint8_t *registradores, uint16_t *indiceI,
+                             uint8_t *temporizador_delay, uint8_t *temporizador_som,
+                             const uint8_t *memoria, ControleJIT *ctl);
+
+struct BlocoJIT
+{
+    FuncaoBloco codigo; // nullptr = endereço não compilável
+    uint16_t n_instr;   // instruções cobertas pelo bloco, incluindo a que o encerra
+    bool tentado;       // já tentamos compilar a partir deste endereço
+};
+
+// Recompilador dinâmico de blocos básicos para x86-64 (Linux).
+// Um bloco é uma sequência em linha reta de instruções de registrador/timer (6XNN, 7XNN, 8XY*,
+// ANNN, FX07/15/18/1E/29/65) que termina num salto ou skip (1NNN, BNNN, 3XNN, 4XNN, 5XY0, 9XY0,
+// EX9E, EXA1) ou na primeira instrução que fica com o interpretador (CALL/RET, DRW, RND, FX0A,
+// FX33, FX55...). Saídas com destino fixo são ligadas direto ao bloco de destino depois da
+// primeira execução, então laços inteiros rodam sem voltar ao C++ enquanto houver orçamento.
+// Um JP para trás ligado só segue direto enquanto quem chama o deixa liberado (ligar_volta até o
+// próximo iniciar_voltas); senão retorna marcando ControleJIT::volta, para que o laço possa ser
+// examinado (laços ociosos, ver Chip8::executar_jit).
+// Qualquer escrita em memória coberta por um bloco descarta todo o código gerado.
+// O buffer nunca é gravável e executável ao mesmo tempo (W^X): as páginas de um bloco ficam
+// graváveis só enquanto ele é emitido ou tem uma saída ligada, e executáveis depois.
+class JitX64
+{
+public:
+    static const int MAX_INSTR_BLOCO = 32;
+
+    JitX64();
+    ~JitX64();
+    JitX64(const JitX64 &) = delete;
+    JitX64 &operator=(const JitX64 &) = delete;
+
+    // false quando a plataforma não é suportada ou a memória executável não pôde ser alocada
+    bool disponivel() const { return buffer != nullptr; }
+
+    // Bloco que começa em endereco, compilando-o na primeira visita; nullptr se não houver
+    const BlocoJIT *bloco(uint16_t endereco, const uint8_t *memoria)
+    {
+        BlocoJIT &b = blocos[endereco & 0x0FFF];
+        if (!b.tentado)
+            compilar(endereco & 0x0FFF, memoria);
+        return b.codigo ? &b : nullptr;
+    }
+
+    // Faz a saída em ligacao saltar direto para o bloco de destino, se ele existir
+    void ligar(uint8_t *ligacao, uint16_t destino, const uint8_t *memoria);
+
+    // Revoga as liberações: nenhum JP para trás segue ligado
+    void iniciar_voltas(ControleJIT &ctl)
+    {
+        if (++geracao_voltas == 0)
+        {
+            for (uint8_t &v : voltas)
+                v = 0;
+            geracao_voltas = 1;
+        }
+        ctl.voltas = voltas;
+        ctl.geracao_voltas = geracao_voltas;
+    }
+    // Liga a saída de um JP para trás (ctl.volta) e a libera até o próximo iniciar_voltas
+    void ligar_volta(uint8_t *ligacao, uint16_t destino, const uint8_t *memoria);
+
+    // byte escrito em endereco; só custa algo se o byte faz parte de código gerado
+    void invalidar(uint16_t endereco)
+    {
+        if (coberto[endereco & 0x0FFF])
+            invalidar_tudo();
+    }
+    void invalidar_tudo();
+
+private:
+    BlocoJIT blocos[4096];
+    bool coberto[4096]; // byte pertence a algum bloco compilado
+    uint8_t *buffer;    // código gerado (ver proteger)
+    size_t tam_buffer;
+    size_t usado;
+    uint32_t geracao; // incrementa a cada descarte do buffer
+    uint8_t voltas[4096]; // por destino: geracao_voltas da chamada em que o JP para trás foi liberado
+    uint8_t geracao_voltas;
+
+    void compilar(uint16_t endereco, const uint8_t *memoria);
+    // Páginas de [inicio, inicio + tam) graváveis (RW) ou executáveis (RX); false se o SO recusar
+    bool proteger(uint8_t *inicio, size_t tam, bool gravar);
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include "chip8.hpp"
+#include <vector>
+
+// Evento de um roteiro de entrada: no início do frame indicado a tecla muda de estado
+struct EventoTecla
+{
+    uint64_t frame;
+    uint8_t tecla;
+    bool pressionada;
+};
+
+// Uma execução de um lote: ROM, semente, roteiro de entrada e orçamento de frames
+struct TarefaLote
+{
+    std::string rom;
+    uint64_t hash_rom;               // hash esperado do conteúdo da ROM (0 = não conferir)
+    uint64_t semente;                // semente do CXNN (VM_DefinirSemente)
+    std::string roteiro;             // arquivo do roteiro de entrada ("" ou "-" = sem entrada)
+    std::string estado;              // savestate de onde a tarefa parte ("" = do reset)
+    uint64_t frames;                 // frames virtuais de 60Hz a simular
+    std::vector<EventoTecla> eventos; // roteiro já lido, ordenado por frame
+};
+
+// Estado final de uma tarefa, gravado no relatório do lote
+struct ResultadoLote
+{
+    bool ok;             // false se a ROM ou o roteiro não puderam ser lidos
+    uint64_t instrucoes; // instruções executadas
+    uint64_t puladas;    // orçamento não executado (laços ociosos, espera em FX0A)
+    uint64_t frames;     // frames simulados
+    uint64_t hash_tela;  // VM_HashTela() ao final
+    uint16_t pc;
+    uint16_t indiceI;
+    uint8_t registradores[16];
+    double segundos; // tempo de parede da tarefa
+};
+
+// Lê a lista de tarefas: uma por linha, "<rom>[@hash] <frames> [semente] [roteiro] [estado]"; '#'
+// inicia comentário; "-" no roteiro = sem entrada. Caminhos relativos de ROM e roteiro são resolvidos a partir do diretório da lista.
+// Com @hash (16 dígitos hex, como em --indexar) a tarefa falha se o conteúdo da ROM for outro.
+bool ler_lista_tarefas(const char *arquivo, std::vector<TarefaLote> &tarefas);
+
+// Lê um roteiro de entrada: uma linha por evento, "<frame> <tecla hex> <1|0>"
+bool ler_roteiro_entrada(const std::string &arquivo, std::vector<EventoTecla> &eventos);
+
+// Executa todas as tarefas em n_threads threads (0 = uma por núcleo), cada uma com sua própria
+// VM headless. Cada ROM distinta é aberta uma vez antes das threads começarem e a mesma imagem
+// somente leitura serve todas as tarefas que a usam; o mesmo vale para os savestates de partida.
+// Cada par ROM/savestate vira uma VM modelo congelada, de onde a VM da thread reinicia a cada
+// tarefa (VM_ReiniciarDe). Com estado, a tarefa parte do snapshot restaurado sobre a ROM e roda
+// frames a partir dele (os frames do roteiro contam a partir desse ponto). As tarefas são distribuídas em filas por thread; uma thread que esvazia a sua
+// rouba do fim da fila das outras. resultados[i] corresponde a tarefas[i].
+void executar_lote(const std::vector<TarefaLote> &tarefas, std::vector<ResultadoLote> &resultados,
+                   unsigned n_threads, int fps, bool usar_jit);
+
+void imprimir_resultados_lote(FILE *saida, const std::vector<TarefaLote> &tarefas,
+                              const std::vector<ResultadoLote> &resultados);
@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+
+// Perfis de compatibilidade para as instruções cujo comportamento mudou entre implementações do
+// CHIP-8. O valor 0 é o comportamento histórico deste emulador, então savestates antigos (que têm
+// zero no campo) continuam iguais.
+enum Quirks : uint8_t
+{
+    QUIRKS_MODERNO = 0, // deslocamento de Vx no lugar, I fixo em FX55/FX65, sprites dão a volta
+    QUIRKS_COSMAC_VIP,  // interpretador original do COSMAC VIP (1977)
+    QUIRKS_CHIP48,      // CHIP-48 das calculadoras HP-48 (1990)
+    QUIRKS_SCHIP,       // SUPER-CHIP 1.1: tela 128x64, scroll, sprites 16x16, fonte grande
+    QUIRKS_XOCHIP,      // XO-CHIP (Octo): SUPER-CHIP + 64 KB de memória, dois planos, som por padrão
+    QUIRKS_TOTAL
+};
+
+// Regras de cada perfil, resolvidas em tempo de compilação: o interpretador é instanciado uma vez
+// por perfil (Chip8::interpretar_quirks<Q>) e cada regra vira um if constexpr nos manipuladores,
+// sem teste nenhum no laço quente. superchip e xochip também ligam as instruções e a tela
+// estendidas; nos outros perfis essas instruções continuam sendo NOP.
+template <Quirks Q>
+struct RegrasQuirks;
+
+template <>
+struct RegrasQuirks<QUIRKS_MODERNO>
+{
+    static constexpr bool zerar_vf_logica = false;  // 8XY1/8XY2/8XY3 zeram VF
+    static constexpr bool deslocar_vy = false;      // 8XY6/8XYE: Vx = Vy deslocado (senão Vx no lugar)
+    static constexpr bool incrementar_i = false;    // FX55/FX65 avançam I ...
+    static constexpr int extra_i = 0;               // ... em x + extra_i
+    static constexpr bool recortar_sprites = false; // DXYN corta na borda em vez de dar a volta
+    static constexpr bool salto_vx = false;         // BNNN soma VX (X = nibble alto de NNN) em vez de V0
+    static constexpr bool superchip = false;        // 00CN/00FB-00FF, DXY0, FX30, FX75/FX85, tela 128x64
+    static constexpr bool xochip = false;           // 00DN, 5XY2/5XY3, F000 NNNN, FN01, F002, FX3A, 64 KB
+};
+
+template <>
+struct RegrasQuirks<QUIRKS_COSMAC_VIP>
+{
+    static constexpr bool zerar_vf_logica = true;
+    static constexpr bool deslocar_vy = true;
+    static constexpr bool incrementar_i = true;
+    static constexpr int extra_i = 1;
+    static constexpr bool recortar_sprites = true;
+    static constexpr bool salto_vx = false;
+    static constexpr bool superchip = false;
+    static constexpr bool xochip = false;
+};
+
+template <>
+struct RegrasQuirks<QUIRKS_CHIP48>
+{
+    static constexpr bool zerar_vf_logica = false;
+    static constexpr bool deslocar_vy = false;
+    static constexpr bool incrementar_i = true;
+    static constexpr int extra_i = 0; // erro do CHIP-48: I termina em I + x
+    static constexpr bool recortar_sprites = true;
+    static constexpr bool salto_vx = true;
+    static constexpr bool superchip = false;
+    static constexpr bool xochip = false;
+};
+
+template <>
+struct RegrasQuirks<QUIRKS_SCHIP>
+{
+    static constexpr bool zerar_vf_logica = false;
+    static constexpr bool deslocar_vy = false;
+    static constexpr bool incrementar_i = false;
+    static constexpr int extra_i = 0;
+    static constexpr bool recortar_sprites = true;
+    static constexpr bool salto_vx = true;
+    static constexpr bool superchip = true;
+    static constexpr bool xochip = false;
+};
+
+template <>
+struct RegrasQuirks<QUIRKS_XOCHIP>
+{
+    static constexpr bool zerar_vf_logica = false;
+    static constexpr bool deslocar_vy = true;
+    static constexpr bool incrementar_i = true;
+    static constexpr int extra_i = 1;
+    static constexpr bool recortar_sprites = false;
+    static constexpr bool salto_vx = false;
+    static constexpr bool superchip = true;
+    static constexpr bool xochip = true;
+};
+
+// Perfis com a tela de 128x64 e o estado de ExtensaoChip8
+inline bool quirks_estendido(Quirks q)
+{
+    return q == QUIRKS_SCHIP || q == QUIRKS_XOCHIP;
+}
+
+// "moderno", "vip", "chip48", "schip" ou "xochip"; false se o nome não existe
+bool ler_quirks(const char *nome, Quirks &q);
+const char *nome_quirks(Quirks q);
+
+// Perfil conhecido para o conteúdo de uma ROM (hash_rom); QUIRKS_MODERNO se ela não está na tabela
+Quirks quirks_da_rom(uint64_t hash);
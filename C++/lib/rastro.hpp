@@ -0,0 +1,164 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Rastro de execução: para cada instrução interpretada, o pc, o opcode e os registradores que ela
+// mudou. A VM (Chip8::VM_Rastrear) escreve entradas de tamanho fixo num anel que é só dela, sem
+// travas nem chamadas no laço; uma thread escritora por rastro esvazia o anel, codifica as entradas
+// num formato compacto e grava o arquivo. O anel só é publicado ao fim de cada VM_Executar ou
+// quando enche (aí a VM espera a escritora), então o custo no laço é copiar os registradores antes
+// da instrução e comparar depois. Cada VM tem o seu rastro: várias threads podem rastrear ao mesmo
+// tempo, cada uma para o seu arquivo.
+//
+// O analisador (ferramentas/chip8_rastro.cpp, make rastro) lê o arquivo com LeitorRastro.
+
+// Bits de EntradaRastro::mudou para uma instrução
+const uint32_t MUDOU_V0 = 1u << 0; // V0..VF: bits 0..15
+const uint32_t MUDOU_I = 1u << 16;
+const uint32_t MUDOU_SP = 1u << 17;
+const uint32_t MUDOU_DT = 1u << 18;
+const uint32_t MUDOU_ST = 1u << 19;
+
+enum TipoRastro : uint8_t
+{
+    RASTRO_INSTRUCAO,
+    RASTRO_FRAMES, // n frames terminaram (tickTimers, ou VM_AvancarOcioso parado em FX0A)
+    RASTRO_PULO,   // n instruções de um laço ocioso puladas pelo interpretador (o salto é a entrada anterior)
+};
+
+// Entrada do anel (32 bytes): o estado depois da instrução; o escritor grava só o que mudou
+struct EntradaRastro
+{
+    uint16_t pc;
+    uint16_t opcode;
+    uint32_t mudou; // RASTRO_INSTRUCAO: bits MUDOU_*; marcadores: n
+    uint8_t v[16];
+    uint16_t i;
+    uint8_t sp;
+    uint8_t dt;
+    uint8_t st;
+    uint8_t tipo; // TipoRastro
+};
+
+// Arquivo .c8t (ordem de bytes do host no cabeçalho): CabecalhoRastro e uma sequência de registros
+// começando por um byte de marca:
+//   0..3         instrução: bit 0 = pc explícito (2 bytes) em vez de pc anterior + 2, bit 1 = há
+//                mudanças; opcode (2 bytes, como na memória); se houver mudanças, LEB128 dos bits
+//                MUDOU_* e os valores novos nessa ordem (V: 1 byte, I: 2 bytes, SP/DT/ST: 1 byte)
+//   MARCA_FRAMES LEB128 n
+//   MARCA_PULO   LEB128 n
+// Uma instrução sequencial que só mexe em um registrador ocupa 5 bytes.
+struct CabecalhoRastro
+{
+    uint32_t magica; // MAGICA_RASTRO
+    uint16_t versao; // VERSAO_RASTRO
+    uint8_t quirks;  // perfil da VM ao abrir (Quirks)
+    uint8_t reservado;
+    uint64_t instrucoes; // preenchidos ao fechar
+    uint64_t frames;
+};
+
+const uint32_t MAGICA_RASTRO = 0x52543843; // "C8TR"
+const uint16_t VERSAO_RASTRO = 1;
+const uint8_t MARCA_PC = 1;
+const uint8_t MARCA_MUDANCAS = 2;
+const uint8_t MARCA_FRAMES = 0x40;
+const uint8_t MARCA_PULO = 0x41;
+
+class RastroChip8
+{
+public:
+    static const uint32_t CAPACIDADE = 1u << 16; // entradas no anel (2 MB)
+
+    RastroChip8();
+    ~RastroChip8();
+
+    // Cria o arquivo e inicia a thread escritora
+    bool abrir(const char *caminho, uint8_t quirks);
+    // Espera a escritora gravar tudo o que foi publicado e completa o cabeçalho
+    bool fechar();
+
+    uint64_t instrucoes() const { return n_instrucoes; }
+    uint64_t frames() const { return n_frames; }
+    uint64_t bytes() const { return n_bytes; }
+
+    // Lado da VM. O laço do interpretador mantém cabeca e limite em locais e escreve direto em
+    // anel; publicar() entrega à escritora as entradas até cabeca.
+    EntradaRastro *entradas() { return anel.get(); }
+    uint64_t posicao() const { return cabeca; }
+    uint64_t limite() const { return consumido_visto + CAPACIDADE; }
+    void publicar(uint64_t ate)
+    {
+        cabeca = ate;
+        publicado.store(ate, std::memory_order_release);
+    }
+    // Anel cheio: publica, espera a escritora liberar espaço e devolve o novo limite
+    uint64_t esperar_espaco(uint64_t ate);
+    // Marcador fora do laço (frames)
+    void marcar(TipoRastro tipo, uint64_t n);
+
+private:
+    std::unique_ptr<EntradaRastro[]> anel;
+    uint64_t cabeca;          // produtor: próxima entrada a escrever
+    uint64_t consumido_visto; // produtor: último valor lido de consumido
+    alignas(64) std::atomic<uint64_t> publicado;
+    alignas(64) std::atomic<uint64_t> consumido;
+    std::atomic<bool> parar;
+    std::thread escritora;
+
+    // escritora
+    std::string caminho;
+    FILE *arq;
+    bool erro;
+    uint8_t quirks;
+    uint16_t pc_previsto;
+    uint64_t n_instrucoes;
+    uint64_t n_frames;
+    uint64_t n_bytes;
+
+    void escrever_entradas();
+    size_t codificar(const EntradaRastro &e, uint8_t *saida);
+};
+
+// Um registro decodificado; os registradores fora de mudou ficam com o último valor conhecido
+struct RegistroRastro
+{
+    TipoRastro tipo;
+    uint16_t pc;
+    uint16_t opcode;
+    uint32_t mudou;  // RASTRO_INSTRUCAO
+    uint64_t n;      // marcadores
+    uint64_t indice; // número da instrução (a partir de 0, contando as puladas)
+    uint64_t frame;  // frame em que a instrução rodou
+    uint8_t v[16];
+    uint16_t i;
+    uint8_t sp;
+    uint8_t dt;
+    uint8_t st;
+};
+
+class LeitorRastro
+{
+public:
+    LeitorRastro();
+    ~LeitorRastro();
+
+    bool abrir(const char *caminho);
+    // false no fim do arquivo ou num registro inválido (erro() diz qual)
+    bool proximo(RegistroRastro &r);
+    bool erro() const { return invalido; }
+    const CabecalhoRastro &cabecalho() const { return cab; }
+
+private:
+    FILE *arq;
+    CabecalhoRastro cab;
+    RegistroRastro atual;
+    bool invalido;
+};
+
+// Texto de um opcode ("DRW V1, V2, 5"), para listagens
+std::string desmontar_opcode(uint16_t opcode);
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Maior ROM que cabe na memória a partir de 0x200 (nos 64 KB do XO-CHIP; os outros perfis têm 4 KB)
+const size_t TAM_MAX_ROM = 0x10000 - 0x200;
+
+// Hash FNV-1a de 64 bits do conteúdo de uma ROM (identifica a imagem independente do nome)
+uint64_t hash_rom(const uint8_t *dados, size_t tamanho);
+
+// Imagem de ROM somente leitura. Em sistemas POSIX o arquivo é mapeado com mmap e as páginas são
+// compartilhadas entre todas as VMs que carregam a imagem; nos demais é lida uma vez para um
+// buffer próprio. Tamanho e hash são validados ao abrir.
+class ImagemROM
+{
+public:
+    ImagemROM();
+    ~ImagemROM();
+    ImagemROM(const ImagemROM &) = delete;
+    ImagemROM &operator=(const ImagemROM &) = delete;
+
+    // false (com o motivo em erro) se o arquivo não abre, está vazio ou excede TAM_MAX_ROM
+    bool abrir(const std::string &caminho, std::string &erro);
+
+    const uint8_t *dados() const { return ptr; }
+    size_t tamanho() const { return tam; }
+    uint64_t hash() const { return h; }
+    const std::string &caminho() const { return arq; }
+
+private:
+    const uint8_t *ptr;
+    size_t tam;
+    uint64_t h;
+    std::string arq;
+    bool mapeada;                 // ptr veio de mmap
+    std::vector<uint8_t> copia;   // usado quando não há mmap
+};
+
+// Conjunto de imagens abertas uma única vez e reaproveitadas. abrir() não é thread-safe: quem roda
+// em paralelo (o lote) abre tudo antes de iniciar as threads, que depois só leem as imagens.
+class BibliotecaROM
+{
+public:
+    // Imagem do arquivo, abrindo-a na primeira vez; nullptr (e mensagem em stderr) se inválida
+    const ImagemROM *abrir(const std::string &caminho);
+
+    // Abre todos os arquivos regulares do diretório (ex.: c8games/ ou ROMs/); retorna quantos
+    // foram aceitos. Arquivos inválidos são relatados e ficam fora do índice.
+    size_t indexar(const std::string &diretorio);
+
+    // Imagem já aberta com esse conteúdo, ou nullptr
+    const ImagemROM *buscar_hash(uint64_t hash) const;
+
+    // Índice ordenado por nome: "<hash> <tamanho> <caminho>" por linha
+    void imprimir_indice(FILE *saida) const;
+
+    // Imagens abertas, ordenadas por caminho
+    std::vector<const ImagemROM *> imagens() const;
+
+private:
+    std::map<std::string, std::unique_ptr<ImagemROM>> por_caminho;
+    std::map<uint64_t, const ImagemROM *> por_hash;
+};
@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Buffer triplo sem trava para um produtor e um consumidor. O produtor escreve sempre no seu
+// slot e publica trocando-o com o slot do meio; o consumidor pega o slot do meio quando há algo
+// novo. Nenhum lado espera o outro: o produtor nunca bloqueia e o consumidor vê sempre o quadro
+// completo mais recente (quadros intermediários podem ser pulados).
+template <typename T>
+class BufferTriplo
+{
+public:
+    BufferTriplo() : meio(1), escrita(0), leitura(2) {}
+
+    // slot do produtor; válido até o próximo publicar()
+    T &para_escrever() { return slots[escrita].valor; }
+
+    void publicar()
+    {
+        escrita = meio.exchange(escrita | NOVO, std::memory_order_acq_rel) & INDICE;
+    }
+
+    // slot publicado mais recente, ou nullptr se nada foi publicado desde a última leitura
+    const T *ler()
+    {
+        if (!(meio.load(std::memory_order_relaxed) & NOVO))
+            return nullptr;
+        leitura = meio.exchange(leitura, std::memory_order_acq_rel) & INDICE;
+        return &slots[leitura].valor;
+    }
+
+private:
+    static const unsigned NOVO = 4;   // bit em meio: o slot do meio ainda não foi lido
+    static const unsigned INDICE = 3;
+
+    struct alignas(64) Slot
+    {
+        T valor;
+    };
+    Slot slots[3];
+    alignas(64) std::atomic<unsigned> meio;
+    alignas(64) unsigned escrita; // só o produtor usa
+    alignas(64) unsigned leitura; // só o consumidor usa
+};
+
+// Fila circular sem trava de capacidade fixa N (potência de 2) para um produtor e um consumidor
+template <typename T, size_t N>
+class FilaSPSC
+{
+    static_assert((N & (N - 1)) == 0, "N deve ser potência de 2");
+
+public:
+    FilaSPSC() : cabeca(0), cauda(0) {}
+
+    // false se a fila está cheia (o item é descartado)
+    bool inserir(const T &item)
+    {
+        size_t c = cabeca.load(std::memory_order_relaxed);
+        if (c - cauda.load(std::memory_order_acquire) == N)
+            return false;
+        itens[c & (N - 1)] = item;
+        cabeca.store(c + 1, std::memory_order_release);
+        return true;
+    }
+
+    // false se a fila está vazia
+    bool retirar(T &item)
+    {
+        size_t t = cauda.load(std::memory_order_relaxed);
+        if (t == cabeca.load(std::memory_order_acquire))
+            return false;
+        item = itens[t & (N - 1)];
+        cauda.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<size_t> cabeca; // escrita pelo produtor
+    alignas(64) std::atomic<size_t> cauda;  // escrita pelo consumidor
+    T itens[N];
+};
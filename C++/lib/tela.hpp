@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Converte as linhas [primeira, ultima] do framebuffer compactado (bit 63 = coluna 0) para pixels
+// RGBA8888 de 64 colunas. destino aponta para a linha primeira; pitch em bytes, como o do SDL.
+// Fica fora da camada SDL para poder ser medida sem janela.
+inline void converter_linhas_rgba(void *destino, int pitch, const uint64_t linhas[], int primeira, int ultima)
+{
+    const uint32_t on = 0xFFFFFFFF;  // white
+    const uint32_t off = 0x000000FF; // black
+
+    for (int y = primeira; y <= ultima; ++y)
+    {
+        uint32_t *pixels = (uint32_t *)((uint8_t *)destino + (y - primeira) * pitch);
+        uint64_t linha = linhas[y];
+        for (int x = 0; x < 64; ++x)
+        {
+            pixels[x] = ((linha >> (63 - x)) & 1) ? on : off;
+        }
+    }
+}
+
+// Converte as linhas [primeira, ultima] da tela de 128x64 dos modos estendidos (duas palavras por
+// linha, bit 63 da primeira = coluna 0) para RGBA8888. plano1 nullptr = só um plano (SUPER-CHIP, ou
+// XO-CHIP enquanto o segundo plano está vazio), sem ler nem combinar o segundo.
+inline void converter_linhas_rgba_alta(void *destino, int pitch, const uint64_t (*plano0)[2],
+                                       const uint64_t (*plano1)[2], int primeira, int ultima)
+{
+    // fundo, só plano 0, só plano 1, os dois
+    static const uint32_t cores[4] = {0x000000FF, 0xFFFFFFFF, 0xAAAAAAFF, 0x555555FF};
+
+    for (int y = primeira; y <= ultima; ++y)
+    {
+        uint32_t *pixels = (uint32_t *)((uint8_t *)destino + (y - primeira) * pitch);
+        for (int m = 0; m < 2; ++m)
+        {
+            uint64_t p0 = plano0[y][m];
+            uint64_t p1 = plano1 ? plano1[y][m] : 0;
+            for (int x = 0; x < 64; ++x)
+                pixels[m * 64 + x] = cores[((p0 >> (63 - x)) & 1) | (((p1 >> (63 - x)) & 1) << 1)];
+        }
+    }
+}
+
+// Hash FNV-1a de 64 bits das palavras da tela, byte mais significativo primeiro
+inline uint64_t hash_tela(const uint64_t *palavras, size_t n)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (int b = 56; b >= 0; b -= 8)
+        {
+            h ^= (palavras[i] >> b) & 0xFF;
+            h *= 0x100000001b3ULL;
+        }
+    }
+    return h;
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include "chip8.hpp"
+#include "lote.hpp"
+#include <string>
+#include <vector>
+
+// Exportação de vídeo de uma execução headless, quadro a quadro, sem janela. Três saídas:
+//
+// - .c8v: formato próprio. Cada quadro é a tela empacotada (1 bit por pixel e plano, linhas de
+//   palavras de 64 bits com o bit 63 na coluna 0) codificada como XOR com o quadro anterior e
+//   compactada em corridas de zeros; quadros iguais ao anterior viram uma contagem. Uma partida
+//   típica fica em poucos bytes por quadro alterado. --converter-video gera as outras a partir dele.
+// - .y4m: YUV4MPEG2 (4:2:0, 60 fps), que ffmpeg e a maioria dos players leem direto.
+// - qualquer outro caminho é um diretório que recebe uma sequência PNG (000000.png, ...), com
+//   paleta de 2 cores (4 no XO-CHIP) e sem compressão.
+//
+// O gravador guarda só o quadro anterior e o último quadro codificado, então a memória não
+// depende da duração; o laço roda sem limite de velocidade como o modo headless.
+
+enum FormatoVideo
+{
+    VIDEO_C8V,
+    VIDEO_Y4M,
+    VIDEO_PNG,
+};
+
+// Formato pelo caminho: extensão .c8v ou .y4m; o resto é diretório de PNGs
+FormatoVideo formato_video(const std::string &caminho);
+
+// Um quadro empacotado: planos x altura linhas de largura / 64 palavras, plano a plano
+struct QuadroVideo
+{
+    int largura; // 64 ou 128
+    int altura;  // 32 ou 64
+    int planos;  // 1 ou 2
+    uint64_t palavras[PLANOS * ALTURA_ALTA * 2];
+
+    int n_palavras() const { return planos * altura * (largura / 64); }
+    // cor do pixel: bit p = plano p aceso
+    int pixel(int x, int y) const;
+};
+
+// Arquivo .c8v (ordem de bytes do host no cabeçalho; os quadros são bytes): CabecalhoVideo e uma
+// sequência de registros, cada um com um byte de tipo:
+//   REGISTRO_REPETIR  LEB128 n                  n quadros iguais ao anterior
+//   REGISTRO_DELTA    LEB128 tamanho, corridas  XOR com o quadro anterior
+//   REGISTRO_CHAVE    LEB128 tamanho, corridas  o quadro inteiro, no início e a cada INTERVALO_CHAVE
+// As corridas cobrem os bytes das palavras do quadro (mais significativo primeiro) em pares
+// LEB128 zeros, LEB128 literais, seguidos dos literais; os zeros depois do último par ficam implícitos.
+struct CabecalhoVideo
+{
+    uint32_t magica; // MAGICA_VIDEO
+    uint16_t versao; // VERSAO_VIDEO
+    uint16_t largura;
+    uint16_t altura;
+    uint16_t planos;
+    uint32_t quadros_por_segundo;
+    uint64_t quadros; // preenchido ao fechar
+};
+
+const uint32_t MAGICA_VIDEO = 0x44563843; // "C8VD"
+const uint16_t VERSAO_VIDEO = 1;
+const uint64_t INTERVALO_CHAVE = 3600; // um minuto de jogo
+enum TipoRegistroVideo : uint8_t
+{
+    REGISTRO_REPETIR = 0,
+    REGISTRO_DELTA = 1,
+    REGISTRO_CHAVE = 2,
+};
+
+class GravadorVideo
+{
+public:
+    GravadorVideo();
+    ~GravadorVideo();
+
+    // escala multiplica os pixels de PNG e Y4M (o .c8v guarda a tela como ela é)
+    bool abrir(const std::string &caminho, FormatoVideo formato, int largura, int altura, int planos, int escala);
+    void quadro(const QuadroVideo &q);
+    // n quadros iguais ao último (parada em FX0A, trechos sem desenho)
+    void repetir(uint64_t n);
+    bool fechar();
+
+    uint64_t quadros() const { return n_quadros; }
+    uint64_t bytes() const { return n_bytes; }
+
+private:
+    FormatoVideo formato;
+    std::string caminho;
+    FILE *arq;
+    bool erro;
+    int escala;
+    QuadroVideo anterior;
+    uint64_t n_quadros;
+    uint64_t n_bytes;
+    uint64_t repeticoes;       // .c8v: quadros iguais ainda não escritos
+    uint64_t desde_chave;      // .c8v: quadros desde o último REGISTRO_CHAVE
+    std::vector<uint8_t> codificado; // último quadro codificado (PNG e Y4M reescrevem em repetições)
+
+    void escrever(const void *dados, size_t n);
+    void emitir_repeticoes();
+    void codificar_y4m(const QuadroVideo &q);
+    void codificar_png(const QuadroVideo &q);
+    void gravar_codificado();
+};
+
+// Leitura de um .c8v, quadro a quadro
+class LeitorVideo
+{
+public:
+    LeitorVideo();
+    ~LeitorVideo();
+
+    bool abrir(const char *caminho);
+    // false no fim do arquivo ou num registro inválido (erro() diz qual)
+    bool proximo(QuadroVideo &q);
+    bool erro() const { return invalido; }
+    const CabecalhoVideo &cabecalho() const { return cab; }
+
+private:
+    FILE *arq;
+    CabecalhoVideo cab;
+    QuadroVideo atual;
+    uint64_t repeticoes;
+    bool invalido;
+};
+
+// Roda frames frames na VM, com os eventos no início de cada frame, gravando a tela ao fim de
+// cada um (mesmo laço do lote e de --reproduzir)
+ResultadoHeadless exportar_video(Chip8 &vm, int hz, int instr_por_frame, uint64_t frames,
+                                 const std::vector<EventoTecla> &eventos, GravadorVideo &video);
+
+// Regrava um .c8v como Y4M ou sequência PNG (formato pelo caminho de saída)
+bool converter_video(const char *entrada, const std::string &saida, int escala);
@@ -1,4 +1,10 @@
 #include "../lib/chip8.hpp"
+#include "../lib/fuzz.hpp"
+#include "../lib/rastro.hpp"
+#include "../lib/tela.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 
 static const uint8_t chip8_fontset[80] = {
     0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
@@ -19,23 +25,56 @@ static const uint8_t chip8_fontset[80] = {
     0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
-Chip8::Chip8()
+// Fonte grande de 8x10 do SUPER-CHIP (0-9) com as letras do XO-CHIP, carregada em 0xA0 (FX30)
+static const uint16_t FONTE_GRANDE = 0xA0;
+static const uint8_t chip8_fonte_grande[160] = {
+    0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+    0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+    0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
+Chip8::Chip8() : privada(new MemoriaChip8()), coleta(nullptr), rastro(nullptr)
 {
+    memoria = privada->bytes;
+    cache_decod = privada->decod;
     pc = 0x200; // endereço inicial típico do CHIP-8
     indiceI = 0;
     ponteiro_pilha = 0;
     temporizador_delay = 0;
     temporizador_som = 0;
-    deveDesenhar = false;
+    linhas_sujas = ~0u; // o primeiro quadro é desenhado inteiro
     aguardando_tecla = false;
     reg_aguardando_tecla = 0;
-    std::memset(teclas, 0, sizeof(teclas));
+    estado_rng = pcg32_semear(0);
+    efeitos = 0;
+    paginas_sujas = 0;
+    pular_ociosos = true;
+    quirks = QUIRKS_MODERNO;
+    teclas = 0;
     std::memset(registradores, 0, sizeof(registradores));
-    std::memset(memoria, 0, sizeof(memoria));
     std::memset(tela, 0, sizeof(tela));
     std::memset(pilha, 0, sizeof(pilha));
-    // carregar fontset na memória em 0x50
-    std::memcpy(&memoria[0x50], chip8_fontset, sizeof(chip8_fontset));
+    PERFIL(std::memset(&perfil, 0, sizeof(perfil));)
+    // a MemoriaChip8 nova já vem zerada (nada decodificado); carregar fontset na memória em 0x50
+    std::memcpy(&privada->bytes[0x50], chip8_fontset, sizeof(chip8_fontset));
+}
+
+Chip8::Chip8(SemMemoria) : pular_ociosos(true), memoria(nullptr), cache_decod(nullptr), coleta(nullptr), rastro(nullptr)
+{
+    PERFIL(std::memset(&perfil, 0, sizeof(perfil));)
 }
 
 void Chip8::VM_inicializar(uint16_t pc_inicial)
@@ -43,341 +82,1765 @@ void Chip8::VM_inicializar(uint16_t pc_inicial)
     pc = pc_inicial;
 }
 
-void Chip8::VM_CarregarROM(char *arq_rom, uint16_t pc_inicial)
+bool Chip8::VM_CarregarROM(const char *arq_rom, uint16_t pc_inicial)
 {
-    FILE *rom = fopen(arq_rom, "rb");
-    if (!rom)
+    ImagemROM imagem;
+    std::string erro;
+    if (!imagem.abrir(arq_rom, erro))
     {
-        perror("fopen");
-        return;
+        fprintf(stderr, "%s: %s\n", arq_rom, erro.c_str());
+        return false;
     }
-    fseek(rom, 0, SEEK_END);
-    long tam_rom = ftell(rom);
-    if (tam_rom <= 0)
+    return VM_CarregarImagem(imagem, pc_inicial);
+}
+
+// Copia uma imagem já aberta (e possivelmente compartilhada) para a memória a partir de pc_inicial
+// no perfil de quirks conhecido para ela. Uma ROM que só cabe nos 64 KB é tratada como XO-CHIP.
+bool Chip8::VM_CarregarImagem(const ImagemROM &imagem, uint16_t pc_inicial)
+{
+    Quirks q = quirks_da_rom(imagem.hash());
+    if (pc_inicial + imagem.tamanho() > TAM_MEMORIA)
+        q = QUIRKS_XOCHIP;
+    VM_DefinirQuirks(q);
+    if (!VM_CarregarBytes(imagem.dados(), imagem.tamanho(), pc_inicial))
     {
-        fclose(rom);
-        return;
+        fprintf(stderr, "%s: %zu bytes não cabem a partir de 0x%03X\n", imagem.caminho().c_str(),
+                imagem.tamanho(), pc_inicial);
+        return false;
     }
-    rewind(rom);
-    size_t readn = fread(&memoria[pc_inicial], 1, (size_t)tam_rom, rom);
-    (void)readn;
-    fclose(rom);
+    return true;
 }
 
-void Chip8::VM_ExecutarInstrucao()
+// Copia um programa montado em memória (ferramentas, benchmarks); false se não couber. No XO-CHIP
+// o que passa de 0x1000 vai para a memória alta.
+bool Chip8::VM_CarregarBytes(const uint8_t *dados, size_t tamanho, uint16_t pc_inicial)
 {
-    // Se estamos aguardando tecla, não execute instruções até receber uma
-    if (aguardando_tecla)
+    size_t limite = quirks == QUIRKS_XOCHIP ? 0x10000 : TAM_MEMORIA;
+    if (tamanho > limite || pc_inicial > limite - tamanho)
+        return false;
+    size_t baixo = pc_inicial < TAM_MEMORIA ? std::min(tamanho, (size_t)TAM_MEMORIA - pc_inicial) : 0;
+    if (baixo)
+        std::memcpy(&memoria_propria()[pc_inicial], dados, baixo);
+    if (tamanho > baixo)
+        std::memcpy(&ext->memoria_alta[pc_inicial + baixo - TAM_MEMORIA], dados + baixo, tamanho - baixo);
+    invalidar_cache_decod();
+    return true;
+}
+
+void Chip8::VM_DefinirQuirks(Quirks q)
+{
+    if (!quirks_estendido(q))
+    {
+        ext.reset();
+    }
+    else if (!ext)
+    {
+        ext.reset(new ExtensaoChip8());
+        ext->planos = 1;
+        for (uint16_t i = 0; i < sizeof(chip8_fonte_grande); ++i)
+            escrever_memoria(FONTE_GRANDE + i, chip8_fonte_grande[i]);
+    }
+    else if (q != QUIRKS_XOCHIP)
+    {
+        std::memset(ext->memoria_alta, 0, sizeof(ext->memoria_alta));
+    }
+    quirks = q;
+    linhas_sujas = ~0u;
+}
+
+void Chip8::VM_SalvarEstado(EstadoChip8 &destino) const
+{
+    destino.magica = MAGICA_ESTADO;
+    destino.versao = VERSAO_ESTADO;
+    destino.pc = pc;
+    destino.estado_rng = estado_rng;
+    std::memcpy(destino.tela, tela, sizeof(tela));
+    destino.indiceI = indiceI;
+    destino.teclas = teclas;
+    std::memcpy(destino.pilha, pilha, sizeof(pilha));
+    std::memcpy(destino.registradores, registradores, sizeof(registradores));
+    destino.ponteiro_pilha = ponteiro_pilha;
+    destino.temporizador_delay = temporizador_delay;
+    destino.temporizador_som = temporizador_som;
+    destino.aguardando_tecla = aguardando_tecla ? 1 : 0;
+    destino.reg_aguardando_tecla = reg_aguardando_tecla;
+    destino.quirks = quirks;
+    std::memset(destino.reservado, 0, sizeof(destino.reservado));
+    std::memcpy(destino.memoria, memoria, TAM_MEMORIA);
+    if (!ext)
     {
+        destino.alta_resolucao = 0;
+        destino.planos = 0;
+        destino.tom = 0;
+        std::memset(destino.flags, 0, sizeof(destino.flags));
+        std::memset(destino.padrao_som, 0, sizeof(destino.padrao_som));
+        std::memset(destino.tela_alta, 0, sizeof(destino.tela_alta));
         return;
     }
+    destino.alta_resolucao = ext->alta_resolucao ? 1 : 0;
+    destino.planos = ext->planos;
+    destino.tom = ext->tom;
+    std::memcpy(destino.flags, ext->flags, sizeof(ext->flags));
+    std::memcpy(destino.padrao_som, ext->padrao_som, sizeof(ext->padrao_som));
+    std::memcpy(destino.tela_alta, ext->tela, sizeof(ext->tela));
+    if (quirks == QUIRKS_XOCHIP)
+        std::memcpy(&destino.memoria[TAM_MEMORIA], ext->memoria_alta, sizeof(ext->memoria_alta));
+}
+
+// Restaura um snapshot. A memória é comparada em blocos de 64 bytes e só os bytes diferentes são
+// escritos (via escrever_memoria), então o cache de decodificação e os blocos do JIT sobrevivem
+// quando o snapshot é recente e a ROM não se modificou.
+void Chip8::VM_RestaurarEstado(const EstadoChip8 &origem)
+{
+    pc = origem.pc;
+    estado_rng = origem.estado_rng;
+    std::memcpy(tela, origem.tela, sizeof(tela));
+    indiceI = origem.indiceI;
+    teclas = origem.teclas;
+    std::memcpy(pilha, origem.pilha, sizeof(pilha));
+    std::memcpy(registradores, origem.registradores, sizeof(registradores));
+    ponteiro_pilha = origem.ponteiro_pilha & 0x0F;
+    temporizador_delay = origem.temporizador_delay;
+    temporizador_som = origem.temporizador_som;
+    aguardando_tecla = origem.aguardando_tecla != 0;
+    reg_aguardando_tecla = origem.reg_aguardando_tecla & 0x0F;
+    VM_DefinirQuirks(origem.quirks < QUIRKS_TOTAL ? (Quirks)origem.quirks : QUIRKS_MODERNO);
+    if (ext)
+    {
+        ext->alta_resolucao = origem.alta_resolucao != 0;
+        ext->planos = origem.planos & 3;
+        ext->tom = origem.tom;
+        std::memcpy(ext->flags, origem.flags, sizeof(ext->flags));
+        std::memcpy(ext->padrao_som, origem.padrao_som, sizeof(ext->padrao_som));
+        std::memcpy(ext->tela, origem.tela_alta, sizeof(ext->tela));
+        if (quirks == QUIRKS_XOCHIP)
+            std::memcpy(ext->memoria_alta, &origem.memoria[TAM_MEMORIA], sizeof(ext->memoria_alta));
+    }
+    for (uint16_t bloco = 0; bloco < TAM_MEMORIA; bloco += 64)
+    {
+        if (std::memcmp(&memoria[bloco], &origem.memoria[bloco], 64) == 0)
+            continue;
+        for (uint16_t end = bloco; end < bloco + 64; ++end)
+            if (memoria[end] != origem.memoria[end])
+                escrever_memoria(end, origem.memoria[end]);
+    }
+    linhas_sujas = ~0u;
+}
 
-    uint16_t inst = (memoria[pc] << 8) | memoria[pc + 1];
-    uint8_t X = (inst & 0x0F00) >> 8;
-    uint8_t Y = (inst & 0x00F0) >> 4;
-    uint8_t N = inst & 0x000F;
-    uint8_t NN = inst & 0x00FF;
-    uint16_t NNN = inst & 0x0FFF;
+// Converte os 2 bytes da instrução no OpCode e operandos usados pelos manipuladores
+Decodificada Chip8::decodificar(uint16_t inst)
+{
+    Decodificada d;
+    d.op = OP_NOP;
+    d.x = (inst & 0x0F00) >> 8;
+    d.y = (inst & 0x00F0) >> 4;
+    d.n = inst & 0x000F;
+    d.nn = inst & 0x00FF;
+    d.nnn = inst & 0x0FFF;
 
     switch (inst & 0xF000)
     {
     case 0x0000:
         if (inst == 0x00E0)
-        { // CLS
-            std::memset(tela, 0, sizeof(tela));
-            deveDesenhar = true;
-            pc += 2;
-        }
+            d.op = OP_CLS;
         else if (inst == 0x00EE)
-        { // RET
-            if (ponteiro_pilha > 0)
-            {
-                ponteiro_pilha--;
-                pc = pilha[ponteiro_pilha];
-            }
-            else
-            {
-                pc += 2; // fallback
-            }
-        }
-        else
-        {
-            // 0x0NNN ignored
-            pc += 2;
-        }
+            d.op = OP_RET;
+        else if ((inst & 0xFFF0) == 0x00C0)
+            d.op = OP_SCD;
+        else if ((inst & 0xFFF0) == 0x00D0)
+            d.op = OP_SCU;
+        else if (inst == 0x00FB)
+            d.op = OP_SCR;
+        else if (inst == 0x00FC)
+            d.op = OP_SCL;
+        else if (inst == 0x00FD)
+            d.op = OP_EXIT;
+        else if (inst == 0x00FE)
+            d.op = OP_LOW;
+        else if (inst == 0x00FF)
+            d.op = OP_HIGH;
+        // 0x0NNN ignored
         break;
-
-    case 0x1000: // JP addr
-        pc = NNN;
+    case 0x1000:
+        d.op = OP_JP;
         break;
-
-    case 0x2000: // CALL addr
-        pilha[ponteiro_pilha] = pc + 2;
-        ponteiro_pilha = (ponteiro_pilha + 1) & 0x0F; // manter em 0..15
-        pc = NNN;
+    case 0x2000:
+        d.op = OP_CALL;
         break;
-
-    case 0x3000: // SE Vx, byte
-        if (registradores[X] == NN)
-            pc += 4;
-        else
-            pc += 2;
+    case 0x3000:
+        d.op = OP_SE_BYTE;
         break;
-
-    case 0x4000: // SNE Vx, byte
-        if (registradores[X] != NN)
-            pc += 4;
-        else
-            pc += 2;
+    case 0x4000:
+        d.op = OP_SNE_BYTE;
         break;
-
-    case 0x5000: // SE Vx, Vy  (only if low nibble == 0)
-        if ((inst & 0x000F) == 0)
-        {
-            if (registradores[X] == registradores[Y])
-                pc += 4;
-            else
-                pc += 2;
-        }
-        else
-        {
-            pc += 2;
-        }
+    case 0x5000:
+        if (d.n == 0)
+            d.op = OP_SE_REG;
+        else if (d.n == 2)
+            d.op = OP_SAVE_VX_VY;
+        else if (d.n == 3)
+            d.op = OP_LOAD_VX_VY;
         break;
-
-    case 0x6000: // LD Vx, byte
-        registradores[X] = NN;
-        pc += 2;
+    case 0x6000:
+        d.op = OP_LD_BYTE;
         break;
-
-    case 0x7000: // ADD Vx, byte
-        registradores[X] = (registradores[X] + NN) & 0xFF;
-        pc += 2;
+    case 0x7000:
+        d.op = OP_ADD_BYTE;
         break;
-
-    case 0x8000: // arithmetic and logic
-        switch (inst & 0x000F)
+    case 0x8000:
+        switch (d.n)
         {
         case 0x0:
-            registradores[X] = registradores[Y];
+            d.op = OP_LD_REG;
             break;
         case 0x1:
-            registradores[X] |= registradores[Y];
+            d.op = OP_OR;
             break;
         case 0x2:
-            registradores[X] &= registradores[Y];
+            d.op = OP_AND;
             break;
         case 0x3:
-            registradores[X] ^= registradores[Y];
+            d.op = OP_XOR;
             break;
         case 0x4:
-        { // ADD Vx, Vy
-            uint16_t sum = registradores[X] + registradores[Y];
-            registradores[0xF] = (sum > 0xFF) ? 1 : 0;
-            registradores[X] = sum & 0xFF;
+            d.op = OP_ADD_REG;
             break;
-        }
         case 0x5:
-        { // SUB Vx, Vy
-            registradores[0xF] = (registradores[X] > registradores[Y]) ? 1 : 0;
-            registradores[X] = (registradores[X] - registradores[Y]) & 0xFF;
+            d.op = OP_SUB;
             break;
-        }
-        case 0x6: // SHR Vx {, Vy} - common variant: shift Vx right by 1, VF = least significant bit
-            registradores[0xF] = registradores[X] & 0x1;
-            registradores[X] >>= 1;
+        case 0x6:
+            d.op = OP_SHR;
             break;
         case 0x7:
-        { // SUBN Vx, Vy
-            registradores[0xF] = (registradores[Y] > registradores[X]) ? 1 : 0;
-            registradores[X] = (registradores[Y] - registradores[X]) & 0xFF;
+            d.op = OP_SUBN;
             break;
-        }
-        case 0xE: // SHL Vx {, Vy}
-            registradores[0xF] = (registradores[X] >> 7) & 0x1;
-            registradores[X] = (registradores[X] << 1) & 0xFF;
+        case 0xE:
+            d.op = OP_SHL;
             break;
         default:
             break;
         }
-        pc += 2;
         break;
-
-    case 0x9000: // SNE Vx, Vy
-        if ((inst & 0x000F) == 0)
-        {
-            if (registradores[X] != registradores[Y])
-                pc += 4;
-            else
-                pc += 2;
-        }
-        else
+    case 0x9000:
+        if (d.n == 0)
+            d.op = OP_SNE_REG;
+        break;
+    case 0xA000:
+        d.op = OP_LD_I;
+        break;
+    case 0xB000:
+        d.op = OP_JP_V0;
+        break;
+    case 0xC000:
+        d.op = OP_RND;
+        break;
+    case 0xD000:
+        d.op = OP_DRW;
+        break;
+    case 0xE000:
+        if (d.nn == 0x9E)
+            d.op = OP_SKP;
+        else if (d.nn == 0xA1)
+            d.op = OP_SKNP;
+        break;
+    case 0xF000:
+        switch (d.nn)
         {
-            pc += 2;
+        case 0x00:
+            if (d.x == 0)
+                d.op = OP_LD_I_LONGO;
+            break;
+        case 0x01:
+            d.op = OP_PLANO;
+            break;
+        case 0x02:
+            if (d.x == 0)
+                d.op = OP_AUDIO;
+            break;
+        case 0x07:
+            d.op = OP_LD_VX_DT;
+            break;
+        case 0x0A:
+            d.op = OP_LD_VX_K;
+            break;
+        case 0x15:
+            d.op = OP_LD_DT_VX;
+            break;
+        case 0x18:
+            d.op = OP_LD_ST_VX;
+            break;
+        case 0x1E:
+            d.op = OP_ADD_I_VX;
+            break;
+        case 0x29:
+            d.op = OP_LD_F_VX;
+            break;
+        case 0x30:
+            d.op = OP_LD_HF_VX;
+            break;
+        case 0x33:
+            d.op = OP_LD_B_VX;
+            break;
+        case 0x3A:
+            d.op = OP_LD_TOM_VX;
+            break;
+        case 0x55:
+            d.op = OP_LD_I_VX;
+            break;
+        case 0x65:
+            d.op = OP_LD_VX_I;
+            break;
+        case 0x75:
+            d.op = OP_LD_R_VX;
+            break;
+        case 0x85:
+            d.op = OP_LD_VX_R;
+            break;
+        default:
+            break;
         }
         break;
+    }
+    return d;
+}
 
-    case 0xA000: // LD I, addr
-        indiceI = NNN;
-        pc += 2;
-        break;
+// Toda escrita da ROM em memória passa por aqui para manter o cache de decodificação coerente
+// (ROMs auto-modificáveis). Um byte faz parte das instruções que começam nele e no endereço anterior.
+void Chip8::escrever_memoria(uint16_t endereco, uint8_t valor)
+{
+    endereco &= 0x0FFF;
+    ++efeitos;
+    if (!privada)
+    {
+        // lendo da imagem compartilhada: reescrever o mesmo byte (FX55 de valores iguais, a
+        // fonte grande de VM_DefinirQuirks) não precisa da cópia
+        if (memoria[endereco] == valor)
+            return;
+        copiar_imagem();
+    }
+    MemoriaChip8 *m = privada.get();
+    m->decod[endereco].op = OP_NAO_DECODIFICADA;
+    m->decod[(endereco - 1) & 0x0FFF].op = OP_NAO_DECODIFICADA;
+    m->bytes[endereco] = valor;
+    paginas_sujas |= (uint16_t)(1u << (endereco / TAM_PAGINA) | 1u << (((endereco - 1) & 0x0FFF) / TAM_PAGINA));
+    if (jit)
+        jit->invalidar(endereco);
+}
 
-    case 0xB000: // JP V0, addr
-        pc = NNN + registradores[0];
-        break;
+void Chip8::invalidar_cache_decod()
+{
+    memoria_propria();
+    std::memset(privada->decod, 0, sizeof(privada->decod));
+    if (jit)
+        jit->invalidar_tudo();
+}
 
-    case 0xC000:
-    { // RND Vx, byte
-        uint8_t rnd = (uint8_t)(rand() & 0xFF);
-        registradores[X] = rnd & NN;
-        pc += 2;
-        break;
+uint8_t *Chip8::memoria_propria()
+{
+    if (!privada)
+        copiar_imagem();
+    paginas_sujas = 0xFFFF;
+    return privada->bytes;
+}
+
+// Sai da imagem compartilhada para uma cópia própria. A cópia leva a decodificação junto: o
+// conteúdo é o mesmo, então o JIT também segue válido. A imagem continua referenciada como
+// origem da cópia, para VM_ReiniciarDe restaurar só as páginas escritas.
+void Chip8::copiar_imagem()
+{
+    privada.reset(new MemoriaChip8(*compartilhada));
+    memoria = privada->bytes;
+    cache_decod = privada->decod;
+    paginas_sujas = 0;
+}
+
+// Devolve as páginas sujas da memória própria ao conteúdo (e à decodificação) da imagem de origem
+void Chip8::restaurar_paginas()
+{
+    if (!paginas_sujas)
+        return;
+    for (uint32_t sujas = paginas_sujas; sujas; sujas &= sujas - 1)
+    {
+        int inicio = __builtin_ctz(sujas) * TAM_PAGINA;
+        std::memcpy(&privada->bytes[inicio], &compartilhada->bytes[inicio], TAM_PAGINA);
+        std::memcpy(&privada->decod[inicio], &compartilhada->decod[inicio], TAM_PAGINA * sizeof(Decodificada));
     }
+    paginas_sujas = 0;
+    ++efeitos;
+    if (jit)
+        jit->invalidar_tudo();
+}
 
-    case 0xD000:
-    { // DRW Vx, Vy, nibble
-        const uint8_t DISPLAY_WIDTH = 64;
-        const uint8_t DISPLAY_HEIGHT = 32;
+std::shared_ptr<const MemoriaChip8> Chip8::VM_CompartilharMemoria()
+{
+    if (privada)
+    {
+        for (uint16_t end = 0; end < TAM_MEMORIA; ++end)
+            buscar_decodificada(end);
+        compartilhada.reset(privada.release());
+        paginas_sujas = 0;
+    }
+    return compartilhada;
+}
+
+void Chip8::VM_UsarMemoria(std::shared_ptr<const MemoriaChip8> imagem)
+{
+    privada.reset();
+    paginas_sujas = 0;
+    compartilhada = std::move(imagem);
+    memoria = compartilhada->bytes;
+    cache_decod = compartilhada->decod;
+    ++efeitos;
+    if (jit)
+        jit->invalidar_tudo();
+}
+
+Chip8 Chip8::VM_Bifurcar()
+{
+    VM_CompartilharMemoria();
+    Chip8 filho{SemMemoria()};
+    filho.VM_ReiniciarDe(*this);
+    filho.pular_ociosos = pular_ociosos;
+    return filho;
+}
 
-        uint8_t xcoord = registradores[X] % DISPLAY_WIDTH;
-        uint8_t ycoord = registradores[Y] % DISPLAY_HEIGHT;
+// Registradores, pilha e tela são poucas centenas de bytes e vão sempre; da memória só volta o
+// que difere. Nos perfis estendidos a ExtensaoChip8 é copiada inteira.
+void Chip8::VM_ReiniciarDe(const Chip8 &modelo)
+{
+    pc = modelo.pc;
+    indiceI = modelo.indiceI;
+    std::memcpy(registradores, modelo.registradores, sizeof(registradores));
+    ponteiro_pilha = modelo.ponteiro_pilha;
+    temporizador_delay = modelo.temporizador_delay;
+    temporizador_som = modelo.temporizador_som;
+    teclas = modelo.teclas;
+    aguardando_tecla = modelo.aguardando_tecla;
+    reg_aguardando_tecla = modelo.reg_aguardando_tecla;
+    estado_rng = modelo.estado_rng;
+    std::memcpy(pilha, modelo.pilha, sizeof(pilha));
+    std::memcpy(tela, modelo.tela, sizeof(tela));
+    linhas_sujas = ~0u;
+    ++efeitos;
 
-        registradores[0xF] = 0;
+    quirks = modelo.quirks;
+    if (!modelo.ext)
+        ext.reset();
+    else if (!ext)
+        ext.reset(new ExtensaoChip8(*modelo.ext));
+    else if (ext != modelo.ext)
+        *ext = *modelo.ext;
 
-        for (uint8_t row = 0; row < N; row++)
-        {
-            uint8_t bits = memoria[indiceI + row];
-            uint8_t cy = (ycoord + row) % DISPLAY_HEIGHT;
+    if (modelo.privada)
+    {
+        // modelo com memória própria (não congelado): cópia inteira
+        if (!privada)
+            privada.reset(new MemoriaChip8(*modelo.privada));
+        else if (privada != modelo.privada)
+            *privada = *modelo.privada;
+        compartilhada = modelo.compartilhada;
+        paginas_sujas = modelo.paginas_sujas;
+        memoria = privada->bytes;
+        cache_decod = privada->decod;
+        if (jit)
+            jit->invalidar_tudo();
+    }
+    else if (compartilhada != modelo.compartilhada)
+    {
+        VM_UsarMemoria(modelo.compartilhada);
+    }
+    else if (privada)
+    {
+        restaurar_paginas();
+    }
+}
+
+// Liga o backend JIT; retorna false (e segue só com o interpretador) se não for suportado
+bool Chip8::VM_AtivarJIT()
+{
+    if (!jit)
+        jit.reset(new JitX64());
+    if (!jit->disponivel())
+    {
+        jit.reset();
+        return false;
+    }
+    return true;
+}
+
+// Instrução do endereço vinda do cache; decodifica na primeira execução do endereço
+inline const Decodificada &Chip8::buscar_decodificada(uint16_t endereco)
+{
+    uint16_t end = endereco & 0x0FFF;
+    const Decodificada &d = cache_decod[end];
+    // só acontece na memória própria: a imagem compartilhada vem inteira decodificada
+    if (d.op == OP_NAO_DECODIFICADA)
+        privada->decod[end] = decodificar((memoria[end] << 8) | memoria[(end + 1) & 0x0FFF]);
+    return d;
+}
+
+void Chip8::VM_ExecutarInstrucao()
+{
+    VM_Executar(1);
+}
+
+// Executa até n instruções, pelo JIT quando ativo ou pelo interpretador
+uint32_t Chip8::VM_Executar(uint32_t n)
+{
+    PERFIL(auto t_inicio = std::chrono::steady_clock::now();)
+    uint32_t executadas;
+    if (jit && quirks == QUIRKS_MODERNO && !coleta && !rastro)
+        executadas = executar_jit(n);
+    else
+        executadas = interpretar(n);
+    PERFIL(perfil.ns_execucao += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now() - t_inicio).count();)
+    return executadas;
+}
 
-            for (uint8_t col = 0; col < 8; col++)
+// Alterna blocos nativos com o interpretador, que executa o que o JIT não compila.
+// O código nativo consome o orçamento n bloco a bloco e para antes de um bloco que não caiba
+// inteiro, para que a contagem de instruções (e o ritmo dos timers) seja a do interpretador.
+// Os JPs para trás voltam aqui a cada volta, e passam pela mesma detecção de laço ocioso do
+// interpretador: os blocos não escrevem na memória nem na tela, então as esperas pelo delay timer
+// continuam sendo puladas. Um laço que mudou o estado em VOLTAS_ATIVAS voltas seguidas trabalha de
+// verdade (uma espera só muda na primeira, ao ler o timer): o salto é liberado
+// (JitX64::ligar_volta) e o laço roda no código nativo por até FATIA_LIBERADA instruções; depois
+// as liberações caem e o laço é examinado de novo, porque pode ter virado uma espera.
+static const uint32_t VOLTAS_ATIVAS = 4;
+static const uint32_t FATIA_LIBERADA = 512;
+
+uint32_t Chip8::executar_jit(uint32_t n)
+{
+    uint32_t executadas = 0;
+    ControleJIT ctl;
+    ctl.teclas = teclas;
+    ctl.volta = 0;
+    jit->iniciar_voltas(ctl);
+    bool liberadas = false;
+    uint32_t ativas = 0; // voltas seguidas ao mesmo alvo que mudaram o estado
+    LacoOcioso laco;
+    laco.alvo = 0xFFFF;
+    while (n > 0 && !aguardando_tecla)
+    {
+        const BlocoJIT *b = jit->bloco(pc, memoria);
+        if (b)
+        {
+            uint32_t orcamento = liberadas ? std::min(n, FATIA_LIBERADA) : n;
+            ctl.orcamento = orcamento;
+            b->codigo(registradores, &indiceI, &temporizador_delay, &temporizador_som, memoria, &ctl);
+            uint32_t consumidas = orcamento - ctl.orcamento;
+            PERFIL(perfil.instrucoes_jit += consumidas;)
+            executadas += consumidas;
+            n -= consumidas;
+            pc = ctl.pc;
+            if (liberadas)
+            {
+                // as voltas da fatia não passaram por aqui: o laço é medido de novo
+                jit->iniciar_voltas(ctl);
+                liberadas = false;
+                ativas = 0;
+                laco.alvo = 0xFFFF;
+            }
+            if (ctl.volta)
             {
-                uint8_t cx = (xcoord + col) % DISPLAY_WIDTH;
-                uint8_t curr_col = tela[cy * DISPLAY_WIDTH + cx];
-                uint8_t pixel_sprite = ((bits >> (7 - col)) & 1);
-                if (pixel_sprite)
+                liberadas = !pular_ociosos;
+                if (pular_ociosos)
                 {
-                    if (curr_col)
-                    {
-                        tela[cy * DISPLAY_WIDTH + cx] = 0;
-                        registradores[0xF] = 1;
-                    }
-                    else
-                    {
-                        tela[cy * DISPLAY_WIDTH + cx] = 1;
-                    }
+                    bool mesmo_alvo = laco.alvo == pc;
+                    uint32_t antes = n;
+                    n = pular_laco_ocioso(laco, pc, n);
+                    ativas = mesmo_alvo && laco.restantes == antes ? ativas + 1 : 0;
+                    liberadas = ativas >= VOLTAS_ATIVAS;
                 }
+                if (liberadas)
+                    jit->ligar_volta(ctl.ligacao, pc, memoria);
+                ctl.volta = 0;
             }
+            else if (ctl.ligacao)
+            {
+                jit->ligar(ctl.ligacao, pc, memoria);
+            }
+            if (consumidas)
+                continue;
         }
-        deveDesenhar = true;
-        pc += 2;
-        break;
+        executadas += interpretar(1);
+        --n;
+    }
+    return executadas;
+}
+
+// Laço ocioso: dentro de uma chamada a interpretar timers e teclas não mudam, então se a VM
+// volta ao mesmo alvo de um salto para trás com exatamente o mesmo estado (registradores, I,
+// pilha, timers, rng) e sem ter escrito na memória ou na tela, toda volta seguinte é idêntica à anterior.
+// É o caso das esperas FX07/3X00/1NNN pelo delay timer e do laço final "JP para si mesmo".
+// Pulamos as voltas inteiras que cabem no orçamento: o resultado é o mesmo de executá-las, e o
+// frame ocioso custa uma ou duas voltas em vez de hz/60 instruções.
+// Devolve o novo número de instruções restantes.
+uint32_t Chip8::pular_laco_ocioso(LacoOcioso &laco, uint16_t alvo, uint32_t restantes)
+{
+    if (alvo == laco.alvo && efeitos == laco.efeitos && indiceI == laco.indiceI &&
+        ponteiro_pilha == laco.ponteiro_pilha && estado_rng == laco.estado_rng &&
+        temporizador_delay == laco.temporizador_delay && temporizador_som == laco.temporizador_som &&
+        std::memcmp(registradores, laco.registradores, sizeof(registradores)) == 0 &&
+        std::memcmp(pilha, laco.pilha, sizeof(pilha)) == 0)
+    {
+        uint32_t volta = laco.restantes - restantes;
+        return volta ? restantes % volta : restantes;
     }
+    laco.alvo = alvo;
+    laco.restantes = restantes;
+    laco.efeitos = efeitos;
+    laco.indiceI = indiceI;
+    laco.ponteiro_pilha = ponteiro_pilha;
+    laco.estado_rng = estado_rng;
+    laco.temporizador_delay = temporizador_delay;
+    laco.temporizador_som = temporizador_som;
+    std::memcpy(laco.registradores, registradores, sizeof(registradores));
+    std::memcpy(laco.pilha, pilha, sizeof(pilha));
+    return restantes;
+}
 
-    case 0xE000:
+// Máscara de I e dos endereços de dados: 64 KB no XO-CHIP, 4 KB nos demais
+template <Quirks Q>
+static constexpr uint16_t MASCARA_I = RegrasQuirks<Q>::xochip ? 0xFFFF : 0x0FFF;
+
+template <Quirks Q>
+inline uint8_t Chip8::ler_dado(uint32_t endereco) const
+{
+    endereco &= MASCARA_I<Q>;
+    if constexpr (RegrasQuirks<Q>::xochip)
     {
-        switch (inst & 0x00FF)
+        if (endereco >= TAM_MEMORIA)
+            return ext->memoria_alta[endereco - TAM_MEMORIA];
+    }
+    return memoria[endereco];
+}
+
+// A memória alta não tem código decodificado: só conta o efeito (laços ociosos)
+template <Quirks Q>
+inline void Chip8::escrever_dado(uint32_t endereco, uint8_t valor)
+{
+    endereco &= MASCARA_I<Q>;
+    if constexpr (RegrasQuirks<Q>::xochip)
+    {
+        if (endereco >= TAM_MEMORIA)
         {
-        case 0x009E: // SKP Vx
-            if (teclas[registradores[X]])
-                pc += 4;
-            else
-                pc += 2;
-            break;
-        case 0x00A1: // SKNP Vx
-            if (!teclas[registradores[X]])
-                pc += 4;
-            else
-                pc += 2;
-            break;
-        default:
-            pc += 2;
-            break;
+            ext->memoria_alta[endereco - TAM_MEMORIA] = valor;
+            ++efeitos;
+            return;
         }
-        break;
     }
+    escrever_memoria((uint16_t)endereco, valor);
+}
 
-    case 0xF000:
+template <Quirks Q>
+inline uint16_t Chip8::ler_opcode(uint16_t endereco) const
+{
+    if constexpr (RegrasQuirks<Q>::xochip)
+        return (uint16_t)(ler_dado<Q>(endereco) << 8 | ler_dado<Q>(endereco + 1u));
+    return (uint16_t)(memoria[endereco & 0x0FFF] << 8 | memoria[(endereco + 1) & 0x0FFF]);
+}
+
+// A partir de 0x0FFF (a instrução atravessa ou está acima de 0x1000) o XO-CHIP decodifica da
+// memória alta; abaixo disso, e nos outros perfis, vale o cache
+template <Quirks Q>
+inline const Decodificada &Chip8::buscar_instrucao(uint16_t endereco, Decodificada &alta)
+{
+    if constexpr (RegrasQuirks<Q>::xochip)
     {
-        switch (inst & 0x00FF)
+        if (endereco >= TAM_MEMORIA - 1)
         {
-        case 0x0007: // LD Vx, delay_timer
-            registradores[X] = temporizador_delay;
-            pc += 2;
-            break;
-        case 0x000A: // LD Vx, K (wait for key)
-            // set waiting state and return without advancing PC
-            aguardando_tecla = true;
-            reg_aguardando_tecla = X;
-            // do NOT change PC; next cycles will return early while waitingForKey==true
-            break;
-        case 0x0015: // LD delay_timer, Vx
-            temporizador_delay = registradores[X];
-            pc += 2;
-            break;
-        case 0x0018: // LD sound_timer, Vx
-            temporizador_som = registradores[X];
-            pc += 2;
-            break;
-        case 0x001E: // ADD I, Vx
-            indiceI = (indiceI + registradores[X]) & 0x0FFF;
-            pc += 2;
-            break;
-        case 0x0029: // LD F, Vx (set I to location of sprite for digit Vx)
-            indiceI = 0x50 + (registradores[X] * 5);
-            pc += 2;
-            break;
-        case 0x0033: // LD B, Vx (BCD)
-            memoria[indiceI] = registradores[X] / 100;
-            memoria[indiceI + 1] = (registradores[X] / 10) % 10;
-            memoria[indiceI + 2] = registradores[X] % 10;
-            pc += 2;
-            break;
-        case 0x0055: // LD [I], V0..Vx
-            for (int i = 0; i <= X; ++i)
-                memoria[indiceI + i] = registradores[i];
-            pc += 2;
-            break;
-        case 0x0065: // LD V0..Vx, [I]
-            for (int i = 0; i <= X; ++i)
-                registradores[i] = memoria[indiceI + i];
-            pc += 2;
-            break;
-        default:
-            pc += 2;
-            break;
+            alta = decodificar(ler_opcode<Q>(endereco));
+            return alta;
         }
-        break;
     }
+    return buscar_decodificada(endereco);
+}
 
-    default:
-        pc += 2;
-        break;
-    } // end switch
+// Destino de um skip tomado: no XO-CHIP pula a instrução longa F000 NNNN inteira
+template <Quirks Q>
+inline uint16_t Chip8::pular(uint16_t pc_atual) const
+{
+    if constexpr (RegrasQuirks<Q>::xochip)
+    {
+        if (ler_opcode<Q>(pc_atual + 2) == 0xF000)
+            return pc_atual + 6;
+    }
+    return pc_atual + 4;
 }
 
-void Chip8::VM_ImprimirRegistradores()
+// Escolhe a instância do interpretador do perfil atual, com a coleta do modo fuzz, o rastro ou
+// nenhum dos dois; nada disso muda dentro da chamada
+uint32_t Chip8::interpretar(uint32_t n)
 {
-    printf("PC: 0x%04X I: 0x%04X SP: 0x%02X\n", pc, indiceI, ponteiro_pilha);
-    for (int i = 0; i < 16; i++)
+    if (coleta)
+        return interpretar_perfil<INSTRUMENTACAO_FUZZ>(n);
+    if (rastro)
+        return interpretar_perfil<INSTRUMENTACAO_RASTRO>(n);
+    return interpretar_perfil<SEM_INSTRUMENTACAO>(n);
+}
+
+template <Instrumentacao Modo>
+uint32_t Chip8::interpretar_perfil(uint32_t n)
+{
+    switch (quirks)
     {
-        printf("V[%X]: 0x%02X ", i, registradores[i]);
+    case QUIRKS_COSMAC_VIP:
+        return interpretar_quirks<QUIRKS_COSMAC_VIP, Modo>(n);
+    case QUIRKS_CHIP48:
+        return interpretar_quirks<QUIRKS_CHIP48, Modo>(n);
+    case QUIRKS_SCHIP:
+        return interpretar_quirks<QUIRKS_SCHIP, Modo>(n);
+    case QUIRKS_XOCHIP:
+        return interpretar_quirks<QUIRKS_XOCHIP, Modo>(n);
+    default:
+        return interpretar_quirks<QUIRKS_MODERNO, Modo>(n);
     }
-    printf("\n");
 }
 
-void Chip8::tickTimers()
+// Modo fuzz: antes de executar a instrução, confere os acessos que ela faria fora dos limites de
+// um CHIP-8 real. O emulador segue com o comportamento de sempre (endereços dão a volta, a pilha
+// circula); aqui só fica registrado que a ROM fez isso.
+template <Quirks Q>
+inline void Chip8::conferir_acessos(const Decodificada &d, uint16_t pc_atual)
 {
-    if (temporizador_delay > 0)
-        --temporizador_delay;
-    if (temporizador_som > 0)
+    const uint32_t fim = RegrasQuirks<Q>::xochip ? 0x10000 : TAM_MEMORIA;
+    uint32_t lidos = 0, escritos = 0;
+    bool valida = true;
+
+    if (pc_atual < 0x200 || pc_atual > fim - 2)
+        coleta->registrar(VIOLACAO_PC, pc_atual, pc_atual);
+    switch (d.op)
     {
-        --temporizador_som;
-        if (temporizador_som == 1)
-            std::cout << '\a'; // beep ASCII
+    case OP_NOP:
+        valida = (ler_opcode<Q>(pc_atual) & 0xF000) == 0; // 0NNN (SYS) é ignorada de propósito
+        break;
+    case OP_CALL:
+        if (ponteiro_pilha == 15) // o 16º nível faz o ponteiro dar a volta e perde os retornos
+            coleta->registrar(VIOLACAO_PILHA_CHEIA, pc_atual, ponteiro_pilha);
+        break;
+    case OP_RET:
+        if (ponteiro_pilha == 0)
+            coleta->registrar(VIOLACAO_PILHA_VAZIA, pc_atual, ponteiro_pilha);
+        break;
+    case OP_DRW:
+        if constexpr (RegrasQuirks<Q>::superchip)
+            lidos = (d.n ? d.n : 32) * __builtin_popcount(ext->planos);
+        else
+            lidos = d.n;
+        break;
+    case OP_LD_B_VX:
+        escritos = 3;
+        break;
+    case OP_LD_I_VX:
+        escritos = d.x + 1u;
+        break;
+    case OP_LD_VX_I:
+        lidos = d.x + 1u;
+        break;
+    case OP_SAVE_VX_VY:
+        valida = RegrasQuirks<Q>::xochip;
+        escritos = valida ? (d.x <= d.y ? d.y - d.x : d.x - d.y) + 1u : 0;
+        break;
+    case OP_LOAD_VX_VY:
+        valida = RegrasQuirks<Q>::xochip;
+        lidos = valida ? (d.x <= d.y ? d.y - d.x : d.x - d.y) + 1u : 0;
+        break;
+    case OP_AUDIO:
+        valida = RegrasQuirks<Q>::xochip;
+        lidos = valida ? 16 : 0;
+        break;
+    case OP_SCU:
+    case OP_LD_I_LONGO:
+    case OP_PLANO:
+    case OP_LD_TOM_VX:
+        valida = RegrasQuirks<Q>::xochip;
+        break;
+    default:
+        valida = d.op < OP_SCD || RegrasQuirks<Q>::superchip;
+        break;
     }
+    if (!valida)
+        coleta->registrar(VIOLACAO_INSTRUCAO, pc_atual, ler_opcode<Q>(pc_atual));
+    if (lidos && indiceI + lidos > fim)
+        coleta->registrar(VIOLACAO_LEITURA, pc_atual, indiceI);
+    if (escritos && indiceI + escritos > fim)
+        coleta->registrar(VIOLACAO_ESCRITA, pc_atual, indiceI);
+    else if (escritos && indiceI < 0x200)
+        coleta->registrar(VIOLACAO_ESCRITA_SISTEMA, pc_atual, indiceI);
+}
+
+// Modo rastro: os registradores que entram numa EntradaRastro
+inline void Chip8::copiar_registros_rastro(EntradaRastro &e) const
+{
+    std::memcpy(e.v, registradores, sizeof(registradores));
+    e.i = indiceI;
+    e.sp = ponteiro_pilha;
+    e.dt = temporizador_delay;
+    e.st = temporizador_som;
+}
+
+// Bits MUDOU_* entre o estado antes e o depois de uma instrução
+static inline uint32_t mudancas_rastro(const EntradaRastro &antes, const EntradaRastro &depois)
+{
+    uint32_t mudou = 0;
+    for (int k = 0; k < 16; ++k)
+        mudou |= (uint32_t)(antes.v[k] != depois.v[k]) << k;
+    mudou |= antes.i != depois.i ? MUDOU_I : 0;
+    mudou |= antes.sp != depois.sp ? MUDOU_SP : 0;
+    mudou |= antes.dt != depois.dt ? MUDOU_DT : 0;
+    mudou |= antes.st != depois.st ? MUDOU_ST : 0;
+    return mudou;
+}
+
+// Laço quente do interpretador com despacho direto do OpCode pré-decodificado. A instância
+// INSTRUMENTACAO_FUZZ marca cada pc e aresta na coleta do modo fuzz e confere os acessos antes de
+// executar; a INSTRUMENTACAO_RASTRO escreve uma entrada por instrução no anel do rastro.
+template <Quirks Q, Instrumentacao Modo>
+uint32_t Chip8::interpretar_quirks(uint32_t n)
+{
+    const uint32_t pedidas = n;
+    uint32_t puladas = 0;
+    // pc fica numa variável local durante o laço: os manipuladores recebem o pc e devolvem o próximo
+    uint16_t pc_local = pc;
+    LacoOcioso laco;
+    laco.alvo = 0xFFFF;
+    // idem para o hash do pc anterior do modo fuzz: os incrementos no mapa (bytes) obrigariam o
+    // compilador a reler tudo da memória
+    ColetaFuzz *const c = coleta;
+    uint16_t anterior = Modo == INSTRUMENTACAO_FUZZ ? c->anterior : 0;
+    // e para a posição no anel do rastro, que só é publicada no fim
+    RastroChip8 *const r = rastro;
+    EntradaRastro *const anel = Modo == INSTRUMENTACAO_RASTRO ? r->entradas() : nullptr;
+    uint64_t cabeca = Modo == INSTRUMENTACAO_RASTRO ? r->posicao() : 0;
+    uint64_t limite = Modo == INSTRUMENTACAO_RASTRO ? r->limite() : 0;
+    uint32_t pulo = 0;
+    Decodificada alta; // instrução acima de 0x0FFF no XO-CHIP (ver buscar_instrucao)
+
+    // Se estamos aguardando tecla, não execute instruções até receber uma
+    while (n-- > 0 && !aguardando_tecla)
+    {
+        const Decodificada &d = buscar_instrucao<Q>(pc_local, alta);
+        PERFIL(++perfil.por_opcode[d.op]; ++perfil.por_pc[pc_local & 0x0FFF];)
+        if constexpr (Modo == INSTRUMENTACAO_FUZZ)
+        {
+            anterior = c->visitar(pc_local, anterior);
+            conferir_acessos<Q>(d, pc_local);
+        }
+        [[maybe_unused]] EntradaRastro antes;
+        if constexpr (Modo == INSTRUMENTACAO_RASTRO)
+        {
+            antes.pc = pc_local;
+            antes.opcode = ler_opcode<Q>(pc_local);
+            copiar_registros_rastro(antes);
+        }
+        switch (d.op)
+        {
+        case OP_NOP:
+            pc_local = op_NOP(d, pc_local);
+            break;
+        case OP_CLS:
+            pc_local = op_CLS<Q>(d, pc_local);
+            break;
+        case OP_RET:
+            pc_local = op_RET(d, pc_local);
+            break;
+        case OP_JP:
+            if (d.nnn <= pc_local && pular_ociosos) // salto para trás: candidato a laço ocioso
+            {
+                uint32_t restantes = n;
+                n = pular_laco_ocioso(laco, d.nnn, n);
+                pulo = restantes - n;
+                puladas += pulo;
+            }
+            pc_local = op_JP(d, pc_local);
+            break;
+        case OP_CALL:
+            pc_local = op_CALL(d, pc_local);
+            break;
+        case OP_SE_BYTE:
+            pc_local = op_SE_BYTE<Q>(d, pc_local);
+            break;
+        case OP_SNE_BYTE:
+            pc_local = op_SNE_BYTE<Q>(d, pc_local);
+            break;
+        case OP_SE_REG:
+            pc_local = op_SE_REG<Q>(d, pc_local);
+            break;
+        case OP_LD_BYTE:
+            pc_local = op_LD_BYTE(d, pc_local);
+            break;
+        case OP_ADD_BYTE:
+            pc_local = op_ADD_BYTE(d, pc_local);
+            break;
+        case OP_LD_REG:
+            pc_local = op_LD_REG(d, pc_local);
+            break;
+        case OP_OR:
+            pc_local = op_OR<Q>(d, pc_local);
+            break;
+        case OP_AND:
+            pc_local = op_AND<Q>(d, pc_local);
+            break;
+        case OP_XOR:
+            pc_local = op_XOR<Q>(d, pc_local);
+            break;
+        case OP_ADD_REG:
+            pc_local = op_ADD_REG(d, pc_local);
+            break;
+        case OP_SUB:
+            pc_local = op_SUB(d, pc_local);
+            break;
+        case OP_SHR:
+            pc_local = op_SHR<Q>(d, pc_local);
+            break;
+        case OP_SUBN:
+            pc_local = op_SUBN(d, pc_local);
+            break;
+        case OP_SHL:
+            pc_local = op_SHL<Q>(d, pc_local);
+            break;
+        case OP_SNE_REG:
+            pc_local = op_SNE_REG<Q>(d, pc_local);
+            break;
+        case OP_LD_I:
+            pc_local = op_LD_I(d, pc_local);
+            break;
+        case OP_JP_V0:
+            pc_local = op_JP_V0<Q>(d, pc_local);
+            break;
+        case OP_RND:
+            pc_local = op_RND(d, pc_local);
+            break;
+        case OP_DRW:
+        {
+            PERFIL(auto t_drw = std::chrono::steady_clock::now();)
+            pc_local = op_DRW<Q>(d, pc_local);
+            PERFIL(perfil.ns_drw += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                        std::chrono::steady_clock::now() - t_drw).count();)
+            break;
+        }
+        case OP_SKP:
+            pc_local = op_SKP<Q>(d, pc_local);
+            break;
+        case OP_SKNP:
+            pc_local = op_SKNP<Q>(d, pc_local);
+            break;
+        case OP_LD_VX_DT:
+            pc_local = op_LD_VX_DT(d, pc_local);
+            break;
+        case OP_LD_VX_K:
+            pc_local = op_LD_VX_K(d, pc_local);
+            break;
+        case OP_LD_DT_VX:
+            pc_local = op_LD_DT_VX(d, pc_local);
+            break;
+        case OP_LD_ST_VX:
+            pc_local = op_LD_ST_VX(d, pc_local);
+            break;
+        case OP_ADD_I_VX:
+            pc_local = op_ADD_I_VX<Q>(d, pc_local);
+            break;
+        case OP_LD_F_VX:
+            pc_local = op_LD_F_VX(d, pc_local);
+            break;
+        case OP_LD_B_VX:
+            pc_local = op_LD_B_VX<Q>(d, pc_local);
+            break;
+        case OP_LD_I_VX:
+            pc_local = op_LD_I_VX<Q>(d, pc_local);
+            break;
+        case OP_LD_VX_I:
+            pc_local = op_LD_VX_I<Q>(d, pc_local);
+            break;
+        case OP_SCD:
+            pc_local = op_SCD<Q>(d, pc_local);
+            break;
+        case OP_SCU:
+            pc_local = op_SCU<Q>(d, pc_local);
+            break;
+        case OP_SCR:
+            pc_local = op_SCR<Q>(d, pc_local);
+            break;
+        case OP_SCL:
+            pc_local = op_SCL<Q>(d, pc_local);
+            break;
+        case OP_EXIT:
+            pc_local = op_EXIT<Q>(d, pc_local);
+            if constexpr (RegrasQuirks<Q>::superchip)
+                n = 0; // parada: o resto do orçamento passaria no mesmo pc
+            break;
+        case OP_LOW:
+            pc_local = op_LOW<Q>(d, pc_local);
+            break;
+        case OP_HIGH:
+            pc_local = op_HIGH<Q>(d, pc_local);
+            break;
+        case OP_SAVE_VX_VY:
+            pc_local = op_SAVE_VX_VY<Q>(d, pc_local);
+            break;
+        case OP_LOAD_VX_VY:
+            pc_local = op_LOAD_VX_VY<Q>(d, pc_local);
+            break;
+        case OP_LD_I_LONGO:
+            pc_local = op_LD_I_LONGO<Q>(d, pc_local);
+            break;
+        case OP_PLANO:
+            pc_local = op_PLANO<Q>(d, pc_local);
+            break;
+        case OP_AUDIO:
+            pc_local = op_AUDIO<Q>(d, pc_local);
+            break;
+        case OP_LD_HF_VX:
+            pc_local = op_LD_HF_VX<Q>(d, pc_local);
+            break;
+        case OP_LD_TOM_VX:
+            pc_local = op_LD_TOM_VX<Q>(d, pc_local);
+            break;
+        case OP_LD_R_VX:
+            pc_local = op_LD_R_VX<Q>(d, pc_local);
+            break;
+        case OP_LD_VX_R:
+            pc_local = op_LD_VX_R<Q>(d, pc_local);
+            break;
+        default: // OP_NAO_DECODIFICADA nunca chega aqui (ver buscar_decodificada)
+            break;
+        }
+
+        if constexpr (Modo == INSTRUMENTACAO_RASTRO)
+        {
+            if (cabeca == limite)
+                limite = r->esperar_espaco(cabeca);
+            EntradaRastro &e = anel[cabeca++ & (RastroChip8::CAPACIDADE - 1)];
+            e.pc = antes.pc;
+            e.opcode = antes.opcode;
+            copiar_registros_rastro(e);
+            e.mudou = mudancas_rastro(antes, e);
+            e.tipo = RASTRO_INSTRUCAO;
+            if (pulo)
+            {
+                if (cabeca == limite)
+                    limite = r->esperar_espaco(cabeca);
+                EntradaRastro &p = anel[cabeca++ & (RastroChip8::CAPACIDADE - 1)];
+                p.mudou = pulo;
+                p.tipo = RASTRO_PULO;
+                pulo = 0;
+            }
+        }
+    }
+
+    pc = pc_local;
+    if constexpr (Modo == INSTRUMENTACAO_FUZZ)
+        c->anterior = anterior;
+    if constexpr (Modo == INSTRUMENTACAO_RASTRO)
+        r->publicar(cabeca);
+    // o n-- da condição deixa n uma unidade abaixo do que sobrou, inclusive ao esgotar (0 - 1)
+    return pedidas - puladas - (n + 1);
+}
+
+uint16_t Chip8::op_NOP(const Decodificada &, uint16_t pc_atual)
+{
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_CLS(const Decodificada &, uint16_t pc_atual)
+{
+    ++efeitos;
+    if constexpr (RegrasQuirks<Q>::superchip)
+    {
+        limpar_planos();
+        return pc_atual + 2;
+    }
+    for (int y = 0; y < ALTURA_TELA; ++y)
+        linhas_sujas |= (uint32_t)(tela[y] != 0) << y;
+    std::memset(tela, 0, sizeof(tela));
+    return pc_atual + 2;
+}
+
+uint16_t Chip8::op_RET(const Decodificada &, uint16_t pc_atual)
+{
+    if (ponteiro_pilha > 0)
+    {
+        ponteiro_pilha--;
+        return pilha[ponteiro_pilha];
+    }
+    return pc_atual + 2; // fallback
+}
+
+uint16_t Chip8::op_JP(const Decodificada &d, uint16_t)
+{
+    return d.nnn;
+}
+
+uint16_t Chip8::op_CALL(const Decodificada &d, uint16_t pc_atual)
+{
+    pilha[ponteiro_pilha] = pc_atual + 2;
+    ponteiro_pilha = (ponteiro_pilha + 1) & 0x0F; // manter em 0..15
+    return d.nnn;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_SE_BYTE(const Decodificada &d, uint16_t pc_atual)
+{
+    return (registradores[d.x] == d.nn) ? pular<Q>(pc_atual) : pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_SNE_BYTE(const Decodificada &d, uint16_t pc_atual)
+{
+    return (registradores[d.x] != d.nn) ? pular<Q>(pc_atual) : pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_SE_REG(const Decodificada &d, uint16_t pc_atual)
+{
+    return (registradores[d.x] == registradores[d.y]) ? pular<Q>(pc_atual) : pc_atual + 2;
+}
+
+uint16_t Chip8::op_LD_BYTE(const Decodificada &d, uint16_t pc_atual)
+{
+    registradores[d.x] = d.nn;
+    return pc_atual + 2;
+}
+
+uint16_t Chip8::op_ADD_BYTE(const Decodificada &d, uint16_t pc_atual)
+{
+    registradores[d.x] = (registradores[d.x] + d.nn) & 0xFF;
+    return pc_atual + 2;
+}
+
+uint16_t Chip8::op_LD_REG(const Decodificada &d, uint16_t pc_atual)
+{
+    registradores[d.x] = registradores[d.y];
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_OR(const Decodificada &d, uint16_t pc_atual)
+{
+    registradores[d.x] |= registradores[d.y];
+    if constexpr (RegrasQuirks<Q>::zerar_vf_logica)
+        registradores[0xF] = 0;
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_AND(const Decodificada &d, uint16_t pc_atual)
+{
+    registradores[d.x] &= registradores[d.y];
+    if constexpr (RegrasQuirks<Q>::zerar_vf_logica)
+        registradores[0xF] = 0;
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_XOR(const Decodificada &d, uint16_t pc_atual)
+{
+    registradores[d.x] ^= registradores[d.y];
+    if constexpr (RegrasQuirks<Q>::zerar_vf_logica)
+        registradores[0xF] = 0;
+    return pc_atual + 2;
+}
+
+uint16_t Chip8::op_ADD_REG(const Decodificada &d, uint16_t pc_atual)
+{
+    uint16_t sum = registradores[d.x] + registradores[d.y];
+    registradores[0xF] = (sum > 0xFF) ? 1 : 0;
+    registradores[d.x] = sum & 0xFF;
+    return pc_atual + 2;
+}
+
+uint16_t Chip8::op_SUB(const Decodificada &d, uint16_t pc_atual)
+{
+    registradores[0xF] = (registradores[d.x] > registradores[d.y]) ? 1 : 0;
+    registradores[d.x] = (registradores[d.x] - registradores[d.y]) & 0xFF;
+    return pc_atual + 2;
+}
+
+// Moderno: desloca Vx no lugar, VF = bit que saiu. COSMAC VIP: Vx = Vy deslocado.
+template <Quirks Q>
+uint16_t Chip8::op_SHR(const Decodificada &d, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::deslocar_vy)
+    {
+        uint8_t v = registradores[d.y];
+        registradores[d.x] = v >> 1;
+        registradores[0xF] = v & 0x1;
+        return pc_atual + 2;
+    }
+    registradores[0xF] = registradores[d.x] & 0x1;
+    registradores[d.x] >>= 1;
+    return pc_atual + 2;
+}
+
+uint16_t Chip8::op_SUBN(const Decodificada &d, uint16_t pc_atual)
+{
+    registradores[0xF] = (registradores[d.y] > registradores[d.x]) ? 1 : 0;
+    registradores[d.x] = (registradores[d.y] - registradores[d.x]) & 0xFF;
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_SHL(const Decodificada &d, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::deslocar_vy)
+    {
+        uint8_t v = registradores[d.y];
+        registradores[d.x] = (v << 1) & 0xFF;
+        registradores[0xF] = (v >> 7) & 0x1;
+        return pc_atual + 2;
+    }
+    registradores[0xF] = (registradores[d.x] >> 7) & 0x1;
+    registradores[d.x] = (registradores[d.x] << 1) & 0xFF;
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_SNE_REG(const Decodificada &d, uint16_t pc_atual)
+{
+    return (registradores[d.x] != registradores[d.y]) ? pular<Q>(pc_atual) : pc_atual + 2;
+}
+
+uint16_t Chip8::op_LD_I(const Decodificada &d, uint16_t pc_atual)
+{
+    indiceI = d.nnn;
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_JP_V0(const Decodificada &d, uint16_t)
+{
+    // CHIP-48: BXNN salta para XNN + VX
+    return d.nnn + registradores[RegrasQuirks<Q>::salto_vx ? d.x : 0];
+}
+
+uint16_t Chip8::op_RND(const Decodificada &d, uint16_t pc_atual)
+{
+    uint8_t rnd = (uint8_t)(pcg32_proximo(estado_rng) >> 24);
+    registradores[d.x] = rnd & d.nn;
+    return pc_atual + 2;
+}
+
+// Cada linha do sprite vira uma máscara de 64 bits rotacionada até x (a rotação faz o
+// wrap horizontal); colisão é um AND com a linha da tela e o desenho é um XOR. Só linhas com
+// sprite não nulo mudam, e só elas são marcadas em linhas_sujas. Nos perfis que recortam, a
+// posição inicial ainda dá a volta mas o que passa da borda é descartado: deslocamento simples
+// em vez de rotação e só as linhas até o fim da tela.
+template <Quirks Q>
+uint16_t Chip8::op_DRW(const Decodificada &d, uint16_t pc_atual)
+{
+    ++efeitos;
+    if constexpr (RegrasQuirks<Q>::superchip)
+    {
+        registradores[0xF] = desenhar_estendido<Q>(d);
+        return pc_atual + 2;
+    }
+    uint8_t xcoord = registradores[d.x] % LARGURA_TELA;
+    uint8_t ycoord = registradores[d.y] % ALTURA_TELA;
+
+    uint8_t linhas = d.n;
+    if constexpr (RegrasQuirks<Q>::recortar_sprites)
+        linhas = (uint8_t)std::min<int>(d.n, ALTURA_TELA - ycoord);
+
+    uint64_t colisao = 0;
+    for (uint8_t row = 0; row < linhas; row++)
+    {
+        uint64_t bits = (uint64_t)memoria[(indiceI + row) & 0x0FFF] << 56;
+        uint64_t sprite = bits >> xcoord;
+        if constexpr (!RegrasQuirks<Q>::recortar_sprites)
+            sprite |= bits << ((LARGURA_TELA - xcoord) & 63);
+        uint8_t y = (ycoord + row) % ALTURA_TELA;
+        colisao |= tela[y] & sprite;
+        tela[y] ^= sprite;
+        linhas_sujas |= (uint32_t)(sprite != 0) << y;
+    }
+    registradores[0xF] = colisao ? 1 : 0;
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_SKP(const Decodificada &d, uint16_t pc_atual)
+{
+    return (teclas >> (registradores[d.x] & 0x0F)) & 1 ? pular<Q>(pc_atual) : pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_SKNP(const Decodificada &d, uint16_t pc_atual)
+{
+    return !((teclas >> (registradores[d.x] & 0x0F)) & 1) ? pular<Q>(pc_atual) : pc_atual + 2;
+}
+
+uint16_t Chip8::op_LD_VX_DT(const Decodificada &d, uint16_t pc_atual)
+{
+    registradores[d.x] = temporizador_delay;
+    return pc_atual + 2;
+}
+
+// LD Vx, K (wait for key)
+uint16_t Chip8::op_LD_VX_K(const Decodificada &d, uint16_t pc_atual)
+{
+    // set waiting state and return without advancing PC
+    aguardando_tecla = true;
+    reg_aguardando_tecla = d.x;
+    // do NOT change PC; next cycles will return early while waitingForKey==true
+    return pc_atual;
+}
+
+uint16_t Chip8::op_LD_DT_VX(const Decodificada &d, uint16_t pc_atual)
+{
+    temporizador_delay = registradores[d.x];
+    return pc_atual + 2;
+}
+
+uint16_t Chip8::op_LD_ST_VX(const Decodificada &d, uint16_t pc_atual)
+{
+    temporizador_som = registradores[d.x];
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_ADD_I_VX(const Decodificada &d, uint16_t pc_atual)
+{
+    indiceI = (indiceI + registradores[d.x]) & MASCARA_I<Q>;
+    return pc_atual + 2;
+}
+
+// LD F, Vx (set I to location of sprite for digit Vx)
+uint16_t Chip8::op_LD_F_VX(const Decodificada &d, uint16_t pc_atual)
+{
+    indiceI = 0x50 + (registradores[d.x] * 5);
+    return pc_atual + 2;
+}
+
+// LD B, Vx (BCD)
+template <Quirks Q>
+uint16_t Chip8::op_LD_B_VX(const Decodificada &d, uint16_t pc_atual)
+{
+    uint8_t v = registradores[d.x];
+    escrever_dado<Q>(indiceI, v / 100);
+    escrever_dado<Q>(indiceI + 1, (v / 10) % 10);
+    escrever_dado<Q>(indiceI + 2, v % 10);
+    return pc_atual + 2;
+}
+
+// LD [I], V0..Vx
+template <Quirks Q>
+uint16_t Chip8::op_LD_I_VX(const Decodificada &d, uint16_t pc_atual)
+{
+    for (int i = 0; i <= d.x; ++i)
+        escrever_dado<Q>(indiceI + i, registradores[i]);
+    if constexpr (RegrasQuirks<Q>::incrementar_i)
+        indiceI = (indiceI + d.x + RegrasQuirks<Q>::extra_i) & MASCARA_I<Q>;
+    return pc_atual + 2;
+}
+
+// LD V0..Vx, [I]
+template <Quirks Q>
+uint16_t Chip8::op_LD_VX_I(const Decodificada &d, uint16_t pc_atual)
+{
+    for (int i = 0; i <= d.x; ++i)
+        registradores[i] = ler_dado<Q>(indiceI + i);
+    if constexpr (RegrasQuirks<Q>::incrementar_i)
+        indiceI = (indiceI + d.x + RegrasQuirks<Q>::extra_i) & MASCARA_I<Q>;
+    return pc_atual + 2;
+}
+
+// ---- SUPER-CHIP e XO-CHIP ----------------------------------------------------------------
+// Nos outros perfis as instruções abaixo são NOP, como antes de existirem.
+
+typedef unsigned __int128 Linha128; // bit 127 = coluna 0
+
+static inline Linha128 ler_linha(const uint64_t linha[2])
+{
+    return ((Linha128)linha[0] << 64) | linha[1];
+}
+
+static inline void gravar_linha(uint64_t linha[2], Linha128 v)
+{
+    linha[0] = (uint64_t)(v >> 64);
+    linha[1] = (uint64_t)v;
+}
+
+// Cada bit de um byte vira dois (pixels de baixa resolução na tela de 128 colunas)
+static inline uint16_t dobrar_bits(uint8_t b)
+{
+    uint16_t r = 0;
+    for (int i = 0; i < 8; ++i)
+        r |= (uint16_t)(((b >> i) & 1) * 3) << (2 * i);
+    return r;
+}
+
+// Sprite de largura bits colocado na coluna: deslocamento simples (recorte) ou rotação (volta)
+static inline Linha128 posicionar_sprite(uint32_t bits, int largura, int coluna, bool recortar)
+{
+    Linha128 v = (Linha128)bits << (128 - largura);
+    if (recortar || coluna == 0)
+        return v >> coluna;
+    return (v >> coluna) | (v << (128 - coluna));
+}
+
+void Chip8::limpar_planos()
+{
+    for (int p = 0; p < PLANOS; ++p)
+    {
+        if (!(ext->planos & (1 << p)))
+            continue;
+        std::memset(ext->tela[p], 0, sizeof(ext->tela[p]));
+    }
+    linhas_sujas = ~0u;
+}
+
+// linhas > 0 rola para baixo, < 0 para cima; o que entra pela borda é apagado
+void Chip8::rolar_vertical(int linhas)
+{
+    ++efeitos;
+    int n = linhas < 0 ? -linhas : linhas;
+    if (n > ALTURA_ALTA)
+        n = ALTURA_ALTA;
+    for (int p = 0; p < PLANOS; ++p)
+    {
+        if (!(ext->planos & (1 << p)))
+            continue;
+        uint64_t(*t)[2] = ext->tela[p];
+        size_t bytes = (ALTURA_ALTA - n) * sizeof(t[0]);
+        if (linhas > 0)
+        {
+            std::memmove(t[n], t[0], bytes);
+            std::memset(t[0], 0, n * sizeof(t[0]));
+        }
+        else
+        {
+            std::memmove(t[0], t[n], bytes);
+            std::memset(t[ALTURA_ALTA - n], 0, n * sizeof(t[0]));
+        }
+    }
+    linhas_sujas = ~0u;
+}
+
+// colunas > 0 rola para a direita, < 0 para a esquerda
+void Chip8::rolar_horizontal(int colunas)
+{
+    ++efeitos;
+    for (int p = 0; p < PLANOS; ++p)
+    {
+        if (!(ext->planos & (1 << p)))
+            continue;
+        for (int y = 0; y < ALTURA_ALTA; ++y)
+        {
+            Linha128 v = ler_linha(ext->tela[p][y]);
+            gravar_linha(ext->tela[p][y], colunas > 0 ? v >> colunas : v << -colunas);
+        }
+    }
+    linhas_sujas = ~0u;
+}
+
+// DXYN/DXY0 na tela de 128x64. Em baixa resolução as coordenadas valem 64x32 e cada pixel do
+// sprite vira 2x2. DXY0 desenha 16x16 (duas palavras de 8 bits por linha). Com os dois planos
+// selecionados, os dados do plano 1 vêm logo depois dos do plano 0. Devolve VF: 1 se algum pixel
+// aceso foi apagado em algum plano.
+template <Quirks Q>
+uint8_t Chip8::desenhar_estendido(const Decodificada &d)
+{
+    const bool recortar = RegrasQuirks<Q>::recortar_sprites;
+    int escala = ext->alta_resolucao ? 1 : 2;
+    int largura = LARGURA_ALTA / escala;
+    int altura = ALTURA_ALTA / escala;
+    int x0 = registradores[d.x] % largura;
+    int y0 = registradores[d.y] % altura;
+    bool grande = d.n == 0;
+    int linhas = grande ? 16 : d.n;
+    int bytes_linha = grande ? 2 : 1;
+
+    uint32_t endereco = indiceI;
+    bool colisao = false;
+    for (int p = 0; p < PLANOS; ++p)
+    {
+        if (!(ext->planos & (1 << p)))
+            continue;
+        for (int r = 0; r < linhas; ++r)
+        {
+            int y = y0 + r;
+            if (y >= altura)
+            {
+                if (recortar)
+                    break;
+                y -= altura;
+            }
+            uint32_t bits = ler_dado<Q>(endereco + r * bytes_linha);
+            if (grande)
+                bits = (bits << 8) | ler_dado<Q>(endereco + r * bytes_linha + 1);
+            int largura_bits = 8 * bytes_linha;
+            if (escala == 2)
+            {
+                bits = grande ? ((uint32_t)dobrar_bits(bits >> 8) << 16) | dobrar_bits(bits & 0xFF) : dobrar_bits(bits);
+                largura_bits *= 2;
+            }
+            Linha128 sprite = posicionar_sprite(bits, largura_bits, x0 * escala, recortar);
+            if (sprite == 0)
+                continue;
+            for (int k = 0; k < escala; ++k)
+            {
+                uint64_t *linha = ext->tela[p][y * escala + k];
+                Linha128 atual = ler_linha(linha);
+                colisao |= (atual & sprite) != 0;
+                gravar_linha(linha, atual ^ sprite);
+            }
+        }
+        endereco += linhas * bytes_linha;
+    }
+    linhas_sujas |= 1;
+    return colisao ? 1 : 0;
+}
+
+// 00CN: em baixa resolução o scroll é em pixels de baixa resolução (o dobro de linhas da tela)
+template <Quirks Q>
+uint16_t Chip8::op_SCD(const Decodificada &d, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::superchip)
+        rolar_vertical(d.n * (ext->alta_resolucao ? 1 : 2));
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_SCU(const Decodificada &d, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::xochip)
+        rolar_vertical(-d.n * (ext->alta_resolucao ? 1 : 2));
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_SCR(const Decodificada &, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::superchip)
+        rolar_horizontal(ext->alta_resolucao ? 4 : 8);
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_SCL(const Decodificada &, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::superchip)
+        rolar_horizontal(ext->alta_resolucao ? -4 : -8);
+    return pc_atual + 2;
+}
+
+// 00FD: o programa terminou; a VM fica parada neste pc
+template <Quirks Q>
+uint16_t Chip8::op_EXIT(const Decodificada &, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::superchip)
+        return pc_atual;
+    return pc_atual + 2;
+}
+
+// 00FE/00FF trocam a resolução e apagam a tela (todos os planos), como o Octo
+template <Quirks Q>
+uint16_t Chip8::op_LOW(const Decodificada &, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::superchip)
+    {
+        ++efeitos;
+        ext->alta_resolucao = false;
+        uint8_t selecionados = ext->planos;
+        ext->planos = 3;
+        limpar_planos();
+        ext->planos = selecionados;
+    }
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_HIGH(const Decodificada &, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::superchip)
+    {
+        ++efeitos;
+        ext->alta_resolucao = true;
+        uint8_t selecionados = ext->planos;
+        ext->planos = 3;
+        limpar_planos();
+        ext->planos = selecionados;
+    }
+    return pc_atual + 2;
+}
+
+// 5XY2: grava Vx..Vy (em ordem decrescente se x > y) a partir de I, sem mudar I
+template <Quirks Q>
+uint16_t Chip8::op_SAVE_VX_VY(const Decodificada &d, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::xochip)
+    {
+        int passo = d.x <= d.y ? 1 : -1;
+        int n = (d.x <= d.y ? d.y - d.x : d.x - d.y) + 1;
+        for (int i = 0; i < n; ++i)
+            escrever_dado<Q>(indiceI + i, registradores[d.x + i * passo]);
+    }
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_LOAD_VX_VY(const Decodificada &d, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::xochip)
+    {
+        int passo = d.x <= d.y ? 1 : -1;
+        int n = (d.x <= d.y ? d.y - d.x : d.x - d.y) + 1;
+        for (int i = 0; i < n; ++i)
+            registradores[d.x + i * passo] = ler_dado<Q>(indiceI + i);
+    }
+    return pc_atual + 2;
+}
+
+// F000 NNNN: I recebe a palavra seguinte (16 bits)
+template <Quirks Q>
+uint16_t Chip8::op_LD_I_LONGO(const Decodificada &, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::xochip)
+    {
+        indiceI = ler_opcode<Q>(pc_atual + 2);
+        return pc_atual + 4;
+    }
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_PLANO(const Decodificada &d, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::xochip)
+        ext->planos = d.x & 3;
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_AUDIO(const Decodificada &, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::xochip)
+    {
+        for (int i = 0; i < 16; ++i)
+            ext->padrao_som[i] = ler_dado<Q>(indiceI + i);
+    }
+    return pc_atual + 2;
+}
+
+// FX30: dígito grande (10 bytes por caractere)
+template <Quirks Q>
+uint16_t Chip8::op_LD_HF_VX(const Decodificada &d, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::superchip)
+        indiceI = FONTE_GRANDE + (registradores[d.x] & 0x0F) * 10;
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_LD_TOM_VX(const Decodificada &d, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::xochip)
+        ext->tom = registradores[d.x];
+    return pc_atual + 2;
+}
+
+// FX75/FX85: o SUPER-CHIP tem 8 flags, o XO-CHIP 16
+template <Quirks Q>
+uint16_t Chip8::op_LD_R_VX(const Decodificada &d, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::superchip)
+    {
+        int ultimo = RegrasQuirks<Q>::xochip ? d.x : std::min<int>(d.x, 7);
+        std::memcpy(ext->flags, registradores, ultimo + 1);
+        ++efeitos;
+    }
+    return pc_atual + 2;
+}
+
+template <Quirks Q>
+uint16_t Chip8::op_LD_VX_R(const Decodificada &d, uint16_t pc_atual)
+{
+    if constexpr (RegrasQuirks<Q>::superchip)
+    {
+        int ultimo = RegrasQuirks<Q>::xochip ? d.x : std::min<int>(d.x, 7);
+        std::memcpy(registradores, ext->flags, ultimo + 1);
+    }
+    return pc_atual + 2;
+}
+
+bool Chip8::VM_PadraoSom(uint8_t padrao[16], double &taxa_hz) const
+{
+    if (quirks != QUIRKS_XOCHIP)
+        return false;
+    uint8_t algum = 0;
+    for (int i = 0; i < 16; ++i)
+        algum |= ext->padrao_som[i];
+    if (!algum)
+        return false; // nenhum F002 ainda: o frontend toca o tom padrão
+    std::memcpy(padrao, ext->padrao_som, 16);
+    taxa_hz = 4000.0 * std::pow(2.0, (ext->tom - 64) / 48.0);
+    return true;
+}
+
+void Chip8::VM_ImprimirRegistradores()
+{
+    printf("PC: 0x%04X I: 0x%04X SP: 0x%02X\n", pc, indiceI, ponteiro_pilha);
+    for (int i = 0; i < 16; i++)
+    {
+        printf("V[%X]: 0x%02X ", i, registradores[i]);
+    }
+    printf("\n");
+}
+
+// Reinicia o gerador do CXNN: a mesma semente reproduz a mesma execução
+void Chip8::VM_DefinirSemente(uint64_t semente)
+{
+    estado_rng = pcg32_semear(semente);
+}
+
+// Atualiza o estado de uma tecla; uma tecla pressionada libera uma espera FX0A pendente
+void Chip8::VM_DefinirTecla(uint8_t tecla, bool pressionada)
+{
+    tecla &= 0xF;
+    if (pressionada)
+        teclas |= (uint16_t)(1u << tecla);
+    else
+        teclas &= (uint16_t)~(1u << tecla);
+    if (pressionada && aguardando_tecla)
+    {
+        registradores[reg_aguardando_tecla] = tecla;
+        aguardando_tecla = false;
+        pc += 2; // avança a instrução FX0A
+    }
+}
+
+// Hash FNV-1a de 64 bits das linhas da tela (dos dois planos de 128x64 nos perfis estendidos), para
+// comparar execuções sem guardar o framebuffer
+uint64_t Chip8::VM_HashTela() const
+{
+    if (ext)
+        return hash_tela(&ext->tela[0][0][0], sizeof(ext->tela) / sizeof(uint64_t));
+    return hash_tela(tela, ALTURA_TELA);
+}
+
+void Chip8::tickTimers()
+{
+    if (temporizador_delay > 0)
+        --temporizador_delay;
+    // o som é do frontend: ele consulta VM_SomAtivo() a cada frame
+    if (temporizador_som > 0)
+        --temporizador_som;
+    if (rastro)
+        rastro->marcar(RASTRO_FRAMES, 1);
+}
+
+void Chip8::VM_AvancarOcioso(uint64_t frames)
+{
+    temporizador_delay = (uint8_t)(frames >= temporizador_delay ? 0 : temporizador_delay - frames);
+    temporizador_som = (uint8_t)(frames >= temporizador_som ? 0 : temporizador_som - frames);
+    if (rastro)
+        rastro->marcar(RASTRO_FRAMES, frames);
 }
 
-void Chip8::rodarSDL(int fps, int scale)
+ResultadoHeadless Chip8::rodarHeadless(int fps, uint64_t max_instrucoes, uint64_t max_frames, int instr_por_frame)
 {
-    rodar_loop_sdl(*this, fps, scale);
+    return rodar_loop_headless(*this, fps, max_instrucoes, max_frames, instr_por_frame);
 }
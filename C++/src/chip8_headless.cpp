@@ -0,0 +1,96 @@
+#include "../lib/chip8.hpp"
+#include "../lib/feixe.hpp"
+#include "../lib/escalonador.hpp"
+#include <chrono>
+
+// Executa a VM sem janela e sem SDL_Delay: o único limite é a velocidade do host.
+// A execução termina ao atingir max_instrucoes ou max_frames (0 = sem limite naquele critério).
+// fps é a mesma velocidade em Hz usada no modo SDL; define quantas instruções cabem em cada
+// frame virtual de 60Hz, momento em que os timers são decrementados (instr_por_frame > 0 fixa
+// esse número).
+ResultadoHeadless rodar_loop_headless(Chip8 &vm, int fps, uint64_t max_instrucoes, uint64_t max_frames, int instr_por_frame)
+{
+    ResultadoHeadless res = {0, 0, 0, 0.0};
+
+    DivisorCiclos ciclos(fps, instr_por_frame);
+
+    auto t_inicio = std::chrono::steady_clock::now();
+
+    while ((max_frames == 0 || res.frames < max_frames) &&
+           (max_instrucoes == 0 || res.instrucoes + res.puladas < max_instrucoes))
+    {
+        // parada em FX0A e sem entrada possível: o resto da execução só decrementa timers
+        if (vm.VM_AguardandoTecla() && max_frames != 0 && max_instrucoes == 0)
+        {
+            uint64_t pular = max_frames - res.frames;
+            vm.VM_AvancarOcioso(pular);
+            res.puladas += ciclos.avancar(pular);
+            res.frames += pular;
+            PERFIL(vm.perfil.frames_pulados += pular;)
+            break;
+        }
+
+        uint32_t a_executar = ciclos.proximo();
+
+        // max_instrucoes limita o tempo virtual: conta também o orçamento não executado
+        if (max_instrucoes != 0 && res.instrucoes + res.puladas + a_executar > max_instrucoes)
+            a_executar = (uint32_t)(max_instrucoes - res.instrucoes - res.puladas);
+
+        uint32_t executadas = vm.VM_Executar(a_executar);
+        res.instrucoes += executadas;
+        res.puladas += a_executar - executadas;
+
+        // sem renderização: apenas consome o pedido de desenho
+        vm.tickTimers();
+        PERFIL(vm.perfil.contar_frame(vm.linhas_sujas != 0);)
+        vm.linhas_sujas = 0;
+        res.frames++;
+    }
+
+    std::chrono::duration<double> dur = std::chrono::steady_clock::now() - t_inicio;
+    res.segundos = dur.count();
+    return res;
+}
+
+// Mesmo laço de frames para um feixe: instrucoes conta as instruções de todas as faixas
+ResultadoHeadless rodar_feixe_headless(FeixeChip8 &feixe, int fps, uint64_t max_instrucoes, uint64_t max_frames, int instr_por_frame)
+{
+    ResultadoHeadless res = {0, 0, 0, 0.0};
+
+    DivisorCiclos ciclos(fps, instr_por_frame);
+    uint64_t por_faixa = 0;
+
+    auto t_inicio = std::chrono::steady_clock::now();
+
+    while ((max_frames == 0 || res.frames < max_frames) &&
+           (max_instrucoes == 0 || por_faixa < max_instrucoes))
+    {
+        uint32_t a_executar = ciclos.proximo();
+
+        if (max_instrucoes != 0 && por_faixa + a_executar > max_instrucoes)
+            a_executar = (uint32_t)(max_instrucoes - por_faixa);
+
+        feixe.VM_Executar(a_executar);
+        por_faixa += a_executar;
+        feixe.tickTimers();
+        res.frames++;
+    }
+
+    std::chrono::duration<double> dur = std::chrono::steady_clock::now() - t_inicio;
+    res.segundos = dur.count();
+    res.instrucoes = por_faixa * FeixeChip8::FAIXAS;
+    return res;
+}
+
+void imprimir_resultado_headless(const ResultadoHeadless &res)
+{
+    double ips = res.segundos > 0.0 ? double(res.instrucoes) / res.segundos : 0.0;
+    double ns_por_inst = res.instrucoes > 0 ? (res.segundos * 1e9) / double(res.instrucoes) : 0.0;
+
+    printf("instrucoes: %llu\n", (unsigned long long)res.instrucoes);
+    printf("puladas:    %llu\n", (unsigned long long)res.puladas);
+    printf("frames:     %llu\n", (unsigned long long)res.frames);
+    printf("tempo:      %.6f s\n", res.segundos);
+    printf("inst/s:     %.0f\n", ips);
+    printf("ns/inst:    %.3f\n", ns_por_inst);
+}
@@ -1,4 +1,106 @@
 #include "../lib/chip8.hpp"
+#include "../lib/sincronizacao.hpp"
+#include "../lib/escalonador.hpp"
+#include "../lib/tela.hpp"
+#include "../lib/gravacao.hpp"
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <thread>
+
+// Quadro publicado pela thread de emulação para a de renderização
+struct QuadroTela
+{
+    uint64_t linhas[ALTURA_TELA];
+    uint64_t alta[PLANOS][ALTURA_ALTA][2]; // perfis SUPER-CHIP/XO-CHIP (linhas fica sem uso)
+};
+
+// Entrada repassada da thread de eventos para a de emulação
+struct EventoEmulacao
+{
+    enum Tipo : uint8_t
+    {
+        TECLA_PRESSIONADA,
+        TECLA_SOLTA,
+        VOLTAR_INICIO, // Backspace pressionado
+        VOLTAR_FIM,
+    } tipo;
+    uint8_t tecla;
+};
+
+// Onda quadrada do buzzer. A thread de emulação só escreve ligado (um store atômico por frame);
+// o callback do SDL lê o flag a cada buffer e gera as amostras na thread de áudio, então o som
+// nunca bloqueia a emulação e a latência fica em um buffer do dispositivo.
+// No XO-CHIP, depois de um F002 o buzzer toca o padrão de 128 bits em vez da onda quadrada; o
+// padrão e a taxa são publicados do mesmo jeito, por stores atômicos a cada frame.
+struct GeradorSom
+{
+    std::atomic<bool> ligado;
+    uint32_t fase;       // posição na onda em 1/2^32 de período
+    uint32_t incremento; // avanço de fase por amostra
+    int16_t amplitude;
+    std::atomic<bool> usar_padrao;
+    std::atomic<uint64_t> padrao[2];            // bit 63 de padrao[0] = primeira amostra
+    std::atomic<uint32_t> incremento_padrao;    // 1/2^32 do padrão inteiro (128 amostras) por amostra
+};
+
+static const int FREQ_AMOSTRAGEM = 44100;
+static const int FREQ_TOM = 440;
+
+static void gerar_onda_quadrada(void *dados, Uint8 *stream, int len)
+{
+    GeradorSom *g = (GeradorSom *)dados;
+    int16_t *amostras = (int16_t *)stream;
+    int n = len / (int)sizeof(int16_t);
+
+    if (!g->ligado.load(std::memory_order_relaxed))
+    {
+        std::memset(stream, 0, len);
+        g->fase = 0; // o próximo tom começa no início do período, sem estalo
+        return;
+    }
+    if (g->usar_padrao.load(std::memory_order_relaxed))
+    {
+        uint64_t padrao[2] = {g->padrao[0].load(std::memory_order_relaxed),
+                              g->padrao[1].load(std::memory_order_relaxed)};
+        uint32_t incremento = g->incremento_padrao.load(std::memory_order_relaxed);
+        for (int i = 0; i < n; ++i)
+        {
+            uint32_t bit = g->fase >> 25; // 0..127
+            bool alto = (padrao[bit >> 6] >> (63 - (bit & 63))) & 1;
+            amostras[i] = alto ? g->amplitude : (int16_t)-g->amplitude;
+            g->fase += incremento;
+        }
+        return;
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        amostras[i] = (g->fase & 0x80000000u) ? (int16_t)-g->amplitude : g->amplitude;
+        g->fase += g->incremento;
+    }
+}
+
+// Publica para o callback de áudio o padrão do XO-CHIP, se a ROM já definiu um
+static void publicar_padrao_som(GeradorSom &som, const Chip8 &vm)
+{
+    uint8_t padrao[16];
+    double taxa_hz;
+    if (!vm.VM_PadraoSom(padrao, taxa_hz))
+    {
+        som.usar_padrao.store(false, std::memory_order_relaxed);
+        return;
+    }
+    for (int m = 0; m < 2; ++m)
+    {
+        uint64_t palavra = 0;
+        for (int b = 0; b < 8; ++b)
+            palavra = (palavra << 8) | padrao[m * 8 + b];
+        som.padrao[m].store(palavra, std::memory_order_relaxed);
+    }
+    // taxa_hz amostras do padrão por segundo; a fase cobre as 128 amostras em 2^32
+    som.incremento_padrao.store((uint32_t)(taxa_hz * (double)(1u << 25) / FREQ_AMOSTRAGEM), std::memory_order_relaxed);
+    som.usar_padrao.store(true, std::memory_order_relaxed);
+}
+
 // Mapeia SDL_Keycode para tecla CHIP-8 (0x0 a 0xF)
 static int mapear_tecla_sdl_para_chip8(SDL_Keycode k)
 {
@@ -41,25 +143,45 @@ static int mapear_tecla_sdl_para_chip8(SDL_Keycode k)
     }
 }
 
-// Atualiza a textura 64x32 a partir do array DISPLAY (formato RGBA8888)
-static void atualizar_textura_de_tela(SDL_Texture *tex, const uint8_t display[])
+// Converte para a textura (RGBA8888) só a faixa de linhas [primeira, última] que contém as linhas
+// sujas. A textura é streaming: travamos apenas essas linhas e escrevemos direto nos pixels dela,
+// sem buffer intermediário nem upload da imagem inteira.
+static void atualizar_textura_de_tela(SDL_Texture *tex, const uint64_t linhas[], uint32_t sujas)
 {
-    const int width = 64, height = 32;
-    uint32_t pixels[width * height];
-    const uint32_t on = 0xFFFFFFFF;  // white
-    const uint32_t off = 0x000000FF; // black
+    int primeira = __builtin_ctz(sujas);
+    int ultima = 31 - __builtin_clz(sujas);
+    SDL_Rect faixa = {0, primeira, LARGURA_TELA, ultima - primeira + 1};
 
-    for (int y = 0; y < height; ++y)
-    {
-        for (int x = 0; x < width; ++x)
-        {
-            pixels[y * width + x] = display[y * width + x] ? on : off;
-        }
-    }
-    SDL_UpdateTexture(tex, NULL, pixels, width * sizeof(uint32_t));
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture(tex, &faixa, &pixels, &pitch) != 0)
+        return;
+    // o conteúdo travado é só escrita: todas as linhas da faixa são regravadas
+    converter_linhas_rgba(pixels, pitch, linhas, primeira, ultima);
+    SDL_UnlockTexture(tex);
+}
+
+// O mesmo para a textura de 128x64 dos perfis estendidos. Com o plano 1 vazio (SUPER-CHIP, e a
+// maioria das ROMs XO-CHIP) a conversão lê só o plano 0.
+static void atualizar_textura_alta(SDL_Texture *tex, const uint64_t planos[PLANOS][ALTURA_ALTA][2], uint64_t sujas)
+{
+    int primeira = __builtin_ctzll(sujas);
+    int ultima = 63 - __builtin_clzll(sujas);
+    SDL_Rect faixa = {0, primeira, LARGURA_ALTA, ultima - primeira + 1};
+
+    uint64_t usado = 0;
+    for (int y = primeira; y <= ultima; ++y)
+        usado |= planos[1][y][0] | planos[1][y][1];
+
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture(tex, &faixa, &pixels, &pitch) != 0)
+        return;
+    converter_linhas_rgba_alta(pixels, pitch, planos[0], usado ? planos[1] : nullptr, primeira, ultima);
+    SDL_UnlockTexture(tex);
 }
 
-void rodar_loop_sdl(Chip8 &vm, int fps, int scale)
+void rodar_loop_sdl(Chip8 &vm, int fps, int scale, const OpcoesSDL &opcoes)
 {
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER) != 0)
     {
@@ -91,22 +213,152 @@ void rodar_loop_sdl(Chip8 &vm, int fps, int scale)
         return;
     }
 
+    // o perfil é fixado ao carregar a ROM: os perfis estendidos desenham sempre em 128x64 (o modo
+    // de baixa resolução deles já grava pixels 2x2), na mesma janela
+    const bool estendida = quirks_estendido(vm.VM_Quirks());
     SDL_Texture *tex = SDL_CreateTexture(renderer,
                                          SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING,
-                                         64, 32);
+                                         estendida ? LARGURA_ALTA : LARGURA_TELA,
+                                         estendida ? ALTURA_ALTA : ALTURA_TELA);
 
-    bool executando = true;
-    SDL_Event event;
+    GeradorSom som;
+    som.ligado = false;
+    som.fase = 0;
+    som.incremento = (uint32_t)((uint64_t(FREQ_TOM) << 32) / FREQ_AMOSTRAGEM);
+    som.amplitude = 3000;
+    som.usar_padrao = false;
+    som.padrao[0] = som.padrao[1] = 0;
+    som.incremento_padrao = 0;
+
+    SDL_AudioDeviceID audio = 0;
+    if (opcoes.amostras_audio > 0)
+    {
+        SDL_AudioSpec pedido, obtido;
+        std::memset(&pedido, 0, sizeof(pedido));
+        pedido.freq = FREQ_AMOSTRAGEM;
+        pedido.format = AUDIO_S16SYS;
+        pedido.channels = 1;
+        pedido.samples = (Uint16)opcoes.amostras_audio;
+        pedido.callback = gerar_onda_quadrada;
+        pedido.userdata = &som;
+        // formato fixo (o SDL converte se preciso); o incremento de fase vale para a freq pedida
+        audio = SDL_OpenAudioDevice(NULL, 0, &pedido, &obtido, SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
+        if (audio == 0)
+            fprintf(stderr, "SDL_OpenAudioDevice erro: %s (seguindo sem som)\n", SDL_GetError());
+        else
+            SDL_PauseAudioDevice(audio, 0);
+    }
+
+    // A emulação roda numa thread própria marcada por um RelogioFrames de 60Hz; esta thread (a da janela,
+    // exigência do SDL) só trata eventos e desenha. As duas trocam dados sem trava: teclas vão
+    // por uma fila SPSC e quadros prontos voltam por um buffer triplo, então um
+    // SDL_RenderPresent lento (vsync, compositor) não atrasa a emulação.
+    std::atomic<bool> executando(true);
+    FilaSPSC<EventoEmulacao, 256> entrada;
+    BufferTriplo<QuadroTela> quadros;
+
+    std::thread emulacao([&]()
+    {
+        bool voltando = false; // Backspace pressionado: rebobina em vez de executar
 
-    const int hz_cpu = fps;                                  // objetivo de instruções por segundo (ajuste 400..800)
-    const double ciclos_por_frame_d = double(hz_cpu) / 60.0; // média de instruções por frame
-    double acumulador_ciclos = 0.0;
-    const uint32_t ms_por_frame = 1000 / 60; // 60Hz
+        // snapshot a cada 2 frames, 600 no anel: até 20 s de rebobinagem
+        AnelEstados historico(600, 2);
 
-    while (executando)
+        DivisorCiclos ciclos(fps, opcoes.instr_por_frame); // fps: instruções por segundo (ajuste 400..800)
+        RelogioFrames relogio(60.0);
+        uint32_t frames_devidos = 1;
+
+        // gravando, a rebobinagem fica desligada: a gravação é uma linha do tempo só
+        std::unique_ptr<GravacaoEntrada> gravacao;
+        if (opcoes.arq_gravacao)
+        {
+            gravacao.reset(new GravacaoEntrada());
+            gravacao->iniciar(vm, fps, opcoes.instr_por_frame);
+        }
+
+        while (executando.load(std::memory_order_relaxed))
+        {
+            EventoEmulacao ev;
+            while (entrada.retirar(ev))
+            {
+                bool pressionada = ev.tipo == EventoEmulacao::TECLA_PRESSIONADA;
+                if (ev.tipo == EventoEmulacao::VOLTAR_INICIO || ev.tipo == EventoEmulacao::VOLTAR_FIM)
+                {
+                    voltando = ev.tipo == EventoEmulacao::VOLTAR_INICIO && !gravacao;
+                }
+                else
+                {
+                    vm.VM_DefinirTecla(ev.tecla, pressionada);
+                    if (gravacao)
+                        gravacao->tecla(ev.tecla, pressionada);
+                }
+            }
+
+            // depois de um engasgo o relógio pede vários frames: todos rodam antes de publicar
+            for (uint32_t f = 0; f < frames_devidos; ++f)
+            {
+                if (voltando)
+                {
+                    // um snapshot por frame; o anel vazio simplesmente congela a imagem
+                    historico.voltar(vm);
+                }
+                else
+                {
+                    vm.VM_Executar(ciclos.proximo());
+
+                    // atualiza timers (uma vez por frame)
+                    vm.tickTimers();
+                    historico.registrar(vm);
+                    if (gravacao)
+                        gravacao->fim_de_frame(vm);
+                }
+            }
+            // frames de recuperação nunca chegam à tela
+            PERFIL(vm.perfil.frames_atrasados += frames_devidos - 1;
+                   vm.perfil.contar_frame(vm.linhas_sujas != 0);)
+
+            // só publica quando alguma linha mudou
+            if (vm.linhas_sujas != 0)
+            {
+                if (estendida)
+                {
+                    std::memcpy(quadros.para_escrever().alta, vm.ext->tela, sizeof(vm.ext->tela));
+                }
+                else
+                {
+                    std::memcpy(quadros.para_escrever().linhas, vm.tela, sizeof(vm.tela));
+                }
+                quadros.publicar();
+                vm.linhas_sujas = 0;
+            }
+
+            // rebobinando fica em silêncio
+            if (estendida)
+                publicar_padrao_som(som, vm);
+            som.ligado.store(!voltando && vm.VM_SomAtivo(), std::memory_order_relaxed);
+
+            frames_devidos = relogio.aguardar();
+        }
+
+        relogio.imprimir_relatorio(stderr);
+        if (gravacao && salvar_gravacao(*gravacao, opcoes.arq_gravacao))
+            fprintf(stderr, "gravação: %llu frames, %zu eventos em %s\n", (unsigned long long)gravacao->frames,
+                    gravacao->eventos.size(), opcoes.arq_gravacao);
+    });
+
+    uint64_t exibidas[ALTURA_TELA]; // linhas que estão na textura
+    std::memset(exibidas, 0, sizeof(exibidas));
+    std::unique_ptr<uint64_t[][ALTURA_ALTA][2]> exibidas_alta; // o mesmo, nos perfis estendidos
+    if (estendida)
     {
-        Uint32 t_inicio = SDL_GetTicks();
+        exibidas_alta.reset(new uint64_t[PLANOS][ALTURA_ALTA][2]);
+        std::memset(exibidas_alta.get(), 0, sizeof(uint64_t) * PLANOS * ALTURA_ALTA * 2);
+    }
+    uint64_t forcar = ~0ull; // linhas a converter mesmo sem mudança (primeiro quadro, janela exposta)
+    SDL_Event event;
 
+    while (executando.load(std::memory_order_relaxed))
+    {
         // events
         while (SDL_PollEvent(&event))
         {
@@ -115,6 +367,8 @@ void rodar_loop_sdl(Chip8 &vm, int fps, int scale)
                 executando = false;
                 break;
             }
+            if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_EXPOSED)
+                forcar = ~0ull; // janela precisa ser redesenhada mesmo sem mudança na tela
             if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP)
             {
                 if (event.key.keysym.scancode == SDL_SCANCODE_ESCAPE)
@@ -122,59 +376,73 @@ void rodar_loop_sdl(Chip8 &vm, int fps, int scale)
                     executando = false;
                     break;
                 }
+                if (event.key.keysym.scancode == SDL_SCANCODE_BACKSPACE)
+                {
+                    EventoEmulacao ev = {event.type == SDL_KEYDOWN ? EventoEmulacao::VOLTAR_INICIO : EventoEmulacao::VOLTAR_FIM, 0};
+                    entrada.inserir(ev);
+                    continue;
+                }
 
                 int mapeado = mapear_tecla_sdl_para_chip8(event.key.keysym.sym);
                 if (mapeado >= 0)
                 {
-                    if (event.type == SDL_KEYDOWN)
-                    {
-                        vm.teclas[mapeado] = 1;
-                        if (vm.aguardando_tecla)
-                        {
-                            vm.registradores[vm.reg_aguardando_tecla] = mapeado;
-                            vm.aguardando_tecla = false;
-                            vm.pc += 2; // avança a instrução FX0A
-                        }
-                    }
-                    else
-                    {
-                        vm.teclas[mapeado] = 0;
-                    }
+                    EventoEmulacao ev = {event.type == SDL_KEYDOWN ? EventoEmulacao::TECLA_PRESSIONADA : EventoEmulacao::TECLA_SOLTA, (uint8_t)mapeado};
+                    entrada.inserir(ev);
                 }
             }
         }
 
-        // calcular quantas instruções executar neste frame (acumulador para fracionário)
-        acumulador_ciclos += ciclos_por_frame_d;
-        int a_executar = (int)acumulador_ciclos;
-        if (a_executar <= 0)
-            a_executar = 1;
-        acumulador_ciclos -= a_executar;
-
-        for (int i = 0; i < a_executar; ++i)
+        // linhas sujas = as que diferem do que já está na textura; quadros pulados não perdem nada
+        uint64_t sujas = estendida ? forcar : (uint32_t)forcar;
+        if (const QuadroTela *q = quadros.ler())
         {
-            vm.VM_ExecutarInstrucao();
+            if (estendida)
+            {
+                for (int p = 0; p < PLANOS; ++p)
+                    for (int y = 0; y < ALTURA_ALTA; ++y)
+                        sujas |= (uint64_t)(q->alta[p][y][0] != exibidas_alta[p][y][0] ||
+                                            q->alta[p][y][1] != exibidas_alta[p][y][1]) << y;
+                std::memcpy(exibidas_alta.get(), q->alta, sizeof(q->alta));
+            }
+            else
+            {
+                for (int y = 0; y < ALTURA_TELA; ++y)
+                    sujas |= (uint64_t)(q->linhas[y] != exibidas[y]) << y;
+                std::memcpy(exibidas, q->linhas, sizeof(exibidas));
+            }
         }
 
-        // atualiza timers e redesenha (uma vez por frame)
-        vm.tickTimers();
-        if (vm.deveDesenhar)
+        // quadro sem linhas alteradas: nada a converter nem a apresentar
+        if (sujas != 0)
         {
-            atualizar_textura_de_tela(tex, vm.tela);
+            if (estendida)
+                atualizar_textura_alta(tex, exibidas_alta.get(), sujas);
+            else
+                atualizar_textura_de_tela(tex, exibidas, (uint32_t)sujas);
             SDL_RenderClear(renderer);
             SDL_Rect dst = {0, 0, largura_janela, altura_janela};
             SDL_RenderCopy(renderer, tex, NULL, &dst);
             SDL_RenderPresent(renderer);
-            vm.deveDesenhar = false;
+            forcar = 0;
+        }
+        else
+        {
+            SDL_Delay(1); // nada novo: não gira em vazio esperando o próximo quadro
         }
-
-        Uint32 duracao = SDL_GetTicks() - t_inicio;
-        if (duracao < ms_por_frame)
-            SDL_Delay(ms_por_frame - duracao);
     }
 
+    emulacao.join();
+
+    if (audio != 0)
+        SDL_CloseAudioDevice(audio);
+
     SDL_DestroyTexture(tex);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
 }
+
+void Chip8::rodarSDL(int fps, int scale, const OpcoesSDL &opcoes)
+{
+    rodar_loop_sdl(*this, fps, scale, opcoes);
+}
@@ -0,0 +1,317 @@
+#include "../lib/diferencial.hpp"
+#include "../lib/escalonador.hpp"
+#include <cstddef>
+
+// Quantas instruções antes da divergência entram no rastro
+static const size_t TAM_RASTRO = 16;
+
+bool ler_backend_diferencial(const char *nome, BackendDiferencial &b)
+{
+    std::string n = nome;
+    if (n == "interp")
+        b = BACKEND_INTERPRETADOR;
+    else if (n == "jit")
+        b = BACKEND_JIT;
+    else if (n == "feixe")
+        b = BACKEND_FEIXE;
+    else
+        return false;
+    return true;
+}
+
+const char *nome_backend_diferencial(BackendDiferencial b)
+{
+    switch (b)
+    {
+    case BACKEND_JIT:
+        return "jit";
+    case BACKEND_FEIXE:
+        return "feixe";
+    default:
+        return "interp";
+    }
+}
+
+// Um lado da comparação: um Chip8 (interpretador ou JIT) ou um feixe
+class LadoDiferencial
+{
+public:
+    LadoDiferencial(BackendDiferencial tipo, const EstadoChip8 &inicial) : tipo(tipo), vm(new Chip8())
+    {
+        vm->VM_RestaurarEstado(inicial);
+        if (tipo == BACKEND_JIT)
+            vm->VM_AtivarJIT();
+        if (tipo == BACKEND_FEIXE)
+        {
+            feixe.reset(new FeixeChip8());
+            feixe->VM_Iniciar(*vm);
+        }
+    }
+
+    void tecla(uint8_t tecla, bool pressionada)
+    {
+        if (!feixe)
+        {
+            vm->VM_DefinirTecla(tecla, pressionada);
+            return;
+        }
+        for (int f = 0; f < FeixeChip8::FAIXAS; ++f)
+            feixe->VM_DefinirTecla(f, tecla, pressionada);
+    }
+
+    // Instruções executadas das n (o feixe executa todas: não pula laços ociosos)
+    uint32_t executar(uint32_t n)
+    {
+        if (!feixe)
+            return vm->VM_Executar(n);
+        feixe->VM_Executar(n);
+        return n;
+    }
+
+    void tick()
+    {
+        if (feixe)
+            feixe->tickTimers();
+        else
+            vm->tickTimers();
+    }
+
+    void salvar(EstadoChip8 &e)
+    {
+        if (feixe)
+            feixe->VM_ExportarFaixa(0, *vm);
+        vm->VM_SalvarEstado(e);
+    }
+
+private:
+    BackendDiferencial tipo;
+    std::unique_ptr<Chip8> vm;
+    std::unique_ptr<FeixeChip8> feixe;
+};
+
+// Estado dos dois lados depois de k instruções a partir de inicio; true se diferem
+static bool comparar_apos(const EstadoChip8 &inicio, const ConfigDiferencial &cfg, uint32_t k, EstadoChip8 &ea,
+                          EstadoChip8 &eb)
+{
+    LadoDiferencial a(cfg.a, inicio), b(cfg.b, inicio);
+    a.executar(k);
+    b.executar(k);
+    a.salvar(ea);
+    b.salvar(eb);
+    return !estados_iguais(ea, eb);
+}
+
+// Refaz o frame dos dois lados a partir de inicio e devolve a primeira contagem de instruções
+// (até n) cujo estado diverge, 0 se as n instruções conferem. Sem JIT os dois lados avançam
+// juntos uma instrução por vez. O JIT só roda um bloco que caiba inteiro no orçamento, então
+// passo a passo ele seria o interpretador: o estado dele depois de k instruções só existe
+// refazendo o frame com orçamento k, e a busca é binária (a divergência do frame inteiro se
+// mantém até o fim dele).
+static uint32_t localizar_instrucao(const EstadoChip8 &inicio, const ConfigDiferencial &cfg, uint32_t n,
+                                    ResultadoDiferencial &res)
+{
+    std::unique_ptr<EstadoChip8> ea(new EstadoChip8()), eb(new EstadoChip8());
+    uint32_t k = 0;
+    if (cfg.a != BACKEND_JIT && cfg.b != BACKEND_JIT)
+    {
+        LadoDiferencial a(cfg.a, inicio), b(cfg.b, inicio);
+        for (uint32_t i = 1; i <= n && !k; ++i)
+        {
+            a.executar(1);
+            b.executar(1);
+            a.salvar(*ea);
+            b.salvar(*eb);
+            if (!estados_iguais(*ea, *eb))
+                k = i;
+        }
+    }
+    else if (comparar_apos(inicio, cfg, n, *ea, *eb))
+    {
+        uint32_t baixo = 1, alto = n; // alto sempre diverge
+        while (baixo < alto)
+        {
+            uint32_t meio = baixo + (alto - baixo) / 2;
+            if (comparar_apos(inicio, cfg, meio, *ea, *eb))
+                alto = meio;
+            else
+                baixo = meio + 1;
+        }
+        k = alto;
+        comparar_apos(inicio, cfg, k, *ea, *eb);
+    }
+    if (k)
+    {
+        res.estado_a = std::move(ea);
+        res.estado_b = std::move(eb);
+    }
+    return k;
+}
+
+// pc e opcode das primeiras k instruções a partir de inicio, pelo interpretador de referência
+static void montar_rastro(const EstadoChip8 &inicio, uint32_t k, ResultadoDiferencial &res)
+{
+    LadoDiferencial ref(BACKEND_INTERPRETADOR, inicio);
+    std::unique_ptr<EstadoChip8> e(new EstadoChip8());
+    res.rastro.clear();
+    for (uint32_t i = 0; i < k; ++i)
+    {
+        ref.salvar(*e);
+        // 64 KB no XO-CHIP, 4 KB nos demais: o pc dá a volta no fim da memória do perfil
+        uint32_t mascara = (uint32_t)(tamanho_estado(*e) - offsetof(EstadoChip8, memoria)) - 1;
+        uint16_t pc = (uint16_t)(e->pc & mascara);
+        uint16_t op = (uint16_t)(e->memoria[pc] << 8 | e->memoria[(pc + 1) & mascara]);
+        res.rastro.push_back(std::make_pair(pc, op));
+        if (res.rastro.size() > TAM_RASTRO)
+            res.rastro.erase(res.rastro.begin());
+        ref.executar(1);
+    }
+}
+
+void executar_diferencial(const EstadoChip8 &inicial, const ConfigDiferencial &cfg, ResultadoDiferencial &res)
+{
+    res.divergiu = false;
+    res.frames = 0;
+    res.instrucoes = 0;
+    res.puladas_a = 0;
+    res.puladas_b = 0;
+    res.frame = 0;
+    res.instrucao = 0;
+    res.rastro.clear();
+
+    LadoDiferencial a(cfg.a, inicial), b(cfg.b, inicial);
+    std::unique_ptr<EstadoChip8> inicio(new EstadoChip8(inicial));
+    std::unique_ptr<EstadoChip8> ea(new EstadoChip8()), eb(new EstadoChip8());
+    DivisorCiclos ciclos(cfg.hz, cfg.instr_por_frame);
+    size_t prox_evento = 0;
+
+    for (uint64_t frame = 0; frame < cfg.frames; ++frame)
+    {
+        while (prox_evento < cfg.eventos.size() && cfg.eventos[prox_evento].frame <= frame)
+        {
+            const EventoTecla &ev = cfg.eventos[prox_evento++];
+            a.tecla(ev.tecla, ev.pressionada);
+            b.tecla(ev.tecla, ev.pressionada);
+        }
+        a.salvar(*inicio); // snapshot do início do frame, já com as teclas
+
+        uint32_t n = ciclos.proximo();
+        uint32_t divergente = 0;
+        if (cfg.por_instrucao)
+        {
+            for (uint32_t k = 1; k <= n && !divergente; ++k)
+            {
+                res.puladas_a += 1 - a.executar(1);
+                res.puladas_b += 1 - b.executar(1);
+                a.salvar(*ea);
+                b.salvar(*eb);
+                if (!estados_iguais(*ea, *eb))
+                    divergente = k;
+            }
+        }
+        else
+        {
+            res.puladas_a += n - a.executar(n);
+            res.puladas_b += n - b.executar(n);
+            a.salvar(*ea);
+            b.salvar(*eb);
+            if (!estados_iguais(*ea, *eb))
+            {
+                divergente = localizar_instrucao(*inicio, cfg, n, res);
+                if (!divergente)
+                    divergente = n; // não reproduziu ao refazer: fica o estado do frame inteiro
+            }
+        }
+
+        res.frames = frame + 1;
+        res.instrucoes += divergente ? divergente : n;
+        if (divergente)
+        {
+            res.divergiu = true;
+            res.frame = frame;
+            res.instrucao = divergente;
+            if (!res.estado_a)
+            {
+                res.estado_a = std::move(ea);
+                res.estado_b = std::move(eb);
+            }
+            montar_rastro(*inicio, divergente, res);
+            return;
+        }
+
+        a.tick();
+        b.tick();
+        a.salvar(*ea);
+        b.salvar(*eb);
+        if (!estados_iguais(*ea, *eb))
+        {
+            // as instruções conferiram e só os timers diferem
+            res.divergiu = true;
+            res.frame = frame;
+            res.instrucao = 0;
+            res.estado_a = std::move(ea);
+            res.estado_b = std::move(eb);
+            return;
+        }
+    }
+}
+
+static void imprimir_estado(FILE *saida, const char *nome, const EstadoChip8 &e)
+{
+    fprintf(saida, "  %-6s pc=%03X I=%03X sp=%X dt=%02X st=%02X tela=%016llx V=", nome, e.pc, e.indiceI,
+            e.ponteiro_pilha, e.temporizador_delay, e.temporizador_som, (unsigned long long)hash_tela_estado(e));
+    for (int r = 0; r < 16; ++r)
+        fprintf(saida, "%02X", e.registradores[r]);
+    fprintf(saida, " pilha=");
+    for (int i = 0; i < e.ponteiro_pilha && i < 16; ++i)
+        fprintf(saida, "%s%03X", i ? "," : "", e.pilha[i]);
+    fprintf(saida, "\n");
+}
+
+void imprimir_resultado_diferencial(FILE *saida, const ConfigDiferencial &cfg, const ResultadoDiferencial &res)
+{
+    const char *na = nome_backend_diferencial(cfg.a);
+    const char *nb = nome_backend_diferencial(cfg.b);
+    if (!res.divergiu)
+    {
+        fprintf(saida, "%s e %s idênticos: %llu frames, %llu instruções (puladas: %llu no %s, %llu no %s)\n", na,
+                nb, (unsigned long long)res.frames, (unsigned long long)res.instrucoes,
+                (unsigned long long)res.puladas_a, na, (unsigned long long)res.puladas_b, nb);
+        return;
+    }
+
+    if (res.instrucao)
+        fprintf(saida, "DIVERGÊNCIA no frame %llu, após a instrução %u do frame (%llu no total)\n",
+                (unsigned long long)res.frame, res.instrucao, (unsigned long long)res.instrucoes);
+    else
+        fprintf(saida, "DIVERGÊNCIA no frame %llu, nos timers do fim do frame\n", (unsigned long long)res.frame);
+
+    if (!res.rastro.empty())
+    {
+        fprintf(saida, "rastro (%s):\n", na);
+        for (size_t i = 0; i < res.rastro.size(); ++i)
+            fprintf(saida, "  %s%03X: %04X\n", i + 1 == res.rastro.size() ? "> " : "  ", res.rastro[i].first,
+                    res.rastro[i].second);
+    }
+
+    const EstadoChip8 &a = *res.estado_a;
+    const EstadoChip8 &b = *res.estado_b;
+    imprimir_estado(saida, na, a);
+    imprimir_estado(saida, nb, b);
+    int impressos = 0;
+    int tam_memoria = (int)(tamanho_estado(a) - offsetof(EstadoChip8, memoria));
+    for (int end = 0; end < tam_memoria; ++end)
+    {
+        if (a.memoria[end] == b.memoria[end])
+            continue;
+        if (impressos++ == 8)
+        {
+            fprintf(saida, "  ...\n");
+            break;
+        }
+        fprintf(saida, "  memoria[%04X]: %02X x %02X\n", end, a.memoria[end], b.memoria[end]);
+    }
+    if (a.estado_rng != b.estado_rng || a.aguardando_tecla != b.aguardando_tecla || a.teclas != b.teclas)
+        fprintf(saida, "  rng %016llx x %016llx, aguardando %u x %u, teclas %04X x %04X\n",
+                (unsigned long long)a.estado_rng, (unsigned long long)b.estado_rng, a.aguardando_tecla,
+                b.aguardando_tecla, a.teclas, b.teclas);
+}
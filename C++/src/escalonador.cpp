@@ -0,0 +1,78 @@
+#include "../lib/escalonador.hpp"
+#include <thread>
+
+// Margem antes do prazo em que paramos de dormir e passamos a girar. Cobre a granularidade
+// típica do sleep (1 ms no Linux com folga do escalonador, até ~2 ms no Windows).
+static const std::chrono::microseconds MARGEM_GIRO(2000);
+
+RelogioFrames::RelogioFrames(double hz_alvo, uint32_t max_atraso)
+    : alvo(hz_alvo > 0.0 ? hz_alvo : 60.0), max_atraso(max_atraso > 0 ? max_atraso : 1)
+{
+    iniciar();
+}
+
+void RelogioFrames::iniciar()
+{
+    inicio = Relogio::now();
+    t_iniciar = inicio;
+    proximo = 1;
+    n_frames = 0;
+    n_recuperados = 0;
+    n_descartados = 0;
+}
+
+RelogioFrames::Relogio::time_point RelogioFrames::prazo(uint64_t frame) const
+{
+    return inicio + std::chrono::duration_cast<Relogio::duration>(std::chrono::duration<double>(double(frame) / alvo));
+}
+
+uint32_t RelogioFrames::aguardar()
+{
+    Relogio::time_point p = prazo(proximo);
+    Relogio::time_point agora = Relogio::now();
+
+    if (agora < p)
+    {
+        if (p - agora > MARGEM_GIRO)
+            std::this_thread::sleep_until(p - MARGEM_GIRO);
+        while (Relogio::now() < p)
+            std::this_thread::yield();
+        ++proximo;
+        ++n_frames;
+        return 1;
+    }
+
+    // atrasado: quantos prazos já passaram (inclusive o atual)
+    uint64_t devidos = 1;
+    while (devidos < max_atraso && prazo(proximo + devidos) <= agora)
+        ++devidos;
+
+    if (prazo(proximo + devidos) <= agora)
+    {
+        // mais atrasado do que vale recuperar: esquece o resto e recomeça a contagem daqui
+        uint64_t perdidos = (uint64_t)(std::chrono::duration<double>(agora - p).count() * alvo) + 1 - devidos;
+        n_descartados += perdidos;
+        inicio = agora;
+        proximo = 1;
+    }
+    else
+    {
+        proximo += devidos;
+    }
+    n_recuperados += devidos - 1;
+    n_frames += devidos;
+    return (uint32_t)devidos;
+}
+
+double RelogioFrames::hz_alcancado() const
+{
+    double s = std::chrono::duration<double>(Relogio::now() - t_iniciar).count();
+    return s > 0.0 ? double(n_frames) / s : 0.0;
+}
+
+void RelogioFrames::imprimir_relatorio(FILE *saida) const
+{
+    fprintf(saida, "frames: %llu a %.3f Hz (alvo %.3f Hz), %llu recuperados, %llu descartados\n",
+            (unsigned long long)n_frames, hz_alcancado(), alvo,
+            (unsigned long long)n_recuperados, (unsigned long long)n_descartados);
+}
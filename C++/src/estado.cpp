@@ -0,0 +1,155 @@
+#include "../lib/estado.hpp"
+#include "../lib/chip8.hpp"
+#include "../lib/tela.hpp"
+
+static_assert(sizeof(EstadoChip8) == 67952, "layout do savestate mudou: incremente VERSAO_ESTADO");
+static_assert(offsetof(EstadoChip8, alta_resolucao) == 330, "campos da versão 1 mudaram de lugar");
+
+// Versão 1: os mesmos campos até reg_aguardando_tecla e quirks, 6 bytes reservados e 4 KB de memória
+static const size_t TAM_ESTADO_V1 = 4432;
+static const size_t INICIO_MEMORIA_V1 = 336;
+
+size_t tamanho_estado(const EstadoChip8 &e)
+{
+    return offsetof(EstadoChip8, memoria) + (e.quirks == QUIRKS_XOCHIP ? sizeof(e.memoria) : 0x1000);
+}
+
+bool estados_iguais(const EstadoChip8 &a, const EstadoChip8 &b)
+{
+    size_t tam = tamanho_estado(a);
+    return tam == tamanho_estado(b) && std::memcmp(&a, &b, tam) == 0;
+}
+
+uint64_t hash_tela_estado(const EstadoChip8 &e)
+{
+    if (quirks_estendido((Quirks)e.quirks))
+        return hash_tela(&e.tela_alta[0][0][0], sizeof(e.tela_alta) / sizeof(uint64_t));
+    return hash_tela(e.tela, 32);
+}
+
+bool escrever_estado(FILE *f, const EstadoChip8 &e)
+{
+    return fwrite(&e, tamanho_estado(e), 1, f) == 1;
+}
+
+bool ler_estado(FILE *f, EstadoChip8 &e)
+{
+    uint8_t *bytes = (uint8_t *)&e;
+    size_t lidos = offsetof(EstadoChip8, pc);
+    if (fread(bytes, lidos, 1, f) != 1 || e.magica != MAGICA_ESTADO)
+        return false;
+
+    if (e.versao == 1)
+    {
+        std::vector<uint8_t> v1(TAM_ESTADO_V1);
+        std::memcpy(v1.data(), bytes, lidos);
+        if (fread(v1.data() + lidos, TAM_ESTADO_V1 - lidos, 1, f) != 1)
+            return false;
+        std::memset(bytes, 0, sizeof(EstadoChip8));
+        std::memcpy(bytes, v1.data(), offsetof(EstadoChip8, alta_resolucao));
+        std::memcpy(e.memoria, v1.data() + INICIO_MEMORIA_V1, 0x1000);
+        e.versao = VERSAO_ESTADO;
+        if (e.quirks >= QUIRKS_TOTAL || quirks_estendido((Quirks)e.quirks))
+            e.quirks = QUIRKS_MODERNO;
+        return true;
+    }
+    if (e.versao != VERSAO_ESTADO)
+        return false;
+
+    size_t prefixo = offsetof(EstadoChip8, memoria) + 0x1000;
+    if (fread(bytes + lidos, prefixo - lidos, 1, f) != 1)
+        return false;
+    size_t resto = tamanho_estado(e) - prefixo;
+    if (resto)
+        return fread(bytes + prefixo, resto, 1, f) == 1;
+    std::memset(bytes + prefixo, 0, sizeof(EstadoChip8) - prefixo);
+    return true;
+}
+
+bool salvar_estado_arquivo(const EstadoChip8 &estado, const char *arquivo)
+{
+    FILE *f = fopen(arquivo, "wb");
+    if (!f)
+    {
+        perror(arquivo);
+        return false;
+    }
+    bool ok = escrever_estado(f, estado);
+    ok = (fclose(f) == 0) && ok;
+    if (!ok)
+        fprintf(stderr, "%s: erro de escrita\n", arquivo);
+    return ok;
+}
+
+bool carregar_estado_arquivo(EstadoChip8 &estado, const char *arquivo)
+{
+    FILE *f = fopen(arquivo, "rb");
+    if (!f)
+    {
+        perror(arquivo);
+        return false;
+    }
+    bool ok = ler_estado(f, estado);
+    fclose(f);
+    if (!ok)
+    {
+        fprintf(stderr, "%s: não é um savestate CHIP-8 versão %u\n", arquivo, VERSAO_ESTADO);
+        return false;
+    }
+    return true;
+}
+
+AnelEstados::AnelEstados(size_t capacidade, uint32_t intervalo_frames)
+    : temporario(new EstadoChip8()), capacidade(capacidade > 0 ? capacidade : 1),
+      tam_posicao(offsetof(EstadoChip8, memoria) + 0x1000), inicio(0), n(0),
+      intervalo(intervalo_frames > 0 ? intervalo_frames : 1), frames_desde_ultimo(0)
+{
+    dados.resize(this->capacidade * tam_posicao);
+}
+
+void AnelEstados::registrar(const Chip8 &vm)
+{
+    if (++frames_desde_ultimo < intervalo)
+        return;
+    frames_desde_ultimo = 0;
+
+    vm.VM_SalvarEstado(*temporario);
+    size_t tam = tamanho_estado(*temporario);
+    if (tam > tam_posicao)
+    {
+        tam_posicao = tam;
+        dados.assign(capacidade * tam_posicao, 0);
+        limpar();
+    }
+
+    if (n == capacidade)
+    {
+        // cheio: o novo ocupa o lugar do mais antigo
+        std::memcpy(&dados[inicio * tam_posicao], temporario.get(), tam);
+        inicio = (inicio + 1) % capacidade;
+        return;
+    }
+    std::memcpy(&dados[((inicio + n) % capacidade) * tam_posicao], temporario.get(), tam);
+    ++n;
+}
+
+bool AnelEstados::voltar(Chip8 &vm)
+{
+    if (n == 0)
+        return false;
+    --n;
+    const uint8_t *posicao = &dados[((inicio + n) % capacidade) * tam_posicao];
+    // o cabeçalho diz quantos bytes o snapshot tem
+    std::memcpy(temporario.get(), posicao, offsetof(EstadoChip8, memoria));
+    std::memcpy(temporario.get(), posicao, tamanho_estado(*temporario));
+    vm.VM_RestaurarEstado(*temporario);
+    frames_desde_ultimo = 0;
+    return true;
+}
+
+void AnelEstados::limpar()
+{
+    inicio = 0;
+    n = 0;
+    frames_desde_ultimo = 0;
+}
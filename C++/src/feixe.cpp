@@ -0,0 +1,527 @@
+#include "../lib/feixe.hpp"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Os laços de faixa abaixo têm número fixo de iterações e nenhum desvio no corpo: o resultado é
+// calculado para todas as faixas e mesclado com a máscara (0xFF = faixa participa). Assim o
+// compilador os transforma em SSE2 no build padrão e em AVX2 nas versões clonadas abaixo.
+// Os ponteiros dos auxiliares são __restrict: sem isso o -O2 não vetoriza (exigiria teste de
+// sobreposição em tempo de execução), e quem chama nunca passa a mesma linha duas vezes.
+static const int F = FeixeChip8::FAIXAS;
+
+// Versões AVX2 e padrão das funções com laços de faixa, escolhidas em tempo de carga pela CPU
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define CLONES_SIMD __attribute__((target_clones("avx2", "default")))
+#else
+#define CLONES_SIMD
+#endif
+
+static inline void mesclar8(uint8_t *__restrict dst, const uint8_t *__restrict novo, const uint8_t *__restrict m)
+{
+    for (int f = 0; f < F; ++f)
+        dst[f] = (uint8_t)((novo[f] & m[f]) | (dst[f] & ~m[f]));
+}
+
+static inline void mesclar16(uint16_t *__restrict dst, const uint16_t *__restrict novo, const uint8_t *__restrict m)
+{
+    for (int f = 0; f < F; ++f)
+    {
+        uint16_t m16 = (uint16_t)(int16_t)(int8_t)m[f];
+        dst[f] = (uint16_t)((novo[f] & m16) | (dst[f] & ~m16));
+    }
+}
+
+// pc += passo nas faixas da máscara
+static inline void avancar(uint16_t *__restrict pc, const uint8_t *__restrict m, uint16_t passo)
+{
+    for (int f = 0; f < F; ++f)
+        pc[f] = (uint16_t)(pc[f] + (passo & (uint16_t)(int16_t)(int8_t)m[f]));
+}
+
+// pc += 4 onde cond[f] != 0, senão pc += 2 (nas faixas da máscara)
+static inline void pular_se(uint16_t *__restrict pc, const uint8_t *__restrict cond, const uint8_t *__restrict m)
+{
+    for (int f = 0; f < F; ++f)
+    {
+        uint16_t passo = (uint16_t)(2 + ((cond[f] & 1) << 1));
+        pc[f] = (uint16_t)(pc[f] + (passo & (uint16_t)(int16_t)(int8_t)m[f]));
+    }
+}
+
+// Bit f = faixa f da máscara (m[f] é 0 ou 0xFF)
+static inline uint32_t bits_mascara(const uint8_t *m)
+{
+#if defined(__SSE2__)
+    __m128i a = _mm_loadu_si128((const __m128i *)m);
+    __m128i b = _mm_loadu_si128((const __m128i *)(m + 16));
+    return (uint32_t)_mm_movemask_epi8(a) | ((uint32_t)_mm_movemask_epi8(b) << 16);
+#else
+    uint32_t bits = 0;
+    for (int f = 0; f < F; ++f)
+        bits |= (uint32_t)(m[f] & 1) << f;
+    return bits;
+#endif
+}
+
+FeixeChip8::FeixeChip8()
+{
+    Chip8 *vazio = new Chip8();
+    VM_Iniciar(*vazio);
+    delete vazio;
+}
+
+void FeixeChip8::VM_Iniciar(const Chip8 &modelo)
+{
+    for (int f = 0; f < F; ++f)
+    {
+        for (int r = 0; r < 16; ++r)
+        {
+            registradores[r][f] = modelo.registradores[r];
+            pilha[r][f] = modelo.pilha[r];
+        }
+        pc[f] = modelo.pc;
+        indiceI[f] = modelo.indiceI;
+        temporizador_delay[f] = modelo.temporizador_delay;
+        temporizador_som[f] = modelo.temporizador_som;
+        ponteiro_pilha[f] = modelo.ponteiro_pilha;
+        ativa[f] = modelo.aguardando_tecla ? 0 : 0xFF;
+        reg_aguardando_tecla[f] = modelo.reg_aguardando_tecla;
+        estado_rng[f] = modelo.estado_rng;
+        teclas[f] = modelo.teclas;
+        std::memcpy(tela[f], modelo.tela, sizeof(tela[f]));
+        std::memcpy(memoria[f], modelo.memoria, sizeof(memoria[f]));
+    }
+    std::memset(cache_decod, 0, sizeof(cache_decod));
+    std::memset(pode_diferir, 0, sizeof(pode_diferir));
+    n_uniformes = 0;
+    n_divergentes = 0;
+}
+
+void FeixeChip8::VM_ExportarFaixa(int faixa, Chip8 &destino) const
+{
+    for (int r = 0; r < 16; ++r)
+    {
+        destino.registradores[r] = registradores[r][faixa];
+        destino.pilha[r] = pilha[r][faixa];
+    }
+    destino.teclas = teclas[faixa];
+    destino.pc = pc[faixa];
+    destino.indiceI = indiceI[faixa];
+    destino.temporizador_delay = temporizador_delay[faixa];
+    destino.temporizador_som = temporizador_som[faixa];
+    destino.ponteiro_pilha = ponteiro_pilha[faixa];
+    destino.aguardando_tecla = !ativa[faixa];
+    destino.reg_aguardando_tecla = reg_aguardando_tecla[faixa];
+    destino.estado_rng = estado_rng[faixa];
+    std::memcpy(destino.tela, tela[faixa], sizeof(destino.tela));
+    std::memcpy(destino.memoria_propria(), memoria[faixa], TAM_MEMORIA);
+    destino.invalidar_cache_decod();
+}
+
+void FeixeChip8::VM_DefinirSemente(int faixa, uint64_t semente)
+{
+    estado_rng[faixa] = pcg32_semear(semente);
+}
+
+// Mesma semântica de Chip8::VM_DefinirTecla, na faixa indicada
+void FeixeChip8::VM_DefinirTecla(int faixa, uint8_t tecla, bool pressionada)
+{
+    tecla &= 0xF;
+    if (pressionada)
+        teclas[faixa] |= (uint16_t)(1u << tecla);
+    else
+        teclas[faixa] &= (uint16_t)~(1u << tecla);
+    if (pressionada && !ativa[faixa])
+    {
+        registradores[reg_aguardando_tecla[faixa]][faixa] = tecla;
+        ativa[faixa] = 0xFF;
+        pc[faixa] += 2; // avança a instrução FX0A
+    }
+}
+
+void FeixeChip8::tickTimers()
+{
+    for (int f = 0; f < F; ++f)
+    {
+        temporizador_delay[f] -= temporizador_delay[f] > 0;
+        temporizador_som[f] -= temporizador_som[f] > 0;
+    }
+}
+
+uint64_t FeixeChip8::VM_HashTela(int faixa) const
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int y = 0; y < ALTURA_TELA; ++y)
+    {
+        for (int b = 56; b >= 0; b -= 8)
+        {
+            h ^= (tela[faixa][y] >> b) & 0xFF;
+            h *= 0x100000001b3ULL;
+        }
+    }
+    return h;
+}
+
+void FeixeChip8::escrever_memoria(int faixa, uint16_t endereco, uint8_t valor)
+{
+    endereco &= 0x0FFF;
+    memoria[faixa][endereco] = valor;
+    pode_diferir[endereco] = true;
+    cache_decod[endereco].op = OP_NAO_DECODIFICADA;
+    cache_decod[(endereco - 1) & 0x0FFF].op = OP_NAO_DECODIFICADA;
+}
+
+// true se todas as faixas da máscara têm em endereco a mesma instrução da faixa 0
+bool FeixeChip8::mesma_instrucao(uint16_t endereco, const uint8_t *mascara) const
+{
+    uint16_t a = endereco & 0x0FFF, b = (endereco + 1) & 0x0FFF;
+    if (!pode_diferir[a] && !pode_diferir[b])
+        return true;
+    for (int f = 0; f < F; ++f)
+    {
+        if (mascara[f] && (memoria[f][a] != memoria[0][a] || memoria[f][b] != memoria[0][b]))
+            return false;
+    }
+    return true;
+}
+
+// Executa uma faixa com a instrução da sua própria memória (quando ela difere da faixa 0)
+void FeixeChip8::executar_faixa(int faixa)
+{
+    uint8_t mascara[F] = {};
+    mascara[faixa] = 0xFF;
+    uint16_t end = pc[faixa] & 0x0FFF;
+    Decodificada d = Chip8::decodificar((memoria[faixa][end] << 8) | memoria[faixa][(end + 1) & 0x0FFF]);
+    executar_grupo(d, mascara);
+}
+
+// Aplica a instrução d às faixas da máscara. Cada caso segue o manipulador op_* equivalente de
+// Chip8, inclusive a ordem de escrita de VF e Vx quando x == F.
+CLONES_SIMD
+void FeixeChip8::executar_grupo(const Decodificada &d, const uint8_t *m)
+{
+    uint8_t *vx = registradores[d.x];
+    const uint8_t *vy = registradores[d.y];
+    uint8_t *vf = registradores[0xF];
+    alignas(64) uint8_t t[F];
+    alignas(64) uint16_t t16[F];
+
+    switch (d.op)
+    {
+    case OP_CLS:
+        for (int f = 0; f < F; ++f)
+            if (m[f])
+                std::memset(tela[f], 0, sizeof(tela[f]));
+        avancar(pc, m, 2);
+        break;
+    case OP_RET:
+        for (int f = 0; f < F; ++f)
+        {
+            if (!m[f])
+                continue;
+            if (ponteiro_pilha[f] > 0)
+                pc[f] = pilha[--ponteiro_pilha[f]][f];
+            else
+                pc[f] += 2;
+        }
+        break;
+    case OP_JP:
+        for (int f = 0; f < F; ++f)
+            t16[f] = d.nnn;
+        mesclar16(pc, t16, m);
+        break;
+    case OP_CALL:
+        for (int f = 0; f < F; ++f)
+        {
+            if (!m[f])
+                continue;
+            pilha[ponteiro_pilha[f]][f] = pc[f] + 2;
+            ponteiro_pilha[f] = (ponteiro_pilha[f] + 1) & 0x0F;
+            pc[f] = d.nnn;
+        }
+        break;
+    case OP_SE_BYTE:
+        for (int f = 0; f < F; ++f)
+            t[f] = vx[f] == d.nn;
+        pular_se(pc, t, m);
+        break;
+    case OP_SNE_BYTE:
+        for (int f = 0; f < F; ++f)
+            t[f] = vx[f] != d.nn;
+        pular_se(pc, t, m);
+        break;
+    case OP_SE_REG:
+        for (int f = 0; f < F; ++f)
+            t[f] = vx[f] == vy[f];
+        pular_se(pc, t, m);
+        break;
+    case OP_SNE_REG:
+        for (int f = 0; f < F; ++f)
+            t[f] = vx[f] != vy[f];
+        pular_se(pc, t, m);
+        break;
+    case OP_LD_BYTE:
+        for (int f = 0; f < F; ++f)
+            t[f] = d.nn;
+        mesclar8(vx, t, m);
+        avancar(pc, m, 2);
+        break;
+    case OP_ADD_BYTE:
+        for (int f = 0; f < F; ++f)
+            t[f] = (uint8_t)(vx[f] + d.nn);
+        mesclar8(vx, t, m);
+        avancar(pc, m, 2);
+        break;
+    case OP_LD_REG:
+        std::memcpy(t, vy, sizeof(t)); // x pode ser igual a y
+        mesclar8(vx, t, m);
+        avancar(pc, m, 2);
+        break;
+    case OP_OR:
+        for (int f = 0; f < F; ++f)
+            t[f] = vx[f] | vy[f];
+        mesclar8(vx, t, m);
+        avancar(pc, m, 2);
+        break;
+    case OP_AND:
+        for (int f = 0; f < F; ++f)
+            t[f] = vx[f] & vy[f];
+        mesclar8(vx, t, m);
+        avancar(pc, m, 2);
+        break;
+    case OP_XOR:
+        for (int f = 0; f < F; ++f)
+            t[f] = vx[f] ^ vy[f];
+        mesclar8(vx, t, m);
+        avancar(pc, m, 2);
+        break;
+    case OP_ADD_REG:
+    {
+        alignas(64) uint8_t soma[F];
+        for (int f = 0; f < F; ++f)
+        {
+            soma[f] = (uint8_t)(vx[f] + vy[f]);
+            t[f] = soma[f] < vx[f];
+        }
+        mesclar8(vf, t, m);
+        mesclar8(vx, soma, m);
+        avancar(pc, m, 2);
+        break;
+    }
+    case OP_SUB:
+        for (int f = 0; f < F; ++f)
+            t[f] = vx[f] > vy[f];
+        mesclar8(vf, t, m);
+        for (int f = 0; f < F; ++f)
+            t[f] = (uint8_t)(vx[f] - vy[f]);
+        mesclar8(vx, t, m);
+        avancar(pc, m, 2);
+        break;
+    case OP_SUBN:
+        for (int f = 0; f < F; ++f)
+            t[f] = vy[f] > vx[f];
+        mesclar8(vf, t, m);
+        for (int f = 0; f < F; ++f)
+            t[f] = (uint8_t)(vy[f] - vx[f]);
+        mesclar8(vx, t, m);
+        avancar(pc, m, 2);
+        break;
+    case OP_SHR:
+        for (int f = 0; f < F; ++f)
+            t[f] = vx[f] & 0x1;
+        mesclar8(vf, t, m);
+        for (int f = 0; f < F; ++f)
+            t[f] = vx[f] >> 1;
+        mesclar8(vx, t, m);
+        avancar(pc, m, 2);
+        break;
+    case OP_SHL:
+        for (int f = 0; f < F; ++f)
+            t[f] = vx[f] >> 7;
+        mesclar8(vf, t, m);
+        for (int f = 0; f < F; ++f)
+            t[f] = (uint8_t)(vx[f] << 1);
+        mesclar8(vx, t, m);
+        avancar(pc, m, 2);
+        break;
+    case OP_LD_I:
+        for (int f = 0; f < F; ++f)
+            t16[f] = d.nnn;
+        mesclar16(indiceI, t16, m);
+        avancar(pc, m, 2);
+        break;
+    case OP_JP_V0:
+        for (int f = 0; f < F; ++f)
+            t16[f] = (uint16_t)(d.nnn + registradores[0][f]);
+        mesclar16(pc, t16, m);
+        break;
+    case OP_RND:
+        for (int f = 0; f < F; ++f)
+            if (m[f])
+                vx[f] = (uint8_t)(pcg32_proximo(estado_rng[f]) >> 24) & d.nn;
+        avancar(pc, m, 2);
+        break;
+    case OP_DRW:
+        for (int f = 0; f < F; ++f)
+        {
+            if (!m[f])
+                continue;
+            uint8_t xcoord = vx[f] % LARGURA_TELA;
+            uint8_t ycoord = vy[f] % ALTURA_TELA;
+            uint64_t colisao = 0;
+            for (uint8_t row = 0; row < d.n; row++)
+            {
+                uint64_t bits = (uint64_t)memoria[f][(indiceI[f] + row) & 0x0FFF] << 56;
+                uint64_t sprite = (bits >> xcoord) | (bits << ((LARGURA_TELA - xcoord) & 63));
+                uint64_t &linha = tela[f][(ycoord + row) % ALTURA_TELA];
+                colisao |= linha & sprite;
+                linha ^= sprite;
+            }
+            vf[f] = colisao ? 1 : 0;
+        }
+        avancar(pc, m, 2);
+        break;
+    case OP_SKP:
+        for (int f = 0; f < F; ++f)
+            t[f] = (uint8_t)(teclas[f] >> (vx[f] & 0x0F));
+        pular_se(pc, t, m);
+        break;
+    case OP_SKNP:
+        for (int f = 0; f < F; ++f)
+            t[f] = (uint8_t)~(teclas[f] >> (vx[f] & 0x0F));
+        pular_se(pc, t, m);
+        break;
+    case OP_LD_VX_DT:
+        mesclar8(vx, temporizador_delay, m);
+        avancar(pc, m, 2);
+        break;
+    case OP_LD_VX_K:
+        // a faixa sai do feixe até VM_DefinirTecla; o pc fica na própria FX0A
+        for (int f = 0; f < F; ++f)
+        {
+            if (!m[f])
+                continue;
+            ativa[f] = 0;
+            reg_aguardando_tecla[f] = d.x;
+        }
+        break;
+    case OP_LD_DT_VX:
+        mesclar8(temporizador_delay, vx, m);
+        avancar(pc, m, 2);
+        break;
+    case OP_LD_ST_VX:
+        mesclar8(temporizador_som, vx, m);
+        avancar(pc, m, 2);
+        break;
+    case OP_ADD_I_VX:
+        for (int f = 0; f < F; ++f)
+            t16[f] = (uint16_t)((indiceI[f] + vx[f]) & 0x0FFF);
+        mesclar16(indiceI, t16, m);
+        avancar(pc, m, 2);
+        break;
+    case OP_LD_F_VX:
+        for (int f = 0; f < F; ++f)
+            t16[f] = (uint16_t)(0x50 + vx[f] * 5);
+        mesclar16(indiceI, t16, m);
+        avancar(pc, m, 2);
+        break;
+    case OP_LD_B_VX:
+        for (int f = 0; f < F; ++f)
+        {
+            if (!m[f])
+                continue;
+            uint8_t v = vx[f];
+            escrever_memoria(f, indiceI[f], v / 100);
+            escrever_memoria(f, indiceI[f] + 1, (v / 10) % 10);
+            escrever_memoria(f, indiceI[f] + 2, v % 10);
+        }
+        avancar(pc, m, 2);
+        break;
+    case OP_LD_I_VX:
+        for (int f = 0; f < F; ++f)
+        {
+            if (!m[f])
+                continue;
+            for (int i = 0; i <= d.x; ++i)
+                escrever_memoria(f, indiceI[f] + i, registradores[i][f]);
+        }
+        avancar(pc, m, 2);
+        break;
+    case OP_LD_VX_I:
+        for (int f = 0; f < F; ++f)
+        {
+            if (!m[f])
+                continue;
+            for (int i = 0; i <= d.x; ++i)
+                registradores[i][f] = memoria[f][(indiceI[f] + i) & 0x0FFF];
+        }
+        avancar(pc, m, 2);
+        break;
+    default: // OP_NOP e instruções desconhecidas
+        avancar(pc, m, 2);
+        break;
+    }
+}
+
+CLONES_SIMD
+void FeixeChip8::VM_Executar(uint32_t n)
+{
+    while (n-- > 0)
+    {
+        // referência: pc da primeira faixa ativa; diferenca != 0 se alguma ativa está noutro pc
+        int primeira = -1;
+        for (int f = 0; f < F && primeira < 0; ++f)
+            if (ativa[f])
+                primeira = f;
+        if (primeira < 0)
+            return; // todas as faixas esperam tecla
+
+        uint16_t ref = pc[primeira];
+        uint16_t diferenca = 0;
+        for (int f = 0; f < F; ++f)
+            diferenca |= (uint16_t)((pc[f] ^ ref) & (uint16_t)(int16_t)(int8_t)ativa[f]);
+
+        if (diferenca == 0 && mesma_instrucao(ref, ativa))
+        {
+            Decodificada &d = cache_decod[ref & 0x0FFF];
+            if (d.op == OP_NAO_DECODIFICADA)
+                d = Chip8::decodificar((memoria[0][ref & 0x0FFF] << 8) | memoria[0][(ref + 1) & 0x0FFF]);
+            Decodificada copia = d; // executar_grupo pode invalidar a entrada do cache
+            executar_grupo(copia, ativa);
+            ++n_uniformes;
+            continue;
+        }
+
+        // pcs divergentes: um grupo mascarado por pc distinto, cada faixa executada uma vez
+        ++n_divergentes;
+        alignas(64) uint8_t resta[F];
+        alignas(64) uint8_t grupo[F];
+        std::memcpy(resta, ativa, sizeof(resta));
+        uint32_t bits_resta = bits_mascara(resta);
+        while (bits_resta)
+        {
+            uint16_t p = pc[__builtin_ctz(bits_resta)];
+            for (int g = 0; g < F; ++g)
+            {
+                grupo[g] = (uint8_t)(-(pc[g] == p) & resta[g]);
+                resta[g] &= (uint8_t)~grupo[g];
+            }
+            bits_resta &= ~bits_mascara(grupo);
+            if (mesma_instrucao(p, grupo))
+            {
+                Decodificada &d = cache_decod[p & 0x0FFF];
+                if (d.op == OP_NAO_DECODIFICADA)
+                    d = Chip8::decodificar((memoria[0][p & 0x0FFF] << 8) | memoria[0][(p + 1) & 0x0FFF]);
+                Decodificada copia = d;
+                executar_grupo(copia, grupo);
+            }
+            else
+            {
+                for (int g = 0; g < F; ++g)
+                    if (grupo[g])
+                        executar_faixa(g);
+            }
+        }
+    }
+}
@@ -0,0 +1,399 @@
+#include "../lib/fuzz.hpp"
+#include "../lib/escalonador.hpp"
+#include "../lib/gravacao.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+
+// Limites das entradas mutadas: execuções curtas não precisam de mais que isso
+static const size_t MAX_EVENTOS = 512;
+static const size_t MAX_REMENDOS = 32;
+
+const char *nome_violacao(Violacao v)
+{
+    switch (v)
+    {
+    case VIOLACAO_PILHA_CHEIA:
+        return "pilha-cheia";
+    case VIOLACAO_PILHA_VAZIA:
+        return "pilha-vazia";
+    case VIOLACAO_LEITURA:
+        return "leitura-fora";
+    case VIOLACAO_ESCRITA:
+        return "escrita-fora";
+    case VIOLACAO_ESCRITA_SISTEMA:
+        return "escrita-fonte";
+    case VIOLACAO_PC:
+        return "pc-fora";
+    case VIOLACAO_INSTRUCAO:
+        return "instrucao-invalida";
+    default:
+        return "?";
+    }
+}
+
+void ColetaFuzz::limpar()
+{
+    std::memset(arestas, 0, sizeof(arestas));
+    std::memset(pcs, 0, sizeof(pcs));
+    anterior = 0;
+    violacoes = 0;
+}
+
+void aplicar_remendos_fuzz(Chip8 &vm, const EntradaFuzz &entrada)
+{
+    for (const RemendoROM &r : entrada.remendos)
+    {
+        if (r.endereco >= TAM_MEMORIA && vm.quirks == QUIRKS_XOCHIP)
+        {
+            // a memória alta volta inteira com a ExtensaoChip8 em VM_ReiniciarDe
+            vm.ext->memoria_alta[r.endereco - TAM_MEMORIA] = r.valor;
+            ++vm.efeitos;
+        }
+        else
+        {
+            vm.escrever_memoria(r.endereco & 0x0FFF, r.valor);
+        }
+    }
+}
+
+// Faixas de contagem do AFL (1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+), um bit cada: passar
+// de 3 para 5 voltas num laço conta como comportamento novo, de 40 para 41 não
+struct TabelaFaixas
+{
+    uint8_t faixa[256];
+
+    TabelaFaixas()
+    {
+        faixa[0] = 0;
+        for (int c = 1; c < 256; ++c)
+            faixa[c] = c < 4 ? (uint8_t)(1 << (c - 1)) : c < 8 ? 8 : c < 16 ? 16 : c < 32 ? 32 : c < 128 ? 64 : 128;
+    }
+};
+static const TabelaFaixas FAIXAS;
+
+// Acrescenta a vistas as faixas da coleta; true se alguma era nova. O mapa de uma execução é
+// quase todo zero, então a varredura pula de 8 em 8 bytes.
+static bool acrescentar_faixas(const ColetaFuzz &c, uint8_t *vistas)
+{
+    bool nova = false;
+    for (int i = 0; i < TAM_MAPA_ARESTAS; i += 8)
+    {
+        uint64_t palavra;
+        std::memcpy(&palavra, &c.arestas[i], 8);
+        if (!palavra)
+            continue;
+        for (int k = i; k < i + 8; ++k)
+        {
+            uint8_t f = FAIXAS.faixa[c.arestas[k]];
+            if (f & ~vistas[k])
+            {
+                vistas[k] |= f;
+                nova = true;
+            }
+        }
+    }
+    return nova;
+}
+
+// Estado compartilhado entre as threads. O corpus só cresce: cada thread guarda uma cópia e
+// busca as entradas novas quando tamanho_corpus passa do que ela tem. O mapa global de faixas só
+// é consultado (sob a trava) quando o mapa local da thread acusa algo novo, o que fica raro
+// depois dos primeiros segundos.
+struct EstadoFuzz
+{
+    std::mutex trava;
+    std::vector<EntradaFuzz> corpus;
+    std::atomic<size_t> tamanho_corpus{0};
+    uint8_t vistas[TAM_MAPA_ARESTAS];
+    uint64_t pcs[TAM_PCS_FUZZ / 64];
+    std::set<std::pair<int, uint16_t>> achados_vistos;
+    std::atomic<size_t> n_achados{0}; // achados_vistos.size(), para o progresso ler sem a trava
+    std::vector<AchadoFuzz> achados;
+    std::atomic<uint64_t> execucoes{0};
+    std::atomic<uint64_t> instrucoes{0};
+    std::atomic<bool> parar{false};
+};
+
+// Reserva o número da próxima execução antes de rodá-la; false quando o limite (0 = sem limite)
+// já foi reservado inteiro, então --execucoes N roda exatamente N
+static bool reservar_execucao(EstadoFuzz &est, uint64_t limite, uint64_t &execucao)
+{
+    uint64_t atual = est.execucoes.load(std::memory_order_relaxed);
+    do
+    {
+        if (limite && atual >= limite)
+            return false;
+    } while (!est.execucoes.compare_exchange_weak(atual, atual + 1, std::memory_order_relaxed));
+    execucao = atual + 1;
+    return true;
+}
+
+static uint32_t sortear(uint64_t &rng, uint32_t n)
+{
+    return n ? pcg32_proximo(rng) % n : 0;
+}
+
+// Uma a quatro mutações empilhadas sobre a entrada
+static void mutar(EntradaFuzz &e, const std::vector<EntradaFuzz> &corpus, const ConfigFuzz &cfg,
+                  const EstadoChip8 &base, uint64_t &rng)
+{
+    int n = 1 + (int)sortear(rng, 4);
+    for (int m = 0; m < n; ++m)
+    {
+        std::vector<EventoTecla> &ev = e.eventos;
+        uint32_t op = sortear(rng, cfg.mutar_rom && cfg.tam_rom ? 7 : 5);
+        switch (op)
+        {
+        case 0: // toque: pressiona e solta depois de alguns frames
+        {
+            if (ev.size() + 2 > MAX_EVENTOS)
+                break;
+            EventoTecla t;
+            t.tecla = (uint8_t)sortear(rng, 16);
+            t.frame = sortear(rng, (uint32_t)cfg.frames);
+            t.pressionada = true;
+            ev.push_back(t);
+            t.frame += 1 + sortear(rng, 30);
+            t.pressionada = false;
+            if (t.frame < cfg.frames)
+                ev.push_back(t);
+            break;
+        }
+        case 1: // remove um evento
+            if (!ev.empty())
+                ev.erase(ev.begin() + sortear(rng, (uint32_t)ev.size()));
+            break;
+        case 2: // adianta ou atrasa um evento
+            if (!ev.empty())
+            {
+                EventoTecla &t = ev[sortear(rng, (uint32_t)ev.size())];
+                int64_t delta = (int64_t)sortear(rng, 33) - 16;
+                t.frame = (uint64_t)std::min<int64_t>(std::max<int64_t>((int64_t)t.frame + delta, 0), (int64_t)cfg.frames - 1);
+            }
+            break;
+        case 3: // troca a tecla de um evento
+            if (!ev.empty())
+                ev[sortear(rng, (uint32_t)ev.size())].tecla = (uint8_t)sortear(rng, 16);
+            break;
+        case 4: // emenda: a partir de um frame, os eventos de outra entrada do corpus
+        {
+            const EntradaFuzz &outra = corpus[sortear(rng, (uint32_t)corpus.size())];
+            uint64_t corte = sortear(rng, (uint32_t)cfg.frames);
+            ev.erase(std::remove_if(ev.begin(), ev.end(), [&](const EventoTecla &t)
+                                    { return t.frame >= corte; }),
+                     ev.end());
+            for (const EventoTecla &t : outra.eventos)
+                if (t.frame >= corte && ev.size() < MAX_EVENTOS)
+                    ev.push_back(t);
+            break;
+        }
+        case 5: // troca um bit de um byte da ROM
+        case 6: // ou o byte inteiro
+        {
+            uint16_t end = (uint16_t)(0x200 + sortear(rng, cfg.tam_rom));
+            auto r = std::find_if(e.remendos.begin(), e.remendos.end(), [&](const RemendoROM &x)
+                                  { return x.endereco == end; });
+            if (r == e.remendos.end())
+            {
+                if (e.remendos.size() >= MAX_REMENDOS)
+                    break;
+                e.remendos.push_back(RemendoROM{end, base.memoria[end]});
+                r = e.remendos.end() - 1;
+            }
+            if (op == 5)
+                r->valor ^= (uint8_t)(1u << sortear(rng, 8));
+            else
+                r->valor = (uint8_t)pcg32_proximo(rng);
+            break;
+        }
+        }
+    }
+    std::stable_sort(e.eventos.begin(), e.eventos.end(), [](const EventoTecla &a, const EventoTecla &b)
+                     { return a.frame < b.frame; });
+}
+
+// Refaz a execução numa VM sem instrumentação, registrando-a como uma sessão: --reproduzir
+// a repete frame a frame e confere as telas
+static bool gravar_achado(const Chip8 &modelo, const EntradaFuzz &e, const ConfigFuzz &cfg, const std::string &arquivo)
+{
+    std::unique_ptr<Chip8> vm(new Chip8());
+    vm->VM_ReiniciarDe(modelo);
+    aplicar_remendos_fuzz(*vm, e);
+    GravacaoEntrada g;
+    g.iniciar(*vm, cfg.hz, 0);
+    DivisorCiclos ciclos(cfg.hz);
+    size_t prox = 0;
+    for (uint64_t frame = 0; frame < cfg.frames; ++frame)
+    {
+        for (; prox < e.eventos.size() && e.eventos[prox].frame <= frame; ++prox)
+        {
+            g.tecla(e.eventos[prox].tecla, e.eventos[prox].pressionada);
+            vm->VM_DefinirTecla(e.eventos[prox].tecla, e.eventos[prox].pressionada);
+        }
+        vm->VM_Executar(ciclos.proximo());
+        vm->tickTimers();
+        g.fim_de_frame(*vm);
+    }
+    return salvar_gravacao(g, arquivo.c_str());
+}
+
+void executar_fuzz(Chip8 &modelo, const ConfigFuzz &cfg, ResultadoFuzz &res)
+{
+    unsigned n_threads = cfg.n_threads ? cfg.n_threads : std::max(1u, std::thread::hardware_concurrency());
+
+    modelo.VM_CompartilharMemoria();
+    std::unique_ptr<EstadoChip8> base(new EstadoChip8()); // bytes originais para as mutações da ROM
+    modelo.VM_SalvarEstado(*base);
+
+    std::unique_ptr<EstadoFuzz> est(new EstadoFuzz());
+    std::memset(est->vistas, 0, sizeof(est->vistas));
+    std::memset(est->pcs, 0, sizeof(est->pcs));
+    est->corpus.emplace_back(); // semente: nenhuma tecla
+    est->tamanho_corpus = 1;
+
+    auto t_inicio = std::chrono::steady_clock::now();
+
+    auto trabalhador = [&](unsigned id)
+    {
+        uint64_t rng = pcg32_semear(cfg.semente * 0x9E3779B97F4A7C15ULL + id);
+        std::unique_ptr<ColetaFuzz> coleta(new ColetaFuzz());
+        std::vector<uint8_t> vistas(TAM_MAPA_ARESTAS, 0);
+        std::vector<EntradaFuzz> corpus;
+        Chip8 vm;
+        vm.VM_ColetarFuzz(coleta.get());
+        TarefaLote tarefa;
+        tarefa.frames = cfg.frames;
+        auto proximo_relatorio = t_inicio + std::chrono::seconds(1);
+        bool primeira = true; // a semente roda uma vez sem mutação
+
+        std::vector<AchadoFuzz> novos;
+        uint64_t execucao;
+        while (!est->parar.load(std::memory_order_relaxed))
+        {
+            if (!reservar_execucao(*est, cfg.execucoes, execucao))
+            {
+                est->parar = true;
+                break;
+            }
+
+            if (est->tamanho_corpus.load(std::memory_order_acquire) != corpus.size())
+            {
+                std::lock_guard<std::mutex> lk(est->trava);
+                corpus.insert(corpus.end(), est->corpus.begin() + corpus.size(), est->corpus.end());
+                std::memcpy(vistas.data(), est->vistas, TAM_MAPA_ARESTAS);
+            }
+
+            EntradaFuzz e = corpus[sortear(rng, (uint32_t)corpus.size())];
+            if (!primeira)
+                mutar(e, corpus, cfg, *base, rng);
+            primeira = false;
+
+            vm.VM_ReiniciarDe(modelo);
+            aplicar_remendos_fuzz(vm, e);
+            coleta->limpar();
+            tarefa.eventos.swap(e.eventos);
+            ResultadoLote r = ResultadoLote{};
+            executar_tarefa_lote(vm, tarefa, cfg.hz, r);
+            tarefa.eventos.swap(e.eventos);
+
+            est->instrucoes.fetch_add(r.instrucoes, std::memory_order_relaxed);
+
+            if (acrescentar_faixas(*coleta, vistas.data()) || coleta->violacoes)
+            {
+                std::lock_guard<std::mutex> lk(est->trava);
+                if (acrescentar_faixas(*coleta, est->vistas))
+                {
+                    for (int k = 0; k < TAM_PCS_FUZZ / 64; ++k)
+                        est->pcs[k] |= coleta->pcs[k];
+                    est->corpus.push_back(e);
+                    est->tamanho_corpus.store(est->corpus.size(), std::memory_order_release);
+                }
+                for (int v = 0; v < VIOLACAO_TOTAL; ++v)
+                {
+                    if (!(coleta->violacoes & (1u << v)) ||
+                        !est->achados_vistos.insert(std::make_pair(v, coleta->pc_violacao[v])).second)
+                        continue;
+                    est->n_achados.store(est->achados_vistos.size(), std::memory_order_relaxed);
+                    AchadoFuzz a;
+                    a.tipo = (Violacao)v;
+                    a.pc = coleta->pc_violacao[v];
+                    a.endereco = coleta->endereco_violacao[v];
+                    a.execucao = execucao;
+                    novos.push_back(a);
+                }
+            }
+
+            // a sessão de um achado é refeita e gravada fora da trava: e é a cópia desta thread
+            if (!novos.empty())
+            {
+                for (AchadoFuzz &a : novos)
+                {
+                    if (cfg.dir_achados.empty())
+                        continue;
+                    char nome[64];
+                    snprintf(nome, sizeof(nome), "/%s-%03X.c8in", nome_violacao(a.tipo), a.pc);
+                    if (gravar_achado(modelo, e, cfg, cfg.dir_achados + nome))
+                        a.arquivo = cfg.dir_achados + nome;
+                }
+                std::lock_guard<std::mutex> lk(est->trava);
+                est->achados.insert(est->achados.end(), novos.begin(), novos.end());
+                novos.clear();
+            }
+
+            if (id == 0 && (cfg.segundos > 0.0 || cfg.progresso) && (execucao & 63) == 0)
+            {
+                auto agora = std::chrono::steady_clock::now();
+                std::chrono::duration<double> dur = agora - t_inicio;
+                if (cfg.segundos > 0.0 && dur.count() >= cfg.segundos)
+                    est->parar = true;
+                if (cfg.progresso && agora >= proximo_relatorio)
+                {
+                    proximo_relatorio += std::chrono::seconds(1);
+                    fprintf(stderr, "%8.1f s  %10llu execuções  %8.0f exec/s  corpus %zu  achados %zu\n", dur.count(),
+                            (unsigned long long)execucao, double(execucao) / dur.count(),
+                            est->tamanho_corpus.load(), est->n_achados.load(std::memory_order_relaxed));
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned id = 1; id < n_threads; ++id)
+        threads.emplace_back(trabalhador, id);
+    trabalhador(0);
+    for (std::thread &th : threads)
+        th.join();
+
+    std::chrono::duration<double> dur = std::chrono::steady_clock::now() - t_inicio;
+    res.segundos = dur.count();
+    res.execucoes = est->execucoes;
+    res.instrucoes = est->instrucoes;
+    res.corpus = est->corpus.size();
+    res.arestas = 0;
+    for (int i = 0; i < TAM_MAPA_ARESTAS; ++i)
+        res.arestas += est->vistas[i] != 0;
+    res.pcs = 0;
+    for (int k = 0; k < TAM_PCS_FUZZ / 64; ++k)
+        res.pcs += (uint32_t)__builtin_popcountll(est->pcs[k]);
+    res.achados = std::move(est->achados);
+    std::sort(res.achados.begin(), res.achados.end(), [](const AchadoFuzz &a, const AchadoFuzz &b)
+              { return a.tipo != b.tipo ? a.tipo < b.tipo : a.pc < b.pc; });
+}
+
+void imprimir_resultado_fuzz(FILE *saida, const ResultadoFuzz &res)
+{
+    fprintf(saida, "execucoes:  %llu (%.0f exec/s)\n", (unsigned long long)res.execucoes,
+            res.segundos > 0.0 ? double(res.execucoes) / res.segundos : 0.0);
+    fprintf(saida, "inst/s:     %.0f\n", res.segundos > 0.0 ? double(res.instrucoes) / res.segundos : 0.0);
+    fprintf(saida, "tempo:      %.3f s\n", res.segundos);
+    fprintf(saida, "corpus:     %zu entradas\n", res.corpus);
+    fprintf(saida, "cobertura:  %u pcs, %u arestas\n", res.pcs, res.arestas);
+    fprintf(saida, "achados:    %zu\n", res.achados.size());
+    for (const AchadoFuzz &a : res.achados)
+        fprintf(saida, "  %-18s pc %03X  %04X  execução %llu  %s\n", nome_violacao(a.tipo), a.pc, a.endereco,
+                (unsigned long long)a.execucao, a.arquivo.c_str());
+}
@@ -0,0 +1,224 @@
+#include "../lib/gravacao.hpp"
+#include "../lib/escalonador.hpp"
+#include <algorithm>
+#include <chrono>
+
+void GravacaoEntrada::iniciar(const Chip8 &vm, int hz, int instr_por_frame)
+{
+    this->hz = hz;
+    this->instr_por_frame = instr_por_frame;
+    frames = 0;
+    inicial.reset(new EstadoChip8());
+    vm.VM_SalvarEstado(*inicial);
+    eventos.clear();
+    hashes.clear();
+}
+
+void GravacaoEntrada::tecla(uint8_t tecla, bool pressionada)
+{
+    EventoTecla ev;
+    ev.frame = frames;
+    ev.tecla = tecla & 0xF;
+    ev.pressionada = pressionada;
+    eventos.push_back(ev);
+}
+
+void GravacaoEntrada::fim_de_frame(const Chip8 &vm)
+{
+    if (++frames % INTERVALO_CONFERENCIA == 0)
+        hashes.push_back(vm.VM_HashTela());
+}
+
+bool salvar_gravacao(const GravacaoEntrada &g, const char *arquivo)
+{
+    CabecalhoGravacao cab;
+    std::memset(&cab, 0, sizeof(cab));
+    cab.magica = MAGICA_GRAVACAO;
+    cab.versao = VERSAO_GRAVACAO;
+    cab.hz = (uint32_t)g.hz;
+    cab.instr_por_frame = (uint32_t)g.instr_por_frame;
+    cab.frames = g.frames;
+    cab.n_eventos = (uint32_t)g.eventos.size();
+    cab.n_hashes = (uint32_t)g.hashes.size();
+
+    std::vector<uint8_t> eventos;
+    uint64_t anterior = 0;
+    for (const EventoTecla &ev : g.eventos)
+    {
+        uint64_t delta = ev.frame - anterior;
+        anterior = ev.frame;
+        do
+        {
+            uint8_t b = delta & 0x7F;
+            delta >>= 7;
+            eventos.push_back(b | (delta ? 0x80 : 0));
+        } while (delta);
+        eventos.push_back((uint8_t)(ev.tecla | (ev.pressionada ? 0x10 : 0)));
+    }
+
+    FILE *f = fopen(arquivo, "wb");
+    if (!f)
+    {
+        perror(arquivo);
+        return false;
+    }
+    bool ok = fwrite(&cab, sizeof(cab), 1, f) == 1 &&
+              escrever_estado(f, *g.inicial) &&
+              fwrite(eventos.data(), 1, eventos.size(), f) == eventos.size() &&
+              fwrite(g.hashes.data(), sizeof(uint64_t), g.hashes.size(), f) == g.hashes.size();
+    ok = (fclose(f) == 0) && ok;
+    if (!ok)
+        fprintf(stderr, "%s: erro de escrita\n", arquivo);
+    return ok;
+}
+
+bool carregar_gravacao(GravacaoEntrada &g, const char *arquivo)
+{
+    FILE *f = fopen(arquivo, "rb");
+    if (!f)
+    {
+        perror(arquivo);
+        return false;
+    }
+
+    CabecalhoGravacao cab;
+    g.inicial.reset(new EstadoChip8());
+    bool ok = fread(&cab, sizeof(cab), 1, f) == 1 && cab.magica == MAGICA_GRAVACAO &&
+              cab.versao == VERSAO_GRAVACAO && ler_estado(f, *g.inicial);
+    if (!ok)
+    {
+        fclose(f);
+        fprintf(stderr, "%s: não é uma gravação CHIP-8 versão %u\n", arquivo, VERSAO_GRAVACAO);
+        return false;
+    }
+    // o cabeçalho vem do arquivo: as contagens têm de bater com a duração e caber no que resta
+    // (cada evento ocupa ao menos 2 bytes) antes de qualquer alocação
+    long inicio_eventos = ftell(f);
+    long fim = fseek(f, 0, SEEK_END) == 0 ? ftell(f) : -1;
+    if (inicio_eventos < 0 || fim < 0 || fseek(f, inicio_eventos, SEEK_SET) != 0 ||
+        cab.n_hashes != cab.frames / INTERVALO_CONFERENCIA ||
+        2 * (uint64_t)cab.n_eventos + sizeof(uint64_t) * (uint64_t)cab.n_hashes > (uint64_t)(fim - inicio_eventos))
+    {
+        fclose(f);
+        fprintf(stderr, "%s: cabeçalho da gravação inconsistente com o arquivo\n", arquivo);
+        return false;
+    }
+    g.hz = (int)cab.hz;
+    g.instr_por_frame = (int)cab.instr_por_frame;
+    g.frames = cab.frames;
+
+    g.eventos.clear();
+    g.eventos.reserve(cab.n_eventos);
+    uint64_t frame = 0;
+    for (uint32_t i = 0; ok && i < cab.n_eventos; ++i)
+    {
+        uint64_t delta = 0;
+        int c;
+        for (int desloc = 0;; desloc += 7)
+        {
+            c = fgetc(f);
+            if (c == EOF || desloc > 63)
+            {
+                ok = false;
+                break;
+            }
+            delta |= (uint64_t)(c & 0x7F) << desloc;
+            if (!(c & 0x80))
+                break;
+        }
+        c = ok ? fgetc(f) : EOF;
+        if (c == EOF)
+        {
+            ok = false;
+            break;
+        }
+        frame += delta;
+        EventoTecla ev;
+        ev.frame = frame;
+        ev.tecla = (uint8_t)(c & 0xF);
+        ev.pressionada = (c & 0x10) != 0;
+        g.eventos.push_back(ev);
+    }
+
+    g.hashes.resize(cab.n_hashes);
+    ok = ok && fread(g.hashes.data(), sizeof(uint64_t), g.hashes.size(), f) == g.hashes.size();
+    fclose(f);
+    if (!ok)
+        fprintf(stderr, "%s: gravação truncada\n", arquivo);
+    return ok;
+}
+
+// Mesmo laço de frames do modo headless e do lote: eventos no início do frame, instruções do
+// DivisorCiclos, timers no fim
+void reproduzir_gravacao(const GravacaoEntrada &g, bool usar_jit, ResultadoReproducao &res, RastroChip8 *rastro)
+{
+    std::unique_ptr<Chip8> vm(new Chip8());
+    vm->VM_RestaurarEstado(*g.inicial);
+    if (usar_jit)
+        vm->VM_AtivarJIT();
+    vm->VM_Rastrear(rastro);
+
+    res.execucao = ResultadoHeadless{0, 0, 0, 0.0};
+    res.identica = true;
+    res.frame_divergente = 0;
+
+    DivisorCiclos ciclos(g.hz, g.instr_por_frame);
+    size_t prox_evento = 0;
+    size_t prox_hash = 0;
+
+    auto t_inicio = std::chrono::steady_clock::now();
+
+    for (uint64_t frame = 0; frame < g.frames; ++frame)
+    {
+        while (prox_evento < g.eventos.size() && g.eventos[prox_evento].frame <= frame)
+        {
+            const EventoTecla &ev = g.eventos[prox_evento++];
+            vm->VM_DefinirTecla(ev.tecla, ev.pressionada);
+        }
+
+        // parada em FX0A: até o próximo evento os frames só decrementam timers; os hashes de
+        // conferência do trecho são todos iguais à tela atual
+        if (vm->VM_AguardandoTecla())
+        {
+            uint64_t ate = prox_evento < g.eventos.size() ? std::min(g.eventos[prox_evento].frame, g.frames) : g.frames;
+            if (ate > frame)
+            {
+                uint64_t pular = ate - frame;
+                vm->VM_AvancarOcioso(pular);
+                res.execucao.puladas += ciclos.avancar(pular);
+                uint64_t hash = vm->VM_HashTela();
+                for (; prox_hash < g.hashes.size() && (prox_hash + 1) * INTERVALO_CONFERENCIA <= ate; ++prox_hash)
+                {
+                    if (res.identica && hash != g.hashes[prox_hash])
+                    {
+                        res.identica = false;
+                        res.frame_divergente = (prox_hash + 1) * INTERVALO_CONFERENCIA;
+                    }
+                }
+                frame = ate - 1; // o ++ do for completa o salto
+                continue;
+            }
+        }
+
+        uint32_t a_executar = ciclos.proximo();
+        uint32_t executadas = vm->VM_Executar(a_executar);
+        res.execucao.instrucoes += executadas;
+        res.execucao.puladas += a_executar - executadas;
+        vm->tickTimers();
+
+        if ((frame + 1) % INTERVALO_CONFERENCIA == 0 && prox_hash < g.hashes.size())
+        {
+            if (res.identica && vm->VM_HashTela() != g.hashes[prox_hash])
+            {
+                res.identica = false;
+                res.frame_divergente = frame + 1;
+            }
+            ++prox_hash;
+        }
+    }
+
+    std::chrono::duration<double> dur = std::chrono::steady_clock::now() - t_inicio;
+    res.execucao.segundos = dur.count();
+    res.execucao.frames = g.frames;
+    res.hash_final = vm->VM_HashTela();
+}
@@ -0,0 +1,441 @@
+#include "../lib/jit_x64.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#define JIT_SUPORTADO 1
+#endif
+
+static const size_t TAM_BUFFER_JIT = 1 << 20; // 1MB de código; ao encher, tudo é descartado
+static const uintptr_t TAM_PAGINA_HOST = 4096; // granularidade do mprotect no x86-64
+
+// Registradores usados pelo código gerado (System V, todos voláteis):
+//   rdi = V0..VF, rsi = &I, rdx = &delay, rcx = &som, r8 = memória, r9 = ControleJIT
+//   al/eax = acumulador, r11b = valor de VF, r10/r11 = temporários de FX65 e EX9E/EXA1
+static const uint8_t CTL_PC = offsetof(ControleJIT, pc);
+static const uint8_t CTL_LIGACAO = offsetof(ControleJIT, ligacao);
+static const uint8_t CTL_TECLAS = offsetof(ControleJIT, teclas);
+static const uint8_t CTL_VOLTA = offsetof(ControleJIT, volta);
+static const uint8_t CTL_VOLTAS = offsetof(ControleJIT, voltas);
+static const uint8_t CTL_GERACAO_VOLTAS = offsetof(ControleJIT, geracao_voltas);
+
+// tamanho de emitir_saida(); a ligação sobrescreve os 5 primeiros bytes com um jmp rel32
+static const int TAM_SAIDA = 19;
+
+namespace
+{
+    struct Emissor
+    {
+        uint8_t *p;
+
+        void b(uint8_t v) { *p++ = v; }
+        void b(uint8_t v1, uint8_t v2) { b(v1), b(v2); }
+        void b(uint8_t v1, uint8_t v2, uint8_t v3) { b(v1, v2), b(v3); }
+        void b(uint8_t v1, uint8_t v2, uint8_t v3, uint8_t v4) { b(v1, v2), b(v3, v4); }
+        void w(uint16_t v) { b(v & 0xFF, v >> 8); }
+        void d(uint32_t v) { w(v & 0xFFFF), w(v >> 16); }
+
+        void mov_al_reg(uint8_t r) { b(0x8A, 0x47, r); }  // mov al, [rdi+r]
+        void mov_reg_al(uint8_t r) { b(0x88, 0x47, r); }  // mov [rdi+r], al
+        void mov_vf_r11b() { b(0x44, 0x88, 0x5F, 0x0F); } // mov [rdi+15], r11b
+        void mov_reg_imm(uint8_t r, uint8_t v) { b(0xC6, 0x47, r, v); }
+        void add_reg_imm(uint8_t r, uint8_t v) { b(0x80, 0x47, r, v); }
+
+        void mov_ctl_pc(uint16_t v) // mov word [r9+pc], imm16
+        {
+            b(0x66, 0x41, 0xC7, 0x41), b(CTL_PC), w(v);
+        }
+        void zerar_ctl_ligacao() // mov qword [r9+ligacao], 0
+        {
+            b(0x49, 0xC7, 0x41, CTL_LIGACAO), d(0);
+        }
+    };
+}
+
+// Grava pc e o endereço que a ligação sobrescreve com um jmp rel32 e retorna (com volta, também
+// marca ControleJIT::volta)
+static void emitir_retorno(Emissor &e, uint16_t destino, uint8_t *ligacao, bool volta)
+{
+    e.mov_ctl_pc(destino);
+    e.b(0x48, 0x8D, 0x05); // lea rax, [rip+disp32] -> ligacao
+    e.d((uint32_t)(int32_t)(ligacao - (e.p + 4)));
+    e.b(0x49, 0x89, 0x41, CTL_LIGACAO); // mov [r9+ligacao], rax
+    if (volta)
+        e.b(0x41, 0xC6, 0x41, CTL_VOLTA), e.b(1); // mov byte [r9+volta], 1
+    e.b(0xC3);                                    // ret
+}
+
+// Saída com destino fixo: a ligação sobrescreve o início da própria saída
+static void emitir_saida(Emissor &e, uint16_t destino)
+{
+    emitir_retorno(e, destino, e.p, false);
+}
+
+// JP para trás: segue pelo jmp do meio (o que a ligação sobrescreve) só se voltas[destino] for a
+// geração da chamada; senão retorna marcando volta
+static void emitir_volta(Emissor &e, uint16_t destino)
+{
+    e.b(0x49, 0x8B, 0x41, CTL_VOLTAS);         // mov rax, [r9+voltas]
+    e.b(0x0F, 0xB6, 0x80), e.d(destino);       // movzx eax, byte [rax+destino]
+    e.b(0x41, 0x3A, 0x41, CTL_GERACAO_VOLTAS); // cmp al, [r9+geracao_voltas]
+    e.b(0x75, 5);                              // jne retorno
+    uint8_t *ligacao = e.p;
+    e.b(0xE9), e.d(0); // jmp retorno; ligado: jmp bloco de destino
+    emitir_retorno(e, destino, ligacao, true);
+}
+
+// Skip condicional já comparado: jcc para a saída que pula a próxima instrução
+static void emitir_skip(Emissor &e, uint8_t jcc, uint16_t endereco)
+{
+    e.b(jcc, TAM_SAIDA); // jcc rel8 sobre a saída sem pulo
+    emitir_saida(e, endereco + 2);
+    emitir_saida(e, endereco + 4);
+}
+
+// Emite a instrução se ela pertence ao corpo compilável do bloco; false caso contrário
+static bool emitir_corpo(Emissor &e, uint16_t inst)
+{
+    uint8_t X = (inst & 0x0F00) >> 8;
+    uint8_t Y = (inst & 0x00F0) >> 4;
+    uint8_t N = inst & 0x000F;
+    uint8_t NN = inst & 0x00FF;
+    uint16_t NNN = inst & 0x0FFF;
+
+    switch (inst & 0xF000)
+    {
+    case 0x6000: // LD Vx, byte
+        e.mov_reg_imm(X, NN);
+        return true;
+
+    case 0x7000: // ADD Vx, byte
+        e.add_reg_imm(X, NN);
+        return true;
+
+    case 0x8000:
+        // Cada passo relê os registradores da memória para reproduzir exatamente a ordem
+        // das atribuições do interpretador (importa quando X ou Y é VF).
+        switch (N)
+        {
+        case 0x0:
+            e.mov_al_reg(Y);
+            e.mov_reg_al(X);
+            return true;
+        case 0x1:
+            e.mov_al_reg(Y);
+            e.b(0x08, 0x47, X); // or [rdi+X], al
+            return true;
+        case 0x2:
+            e.mov_al_reg(Y);
+            e.b(0x20, 0x47, X); // and [rdi+X], al
+            return true;
+        case 0x3:
+            e.mov_al_reg(Y);
+            e.b(0x30, 0x47, X); // xor [rdi+X], al
+            return true;
+        case 0x4: // soma calculada antes de escrever VF
+            e.mov_al_reg(X);
+            e.b(0x02, 0x47, Y);          // add al, [rdi+Y]
+            e.b(0x41, 0x0F, 0x92, 0xC3); // setc r11b
+            e.mov_vf_r11b();
+            e.mov_reg_al(X);
+            return true;
+        case 0x5:
+        case 0x7:
+        {
+            uint8_t a = (N == 0x5) ? X : Y; // minuendo
+            uint8_t s = (N == 0x5) ? Y : X; // subtraendo
+            e.mov_al_reg(a);
+            e.b(0x3A, 0x47, s);          // cmp al, [rdi+s]
+            e.b(0x41, 0x0F, 0x97, 0xC3); // seta r11b
+            e.mov_vf_r11b();
+            e.mov_al_reg(a);
+            e.b(0x2A, 0x47, s); // sub al, [rdi+s]
+            e.mov_reg_al(X);
+            return true;
+        }
+        case 0x6:
+            e.mov_al_reg(X);
+            e.b(0x24, 0x01); // and al, 1
+            e.mov_reg_al(0xF);
+            e.mov_al_reg(X);
+            e.b(0xD0, 0xE8); // shr al, 1
+            e.mov_reg_al(X);
+            return true;
+        case 0xE:
+            e.mov_al_reg(X);
+            e.b(0xC0, 0xE8, 0x07); // shr al, 7
+            e.mov_reg_al(0xF);
+            e.mov_al_reg(X);
+            e.b(0xD0, 0xE0); // shl al, 1
+            e.mov_reg_al(X);
+            return true;
+        default:
+            return false;
+        }
+
+    case 0xA000: // LD I, addr
+        e.b(0x66, 0xC7, 0x06); // mov word [rsi], imm16
+        e.w(NNN);
+        return true;
+
+    case 0xF000:
+        switch (NN)
+        {
+        case 0x07:
+            e.b(0x8A, 0x02); // mov al, [rdx]
+            e.mov_reg_al(X);
+            return true;
+        case 0x15:
+            e.mov_al_reg(X);
+            e.b(0x88, 0x02); // mov [rdx], al
+            return true;
+        case 0x18:
+            e.mov_al_reg(X);
+            e.b(0x88, 0x01); // mov [rcx], al
+            return true;
+        case 0x1E:
+            e.b(0x0F, 0xB6, 0x47, X); // movzx eax, byte [rdi+X]
+            e.b(0x66, 0x03, 0x06);    // add ax, [rsi]
+            e.b(0x66, 0x25);          // and ax, 0x0FFF
+            e.w(0x0FFF);
+            e.b(0x66, 0x89, 0x06); // mov [rsi], ax
+            return true;
+        case 0x29:
+            e.b(0x0F, 0xB6, 0x47, X);    // movzx eax, byte [rdi+X]
+            e.b(0x8D, 0x44, 0x80, 0x50); // lea eax, [rax+rax*4+0x50]
+            e.b(0x66, 0x89, 0x06);       // mov [rsi], ax
+            return true;
+        case 0x65:
+            e.b(0x0F, 0xB7, 0x06); // movzx eax, word [rsi]
+            for (uint8_t i = 0; i <= X; ++i)
+            {
+                e.b(0x44, 0x8D, 0x50, i);    // lea r10d, [rax+i]
+                e.b(0x41, 0x81, 0xE2);       // and r10d, 0x0FFF
+                e.d(0x0FFF);
+                e.b(0x47, 0x8A, 0x1C, 0x10); // mov r11b, [r8+r10]
+                e.b(0x44, 0x88, 0x5F, i);    // mov [rdi+i], r11b
+            }
+            return true;
+        default:
+            return false;
+        }
+
+    default:
+        return false;
+    }
+}
+
+// Emite a instrução que encerra o bloco (salto ou skip); false se ela fica com o interpretador
+static bool emitir_fim(Emissor &e, uint16_t inst, uint16_t endereco)
+{
+    uint8_t X = (inst & 0x0F00) >> 8;
+    uint8_t Y = (inst & 0x00F0) >> 4;
+    uint8_t NN = inst & 0x00FF;
+    uint16_t NNN = inst & 0x0FFF;
+
+    switch (inst & 0xF000)
+    {
+    case 0x1000: // JP addr
+        if (NNN <= endereco)
+            emitir_volta(e, NNN);
+        else
+            emitir_saida(e, NNN);
+        return true;
+
+    case 0x3000: // SE Vx, byte
+    case 0x4000: // SNE Vx, byte
+        e.b(0x80, 0x7F, X, NN); // cmp byte [rdi+X], NN
+        emitir_skip(e, (inst & 0xF000) == 0x3000 ? 0x74 : 0x75, endereco);
+        return true;
+
+    case 0x5000: // SE Vx, Vy
+    case 0x9000: // SNE Vx, Vy
+        if ((inst & 0x000F) != 0)
+            return false;
+        e.mov_al_reg(X);
+        e.b(0x3A, 0x47, Y); // cmp al, [rdi+Y]
+        emitir_skip(e, (inst & 0xF000) == 0x5000 ? 0x74 : 0x75, endereco);
+        return true;
+
+    case 0xB000: // JP V0, addr: destino só é conhecido em tempo de execução
+        e.b(0x0F, 0xB6, 0x07); // movzx eax, byte [rdi]
+        e.b(0x66, 0x05);       // add ax, NNN
+        e.w(NNN);
+        e.b(0x66, 0x41, 0x89, 0x41), e.b(CTL_PC); // mov [r9+pc], ax
+        e.zerar_ctl_ligacao();
+        e.b(0xC3);
+        return true;
+
+    case 0xE000: // SKP / SKNP Vx
+        if (NN != 0x9E && NN != 0xA1)
+            return false;
+        e.b(0x0F, 0xB6, 0x47, X);          // movzx eax, byte [rdi+X]
+        e.b(0x83, 0xE0, 0x0F);             // and eax, 0x0F
+        e.b(0x45, 0x0F, 0xB7, 0x51), e.b(CTL_TECLAS); // movzx r10d, word [r9+teclas]
+        e.b(0x41, 0x0F, 0xA3, 0xC2);                  // bt r10d, eax (CF = tecla pressionada)
+        emitir_skip(e, NN == 0x9E ? 0x72 : 0x73, endereco);
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+JitX64::JitX64() : buffer(nullptr), tam_buffer(0), usado(0), geracao(0), geracao_voltas(0)
+{
+    std::memset(blocos, 0, sizeof(blocos));
+    std::memset(coberto, 0, sizeof(coberto));
+    std::memset(voltas, 0, sizeof(voltas));
+#ifdef JIT_SUPORTADO
+    // mapeado RW e nunca RWX; um SO que não deixe páginas anônimas virarem RX fica sem JIT
+    void *mem = mmap(nullptr, TAM_BUFFER_JIT, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        return;
+    if (mprotect(mem, TAM_BUFFER_JIT, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(mem, TAM_BUFFER_JIT);
+        return;
+    }
+    buffer = (uint8_t *)mem;
+    tam_buffer = TAM_BUFFER_JIT;
+#endif
+}
+
+JitX64::~JitX64()
+{
+#ifdef JIT_SUPORTADO
+    if (buffer)
+        munmap(buffer, tam_buffer);
+#endif
+}
+
+bool JitX64::proteger(uint8_t *inicio, size_t tam, bool gravar)
+{
+#ifdef JIT_SUPORTADO
+    uintptr_t pagina = (uintptr_t)inicio & ~(TAM_PAGINA_HOST - 1);
+    size_t bytes = (uintptr_t)inicio + tam - pagina;
+    return mprotect((void *)pagina, bytes, gravar ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) == 0;
+#else
+    (void)inicio, (void)tam, (void)gravar;
+    return false;
+#endif
+}
+
+void JitX64::compilar(uint16_t endereco, const uint8_t *memoria)
+{
+    if (!buffer)
+    {
+        blocos[endereco].tentado = true;
+        return;
+    }
+
+    // pior caso: corpo só com FX65 de 16 registradores, prólogo e duas saídas (ou uma volta)
+    const size_t max_bytes = MAX_INSTR_BLOCO * (3 + 16 * 19) + 64 + 2 * TAM_SAIDA;
+    if (usado + max_bytes > tam_buffer)
+        invalidar_tudo();
+
+    BlocoJIT &b = blocos[endereco];
+    b.tentado = true;
+
+    // o rascunho também escreve no buffer: a janela inteira fica gravável até o fim da emissão
+    uint8_t *inicio = buffer + usado;
+    if (!proteger(inicio, max_bytes, true))
+        return;
+
+    // tamanho do corpo e se a instrução seguinte pode encerrar o bloco em código nativo
+    Emissor rascunho = {inicio};
+    uint16_t end = endereco;
+    uint16_t n = 0;
+    while (n < MAX_INSTR_BLOCO && end + 1 <= 0x0FFF &&
+           emitir_corpo(rascunho, (memoria[end] << 8) | memoria[end + 1]))
+    {
+        ++n;
+        end += 2;
+    }
+    bool tem_fim = false;
+    if (end + 1 <= 0x0FFF)
+    {
+        Emissor teste = rascunho;
+        tem_fim = emitir_fim(teste, (memoria[end] << 8) | memoria[end + 1], end);
+    }
+    uint16_t total = n + (tem_fim ? 1 : 0);
+    if (total == 0)
+    {
+        // instrução inicial fica com o interpretador
+        if (!proteger(inicio, max_bytes, false))
+            invalidar_tudo();
+        return;
+    }
+
+    // emissão final: prólogo que consome o orçamento, corpo e saída
+    Emissor e = {inicio};
+    static_assert(offsetof(ControleJIT, orcamento) == 0, "orcamento no início de ControleJIT");
+    e.b(0x41, 0x83, 0x29, (uint8_t)total); // sub dword [r9], total
+    e.b(0x73, 20);                         // jae corpo (pula os 20 bytes abaixo)
+    e.b(0x41, 0x83, 0x01, (uint8_t)total); // add dword [r9], total: sem orçamento, desfaz e sai
+
+    e.mov_ctl_pc(endereco);
+    e.zerar_ctl_ligacao();
+    e.b(0xC3);
+
+    end = endereco;
+    for (uint16_t i = 0; i < n; ++i, end += 2)
+        emitir_corpo(e, (memoria[end] << 8) | memoria[end + 1]);
+    if (tem_fim)
+        emitir_fim(e, (memoria[end] << 8) | memoria[end + 1], end);
+    else
+        emitir_saida(e, end);
+
+    // sem RX nada nestas páginas pode rodar, nem os blocos anteriores que as dividem
+    if (!proteger(inicio, max_bytes, false))
+    {
+        invalidar_tudo();
+        return;
+    }
+
+    for (uint16_t a = endereco; a < endereco + 2 * total && a <= 0x0FFF; ++a)
+        coberto[a] = true;
+
+    b.codigo = (FuncaoBloco)inicio;
+    b.n_instr = total;
+    usado = e.p - buffer;
+}
+
+void JitX64::ligar(uint8_t *ligacao, uint16_t destino, const uint8_t *memoria)
+{
+    // a compilação do destino pode esvaziar o buffer, o que invalida a própria saída
+    uint32_t geracao_antes = geracao;
+    const BlocoJIT *alvo = bloco(destino, memoria);
+    if (!alvo || geracao != geracao_antes)
+        return;
+    int32_t rel = (int32_t)((uint8_t *)alvo->codigo - (ligacao + 5));
+    if (!proteger(ligacao, 5, true))
+        return;
+    ligacao[0] = 0xE9; // jmp rel32
+    std::memcpy(ligacao + 1, &rel, sizeof(rel));
+    if (!proteger(ligacao, 5, false))
+        invalidar_tudo();
+}
+
+void JitX64::ligar_volta(uint8_t *ligacao, uint16_t destino, const uint8_t *memoria)
+{
+    // ligada numa chamada anterior: o jmp já está lá, só falta liberar
+    const BlocoJIT *alvo = blocos[destino & 0x0FFF].codigo ? &blocos[destino & 0x0FFF] : nullptr;
+    int32_t rel = alvo ? (int32_t)((uint8_t *)alvo->codigo - (ligacao + 5)) : 0;
+    if (!alvo || std::memcmp(ligacao + 1, &rel, sizeof(rel)) != 0)
+    {
+        uint32_t geracao_antes = geracao;
+        ligar(ligacao, destino, memoria);
+        if (geracao != geracao_antes)
+            return;
+    }
+    voltas[destino & 0x0FFF] = geracao_voltas;
+}
+
+void JitX64::invalidar_tudo()
+{
+    std::memset(blocos, 0, sizeof(blocos));
+    std::memset(coberto, 0, sizeof(coberto));
+    usado = 0;
+    ++geracao;
+}
@@ -0,0 +1,324 @@
+#include "../lib/lote.hpp"
+#include "../lib/escalonador.hpp"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+// Junta caminho relativo ao diretório base (caminhos absolutos ficam como estão)
+static std::string resolver_caminho(const std::string &base, const std::string &caminho)
+{
+    if (caminho.empty() || caminho[0] == '/' || base.empty())
+        return caminho;
+    return base + "/" + caminho;
+}
+
+bool ler_roteiro_entrada(const std::string &arquivo, std::vector<EventoTecla> &eventos)
+{
+    std::ifstream in(arquivo);
+    if (!in)
+        return false;
+
+    std::string linha;
+    while (std::getline(in, linha))
+    {
+        size_t com = linha.find('#');
+        if (com != std::string::npos)
+            linha.erase(com);
+        std::istringstream campos(linha);
+        uint64_t frame;
+        std::string tecla;
+        int estado;
+        if (!(campos >> frame))
+            continue;
+        if (!(campos >> tecla >> estado))
+            return false;
+        EventoTecla ev;
+        ev.frame = frame;
+        ev.tecla = (uint8_t)(strtoul(tecla.c_str(), nullptr, 16) & 0xF);
+        ev.pressionada = estado != 0;
+        eventos.push_back(ev);
+    }
+    // estável: eventos do mesmo frame são aplicados na ordem do arquivo
+    std::stable_sort(eventos.begin(), eventos.end(),
+                     [](const EventoTecla &a, const EventoTecla &b)
+                     { return a.frame < b.frame; });
+    return true;
+}
+
+bool ler_lista_tarefas(const char *arquivo, std::vector<TarefaLote> &tarefas)
+{
+    std::ifstream in(arquivo);
+    if (!in)
+    {
+        perror(arquivo);
+        return false;
+    }
+
+    std::string base = arquivo;
+    size_t barra = base.rfind('/');
+    base = barra == std::string::npos ? "" : base.substr(0, barra);
+
+    std::string linha;
+    int num_linha = 0;
+    while (std::getline(in, linha))
+    {
+        ++num_linha;
+        size_t com = linha.find('#');
+        if (com != std::string::npos)
+            linha.erase(com);
+        std::istringstream campos(linha);
+        TarefaLote t;
+        if (!(campos >> t.rom))
+            continue;
+        if (!(campos >> t.frames) || t.frames == 0)
+        {
+            fprintf(stderr, "%s:%d: esperado \"<rom> <frames> [semente] [roteiro] [estado]\"\n", arquivo, num_linha);
+            return false;
+        }
+        t.semente = 0;
+        campos >> t.semente;
+        campos >> t.roteiro;
+        campos >> t.estado;
+        if (t.roteiro == "-")
+            t.roteiro.clear();
+        if (!t.estado.empty())
+            t.estado = resolver_caminho(base, t.estado);
+        t.hash_rom = 0;
+        size_t arroba = t.rom.rfind('@');
+        if (arroba != std::string::npos)
+        {
+            t.hash_rom = strtoull(t.rom.c_str() + arroba + 1, nullptr, 16);
+            t.rom.erase(arroba);
+        }
+        t.rom = resolver_caminho(base, t.rom);
+        if (!t.roteiro.empty())
+        {
+            t.roteiro = resolver_caminho(base, t.roteiro);
+            if (!ler_roteiro_entrada(t.roteiro, t.eventos))
+            {
+                fprintf(stderr, "%s:%d: roteiro inválido: %s\n", arquivo, num_linha, t.roteiro.c_str());
+                return false;
+            }
+        }
+        tarefas.push_back(std::move(t));
+    }
+    return true;
+}
+
+// Roda uma tarefa numa VM recém-carregada: mesma divisão de instruções por frame do modo
+// headless, com os eventos do roteiro aplicados no início de cada frame
+void executar_tarefa_lote(Chip8 &vm, const TarefaLote &tarefa, int fps, ResultadoLote &res)
+{
+    DivisorCiclos ciclos(fps);
+    size_t prox_evento = 0;
+
+    auto t_inicio = std::chrono::steady_clock::now();
+
+    for (res.frames = 0; res.frames < tarefa.frames; ++res.frames)
+    {
+        while (prox_evento < tarefa.eventos.size() && tarefa.eventos[prox_evento].frame <= res.frames)
+        {
+            const EventoTecla &ev = tarefa.eventos[prox_evento++];
+            vm.VM_DefinirTecla(ev.tecla, ev.pressionada);
+        }
+
+        // parada em FX0A: salta direto para o próximo evento do roteiro (ou o fim)
+        if (vm.VM_AguardandoTecla())
+        {
+            uint64_t ate = prox_evento < tarefa.eventos.size() ? tarefa.eventos[prox_evento].frame : tarefa.frames;
+            uint64_t pular = std::min(ate, tarefa.frames) - res.frames;
+            if (pular > 0)
+            {
+                vm.VM_AvancarOcioso(pular);
+                res.puladas += ciclos.avancar(pular);
+                PERFIL(vm.perfil.frames_pulados += pular;)
+                res.frames += pular - 1; // o ++ do for completa o salto
+                continue;
+            }
+        }
+
+        uint32_t a_executar = ciclos.proximo();
+
+        uint32_t executadas = vm.VM_Executar(a_executar);
+        res.instrucoes += executadas;
+        res.puladas += a_executar - executadas;
+
+        vm.tickTimers();
+        PERFIL(vm.perfil.contar_frame(vm.linhas_sujas != 0);)
+        vm.linhas_sujas = 0;
+    }
+
+    std::chrono::duration<double> dur = std::chrono::steady_clock::now() - t_inicio;
+    res.segundos = dur.count();
+    res.hash_tela = vm.VM_HashTela();
+    res.pc = vm.pc;
+    res.indiceI = vm.indiceI;
+    std::memcpy(res.registradores, vm.registradores, sizeof(res.registradores));
+    res.ok = true;
+}
+
+// Fila de índices de tarefa de uma thread. A dona consome pela frente; as outras roubam pelo fim,
+// o que tende a separar o trabalho local do roubado. As tarefas duram milissegundos, então um
+// mutex por fila não aparece no perfil.
+struct FilaTrabalho
+{
+    std::mutex trava;
+    std::deque<size_t> indices;
+
+    bool pegar_frente(size_t &i)
+    {
+        std::lock_guard<std::mutex> lk(trava);
+        if (indices.empty())
+            return false;
+        i = indices.front();
+        indices.pop_front();
+        return true;
+    }
+
+    bool roubar_fim(size_t &i)
+    {
+        std::lock_guard<std::mutex> lk(trava);
+        if (indices.empty())
+            return false;
+        i = indices.back();
+        indices.pop_back();
+        return true;
+    }
+};
+
+void executar_lote(const std::vector<TarefaLote> &tarefas, std::vector<ResultadoLote> &resultados,
+                   unsigned n_threads, int fps, bool usar_jit)
+{
+    if (n_threads == 0)
+        n_threads = std::max(1u, std::thread::hardware_concurrency());
+    if (n_threads > tarefas.size())
+        n_threads = std::max<size_t>(1, tarefas.size());
+
+    resultados.assign(tarefas.size(), ResultadoLote{});
+
+    // abre cada ROM uma vez aqui; as threads só leem as imagens
+    BibliotecaROM biblioteca;
+    std::vector<const ImagemROM *> imagens(tarefas.size());
+    for (size_t i = 0; i < tarefas.size(); ++i)
+    {
+        const ImagemROM *img = biblioteca.abrir(tarefas[i].rom);
+        if (img && tarefas[i].hash_rom != 0 && img->hash() != tarefas[i].hash_rom)
+        {
+            fprintf(stderr, "%s: hash %016llx, esperado %016llx\n", tarefas[i].rom.c_str(),
+                    (unsigned long long)img->hash(), (unsigned long long)tarefas[i].hash_rom);
+            img = nullptr;
+        }
+        imagens[i] = img;
+    }
+
+    // savestates de partida: um carregamento por arquivo, compartilhado entre as tarefas
+    std::map<std::string, std::unique_ptr<EstadoChip8>> estados_abertos;
+    std::vector<const EstadoChip8 *> estados(tarefas.size(), nullptr);
+    for (size_t i = 0; i < tarefas.size(); ++i)
+    {
+        const std::string &arq = tarefas[i].estado;
+        if (arq.empty())
+            continue;
+        std::unique_ptr<EstadoChip8> &e = estados_abertos[arq];
+        if (!e)
+        {
+            e.reset(new EstadoChip8());
+            if (!carregar_estado_arquivo(*e, arq.c_str()))
+                e->magica = 0; // inválido: as tarefas que o usam falham
+        }
+        if (e->magica == MAGICA_ESTADO)
+            estados[i] = e.get();
+        else
+            imagens[i] = nullptr;
+    }
+
+    // uma VM modelo por par ROM/savestate, já carregada e congelada: cada tarefa só reinicia a VM
+    // da sua thread a partir dela (VM_ReiniciarDe), sem reconstruir nem recarregar nada
+    std::map<std::pair<const ImagemROM *, const EstadoChip8 *>, std::unique_ptr<Chip8>> modelos_abertos;
+    std::vector<const Chip8 *> modelos(tarefas.size(), nullptr);
+    for (size_t i = 0; i < tarefas.size(); ++i)
+    {
+        if (!imagens[i])
+            continue;
+        std::unique_ptr<Chip8> &m = modelos_abertos[std::make_pair(imagens[i], estados[i])];
+        if (!m)
+        {
+            m.reset(new Chip8());
+            m->VM_inicializar(0x200);
+            if (!m->VM_CarregarImagem(*imagens[i], 0x200))
+            {
+                m.reset();
+                continue;
+            }
+            if (estados[i])
+                m->VM_RestaurarEstado(*estados[i]);
+            m->VM_CompartilharMemoria();
+        }
+        modelos[i] = m.get();
+    }
+
+    // distribuição inicial intercalada: listas ordenadas por ROM não concentram uma ROM pesada
+    // numa só thread
+    std::vector<FilaTrabalho> filas(n_threads);
+    for (size_t i = 0; i < tarefas.size(); ++i)
+        filas[i % n_threads].indices.push_back(i);
+
+    auto trabalhador = [&](unsigned id)
+    {
+        Chip8 vm; // reaproveitada entre as tarefas da thread, com o JIT e a memória própria
+        if (usar_jit)
+            vm.VM_AtivarJIT();
+        size_t i;
+        for (;;)
+        {
+            bool achou = filas[id].pegar_frente(i);
+            for (unsigned k = 1; !achou && k < n_threads; ++k)
+                achou = filas[(id + k) % n_threads].roubar_fim(i);
+            // ninguém cria tarefas depois do início: filas vazias = lote concluído
+            if (!achou)
+                return;
+
+            const TarefaLote &t = tarefas[i];
+            ResultadoLote &res = resultados[i];
+            if (!modelos[i])
+                continue; // res.ok fica false
+            vm.VM_ReiniciarDe(*modelos[i]);
+            // depois do snapshot: tarefas que partem do mesmo estado com sementes diferentes divergem
+            vm.VM_DefinirSemente(t.semente);
+            executar_tarefa_lote(vm, t, fps, res);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned id = 1; id < n_threads; ++id)
+        threads.emplace_back(trabalhador, id);
+    trabalhador(0);
+    for (std::thread &th : threads)
+        th.join();
+}
+
+void imprimir_resultados_lote(FILE *saida, const std::vector<TarefaLote> &tarefas,
+                              const std::vector<ResultadoLote> &resultados)
+{
+    fprintf(saida, "# tarefa rom semente frames instrucoes puladas hash_tela pc I V0..VF segundos\n");
+    for (size_t i = 0; i < tarefas.size(); ++i)
+    {
+        const TarefaLote &t = tarefas[i];
+        const ResultadoLote &r = resultados[i];
+        if (!r.ok)
+        {
+            fprintf(saida, "%zu %s %llu ERRO\n", i, t.rom.c_str(), (unsigned long long)t.semente);
+            continue;
+        }
+        fprintf(saida, "%zu %s %llu %llu %llu %llu %016llx %03X %03X ", i, t.rom.c_str(),
+                (unsigned long long)t.semente, (unsigned long long)r.frames, (unsigned long long)r.instrucoes,
+                (unsigned long long)r.puladas, (unsigned long long)r.hash_tela, r.pc, r.indiceI);
+        for (int k = 0; k < 16; ++k)
+            fprintf(saida, "%02X", r.registradores[k]);
+        fprintf(saida, " %.6f\n", r.segundos);
+    }
+}
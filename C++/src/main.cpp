@@ -1,30 +1,636 @@
 #include "../lib/chip8.hpp"
 #include "../lib/defs.hpp"
+#include "../lib/lote.hpp"
+#include "../lib/feixe.hpp"
+#include "../lib/gravacao.hpp"
+#include "../lib/diferencial.hpp"
+#include "../lib/fuzz.hpp"
+#include "../lib/video.hpp"
+#include "../lib/rastro.hpp"
+#include <chrono>
+
+static void imprimir_uso(const char *prog)
+{
+    std::cerr << "Uso: " << prog << " <arquivo_rom> <fps> <escala>" << std::endl;
+    std::cerr << "     " << prog << " --headless [--frames N | --instrucoes N] <arquivo_rom> <fps>" << std::endl;
+    std::cerr << "     " << prog << " --lote <lista> [--threads N] [--saida arquivo] <fps>" << std::endl;
+    std::cerr << "     " << prog << " --reproduzir <gravacao> [--jit]   reproduz sem limite de velocidade e confere as telas" << std::endl;
+    std::cerr << "     " << prog << " --diferencial A:B [--frames N] [--roteiro arq] [--por-instrucao] <arquivo_rom> <fps>" << std::endl;
+    std::cerr << "     " << prog << " --diferencial A:B --reproduzir <gravacao>" << std::endl;
+    std::cerr << "         roda os backends A e B (interp, jit, feixe) em passo travado e para na primeira divergência" << std::endl;
+    std::cerr << "     " << prog << " --fuzz [--frames N] [--execucoes N | --segundos S] [--threads N] [--mutar-rom] [--achados dir] <arquivo_rom> <fps>" << std::endl;
+    std::cerr << "         muta teclas (e bytes da ROM) guiado por cobertura de arestas; --frames é a duração de cada execução (padrão 300)" << std::endl;
+    std::cerr << "         e --achados grava uma sessão para --reproduzir por violação (pilha, memória fora dos limites, opcode inválido)" << std::endl;
+    std::cerr << "     " << prog << " --video arq [--escala N] [--frames N] [--roteiro arq] <arquivo_rom> <fps>" << std::endl;
+    std::cerr << "     " << prog << " --video arq [--escala N] --reproduzir <gravacao>" << std::endl;
+    std::cerr << "         grava a tela sem janela: arq .c8v (delta compacto), .y4m ou um diretório para PNGs" << std::endl;
+    std::cerr << "     " << prog << " --converter-video <entrada.c8v> <saida> [--escala N]   regrava um .c8v como .y4m ou PNGs" << std::endl;
+    std::cerr << "     " << prog << " --indexar <diretorio>   lista hash, tamanho e caminho das ROMs válidas" << std::endl;
+    std::cerr << "Opções: --jit    usa o recompilador x86-64 (cai no interpretador se indisponível)" << std::endl;
+    std::cerr << "        --ipf N  executa N instruções por frame de 60Hz (ignora <fps>)" << std::endl;
+    std::cerr << "        --audio N  buffer de áudio de N amostras a 44100 Hz (padrão 512; 0 = sem som)" << std::endl;
+    std::cerr << "        --gravar arq  (SDL) grava as teclas da sessão em arq para --reproduzir" << std::endl;
+    std::cerr << "        --rastro arq  (headless, --reproduzir) grava pc, opcode e registradores alterados de cada instrução" << std::endl;
+    std::cerr << "                      em arq (.c8t) para o analisador chip8-rastro (make rastro); desliga o JIT" << std::endl;
+    std::cerr << "        --perfil arq  grava o perfil JSON em arq (executáveis -perfil, de make PERFIL=1)" << std::endl;
+    std::cerr << "        --semente N  semente do gerador do CXNN (padrão 0; a mesma semente repete a execução)" << std::endl;
+    std::cerr << "        --carregar-estado arq  começa do savestate arq (depois de carregar a ROM)" << std::endl;
+    std::cerr << "        --salvar-estado arq    (headless) grava o savestate final em arq" << std::endl;
+    std::cerr << "        --quirks P  perfil de compatibilidade: moderno, vip, chip48, schip ou xochip (padrão: o da ROM, ou moderno)" << std::endl;
+    std::cerr << "        --feixe  (headless) roda " << FeixeChip8::FAIXAS << " instâncias da ROM em passo travado SIMD" << std::endl;
+}
+
+// Relatório da instrumentação ao sair: texto em stderr e JSON em arq_json. Builds com
+// CHIP8_PERFIL sempre gravam (perfil.json por padrão); os demais só avisam se --perfil foi pedido.
+static void gravar_perfil(const Chip8 &vm, const char *arq_json)
+{
+#ifdef CHIP8_PERFIL
+    if (!arq_json)
+        arq_json = "perfil.json";
+    FILE *json = fopen(arq_json, "w");
+    if (!json)
+        perror(arq_json);
+    vm.VM_ImprimirPerfil(stderr, json);
+    if (json)
+        fclose(json);
+#else
+    if (arq_json)
+        vm.VM_ImprimirPerfil(stderr, nullptr);
+#endif
+}
+
+// Abre o rastro pedido com --rastro (nullptr sem a opção ou se o arquivo não abre)
+static std::unique_ptr<RastroChip8> abrir_rastro(const char *arq_rastro, Quirks quirks, bool &ok)
+{
+    ok = true;
+    if (!arq_rastro)
+        return nullptr;
+    std::unique_ptr<RastroChip8> rastro(new RastroChip8());
+    if (!rastro->abrir(arq_rastro, quirks))
+    {
+        ok = false;
+        return nullptr;
+    }
+    return rastro;
+}
+
+// Fecha o rastro (esperando a escritora) e imprime o resumo; false se a gravação falhou
+static bool fechar_rastro(RastroChip8 *rastro)
+{
+    if (!rastro)
+        return true;
+    bool ok = rastro->fechar();
+    printf("rastro:     %llu instrucoes, %llu frames, %llu bytes\n", (unsigned long long)rastro->instrucoes(),
+           (unsigned long long)rastro->frames(), (unsigned long long)rastro->bytes());
+    return ok;
+}
 
 int main(int argc, char **argv)
 {
-    if (argc != 4)
+    bool headless = false;
+    bool usar_jit = false;
+    bool usar_feixe = false;
+    uint64_t max_frames = 0;
+    uint64_t max_instrucoes = 0;
+    const char *arq_lote = nullptr;
+    const char *arq_saida = nullptr;
+    unsigned n_threads = 0;
+    uint64_t semente = 0;
+    int instr_por_frame = 0;
+    OpcoesSDL opcoes_sdl;
+    const char *arq_reproducao = nullptr;
+    const char *backends_diferencial = nullptr;
+    const char *arq_roteiro = nullptr;
+    bool por_instrucao = false;
+    const char *arq_estado_inicial = nullptr;
+    const char *arq_estado_final = nullptr;
+    const char *arq_perfil = nullptr;
+    const char *arq_rastro = nullptr;
+    bool forcar_quirks = false;
+    bool fuzz = false;
+    ConfigFuzz cfg_fuzz;
+    cfg_fuzz.execucoes = 0;
+    cfg_fuzz.segundos = 0.0;
+    cfg_fuzz.mutar_rom = false;
+    const char *arq_video = nullptr;
+    const char *arq_converter = nullptr;
+    int escala_video = 1;
+    Quirks quirks = QUIRKS_MODERNO;
+    char *posicionais[3] = {nullptr, nullptr, nullptr};
+    int n_posicionais = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--headless")
+        {
+            headless = true;
+        }
+        else if (arg == "--jit")
+        {
+            usar_jit = true;
+        }
+        else if (arg == "--feixe")
+        {
+            usar_feixe = true;
+        }
+        else if (arg == "--frames" && i + 1 < argc)
+        {
+            max_frames = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--instrucoes" && i + 1 < argc)
+        {
+            max_instrucoes = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--carregar-estado" && i + 1 < argc)
+        {
+            arq_estado_inicial = argv[++i];
+        }
+        else if (arg == "--salvar-estado" && i + 1 < argc)
+        {
+            arq_estado_final = argv[++i];
+        }
+        else if (arg == "--ipf" && i + 1 < argc)
+        {
+            instr_por_frame = atoi(argv[++i]);
+        }
+        else if (arg == "--audio" && i + 1 < argc)
+        {
+            opcoes_sdl.amostras_audio = atoi(argv[++i]);
+        }
+        else if (arg == "--gravar" && i + 1 < argc)
+        {
+            opcoes_sdl.arq_gravacao = argv[++i];
+        }
+        else if (arg == "--diferencial" && i + 1 < argc)
+        {
+            backends_diferencial = argv[++i];
+        }
+        else if (arg == "--roteiro" && i + 1 < argc)
+        {
+            arq_roteiro = argv[++i];
+        }
+        else if (arg == "--por-instrucao")
+        {
+            por_instrucao = true;
+        }
+        else if (arg == "--reproduzir" && i + 1 < argc)
+        {
+            arq_reproducao = argv[++i];
+        }
+        else if (arg == "--rastro" && i + 1 < argc)
+        {
+            arq_rastro = argv[++i];
+        }
+        else if (arg == "--perfil" && i + 1 < argc)
+        {
+            arq_perfil = argv[++i];
+        }
+        else if (arg == "--quirks" && i + 1 < argc)
+        {
+            if (!ler_quirks(argv[++i], quirks))
+            {
+                imprimir_uso(argv[0]);
+                return 1;
+            }
+            forcar_quirks = true;
+        }
+        else if (arg == "--semente" && i + 1 < argc)
+        {
+            semente = strtoull(argv[++i], nullptr, 0);
+        }
+        else if (arg == "--indexar" && i + 1 < argc)
+        {
+            BibliotecaROM biblioteca;
+            biblioteca.indexar(argv[++i]);
+            biblioteca.imprimir_indice(stdout);
+            return 0;
+        }
+        else if (arg == "--fuzz")
+        {
+            fuzz = true;
+        }
+        else if (arg == "--execucoes" && i + 1 < argc)
+        {
+            cfg_fuzz.execucoes = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--segundos" && i + 1 < argc)
+        {
+            cfg_fuzz.segundos = atof(argv[++i]);
+        }
+        else if (arg == "--mutar-rom")
+        {
+            cfg_fuzz.mutar_rom = true;
+        }
+        else if (arg == "--achados" && i + 1 < argc)
+        {
+            cfg_fuzz.dir_achados = argv[++i];
+        }
+        else if (arg == "--video" && i + 1 < argc)
+        {
+            arq_video = argv[++i];
+        }
+        else if (arg == "--converter-video" && i + 1 < argc)
+        {
+            arq_converter = argv[++i];
+        }
+        else if (arg == "--escala" && i + 1 < argc)
+        {
+            escala_video = atoi(argv[++i]);
+        }
+        else if (arg == "--lote" && i + 1 < argc)
+        {
+            arq_lote = argv[++i];
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            n_threads = (unsigned)strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--saida" && i + 1 < argc)
+        {
+            arq_saida = argv[++i];
+        }
+        else if (arg.rfind("--", 0) != 0 && n_posicionais < 3)
+        {
+            posicionais[n_posicionais++] = argv[i];
+        }
+        else
+        {
+            imprimir_uso(argv[0]);
+            return 1;
+        }
+    }
+
+    if (backends_diferencial)
+    {
+        ConfigDiferencial cfg;
+        std::string par = backends_diferencial;
+        size_t dois_pontos = par.find(':');
+        if (dois_pontos == std::string::npos ||
+            !ler_backend_diferencial(par.substr(0, dois_pontos).c_str(), cfg.a) ||
+            !ler_backend_diferencial(par.substr(dois_pontos + 1).c_str(), cfg.b) ||
+            n_posicionais != (arq_reproducao ? 0 : 2))
+        {
+            imprimir_uso(argv[0]);
+            return 1;
+        }
+        cfg.por_instrucao = por_instrucao;
+
+        std::unique_ptr<EstadoChip8> inicial(new EstadoChip8());
+        if (arq_reproducao)
+        {
+            // a gravação traz estado, ritmo e entradas; --frames pode encurtar
+            GravacaoEntrada gravacao;
+            if (!carregar_gravacao(gravacao, arq_reproducao))
+                return 1;
+            *inicial = *gravacao.inicial;
+            cfg.hz = gravacao.hz;
+            cfg.instr_por_frame = gravacao.instr_por_frame;
+            cfg.frames = max_frames && max_frames < gravacao.frames ? max_frames : gravacao.frames;
+            cfg.eventos = gravacao.eventos;
+        }
+        else
+        {
+            std::unique_ptr<Chip8> vm(new Chip8());
+            vm->VM_inicializar(0x200);
+            if (!vm->VM_CarregarROM(posicionais[0], 0x200))
+                return 1;
+            vm->VM_DefinirSemente(semente);
+            if (arq_estado_inicial)
+            {
+                if (!carregar_estado_arquivo(*inicial, arq_estado_inicial))
+                    return 1;
+                vm->VM_RestaurarEstado(*inicial);
+            }
+            if (forcar_quirks)
+                vm->VM_DefinirQuirks(quirks);
+            vm->VM_SalvarEstado(*inicial);
+            cfg.hz = atoi(posicionais[1]);
+            cfg.instr_por_frame = instr_por_frame;
+            cfg.frames = max_frames ? max_frames : 600;
+            if (arq_roteiro && !ler_roteiro_entrada(arq_roteiro, cfg.eventos))
+            {
+                fprintf(stderr, "%s: roteiro inválido\n", arq_roteiro);
+                return 1;
+            }
+        }
+
+        if ((cfg.a == BACKEND_FEIXE || cfg.b == BACKEND_FEIXE) && inicial->quirks != QUIRKS_MODERNO)
+        {
+            fprintf(stderr, "o feixe só implementa o perfil moderno (perfil atual: %s)\n",
+                    nome_quirks((Quirks)inicial->quirks));
+            return 1;
+        }
+        // idem para o JIT: com outro perfil (ou sem JIT no host) o lado "jit" seria o interpretador
+        if (cfg.a == BACKEND_JIT || cfg.b == BACKEND_JIT)
+        {
+            if (cfg.por_instrucao)
+            {
+                fprintf(stderr, "--por-instrucao não vale com o JIT: instrução a instrução ele cai no interpretador\n");
+                return 1;
+            }
+            if (inicial->quirks != QUIRKS_MODERNO)
+            {
+                fprintf(stderr, "o JIT só implementa o perfil moderno (perfil atual: %s)\n",
+                        nome_quirks((Quirks)inicial->quirks));
+                return 1;
+            }
+            std::unique_ptr<Chip8> teste(new Chip8());
+            if (!teste->VM_AtivarJIT())
+            {
+                fprintf(stderr, "JIT indisponível nesta plataforma\n");
+                return 1;
+            }
+        }
+
+        ResultadoDiferencial res;
+        executar_diferencial(*inicial, cfg, res);
+        imprimir_resultado_diferencial(stdout, cfg, res);
+        return res.divergiu ? 2 : 0;
+    }
+
+    if (fuzz)
     {
-        std::cerr << "Uso: " << argv[0] << " <arquivo_rom> <fps> <escala>" << std::endl;
+        if (n_posicionais != 2)
+        {
+            imprimir_uso(argv[0]);
+            return 1;
+        }
+        ImagemROM imagem;
+        std::string erro;
+        if (!imagem.abrir(posicionais[0], erro))
+        {
+            fprintf(stderr, "%s: %s\n", posicionais[0], erro.c_str());
+            return 1;
+        }
+        std::unique_ptr<Chip8> modelo(new Chip8());
+        modelo->VM_inicializar(0x200);
+        if (!modelo->VM_CarregarImagem(imagem, 0x200))
+            return 1;
+        modelo->VM_DefinirSemente(semente);
+        if (arq_estado_inicial)
+        {
+            std::unique_ptr<EstadoChip8> estado(new EstadoChip8());
+            if (!carregar_estado_arquivo(*estado, arq_estado_inicial))
+                return 1;
+            modelo->VM_RestaurarEstado(*estado);
+        }
+        if (forcar_quirks)
+            modelo->VM_DefinirQuirks(quirks);
+
+        cfg_fuzz.hz = atoi(posicionais[1]);
+        cfg_fuzz.frames = max_frames ? max_frames : 300;
+        // sem limite explícito, roda 10 segundos
+        if (cfg_fuzz.execucoes == 0 && cfg_fuzz.segundos <= 0.0)
+            cfg_fuzz.segundos = 10.0;
+        cfg_fuzz.n_threads = n_threads;
+        cfg_fuzz.semente = semente;
+        size_t fim_memoria = modelo->VM_Quirks() == QUIRKS_XOCHIP ? 0x10000 : TAM_MEMORIA;
+        cfg_fuzz.tam_rom = (uint32_t)std::min<size_t>(imagem.tamanho(), fim_memoria - 0x200);
+        cfg_fuzz.progresso = true;
+
+        ResultadoFuzz res;
+        executar_fuzz(*modelo, cfg_fuzz, res);
+        imprimir_resultado_fuzz(stdout, res);
+        return res.achados.empty() ? 0 : 2;
+    }
+
+    if (arq_converter)
+    {
+        if (n_posicionais != 1)
+        {
+            imprimir_uso(argv[0]);
+            return 1;
+        }
+        return converter_video(arq_converter, posicionais[0], escala_video) ? 0 : 1;
+    }
+
+    if (arq_video)
+    {
+        std::unique_ptr<Chip8> vm(new Chip8());
+        int hz = 0;
+        uint64_t frames = 0;
+        std::vector<EventoTecla> eventos;
+        if (arq_reproducao)
+        {
+            // ritmo, duração e teclas vêm da gravação; --frames pode encurtar
+            GravacaoEntrada gravacao;
+            if (n_posicionais != 0 || !carregar_gravacao(gravacao, arq_reproducao))
+            {
+                if (n_posicionais != 0)
+                    imprimir_uso(argv[0]);
+                return 1;
+            }
+            vm->VM_RestaurarEstado(*gravacao.inicial);
+            hz = gravacao.hz;
+            instr_por_frame = gravacao.instr_por_frame;
+            frames = max_frames && max_frames < gravacao.frames ? max_frames : gravacao.frames;
+            eventos = gravacao.eventos;
+        }
+        else
+        {
+            if (n_posicionais != 2)
+            {
+                imprimir_uso(argv[0]);
+                return 1;
+            }
+            vm->VM_inicializar(0x200);
+            if (!vm->VM_CarregarROM(posicionais[0], 0x200))
+                return 1;
+            vm->VM_DefinirSemente(semente);
+            if (arq_estado_inicial)
+            {
+                std::unique_ptr<EstadoChip8> estado(new EstadoChip8());
+                if (!carregar_estado_arquivo(*estado, arq_estado_inicial))
+                    return 1;
+                vm->VM_RestaurarEstado(*estado);
+            }
+            if (forcar_quirks)
+                vm->VM_DefinirQuirks(quirks);
+            hz = atoi(posicionais[1]);
+            frames = max_frames ? max_frames : 600;
+            if (arq_roteiro && !ler_roteiro_entrada(arq_roteiro, eventos))
+            {
+                fprintf(stderr, "%s: roteiro inválido\n", arq_roteiro);
+                return 1;
+            }
+        }
+        if (usar_jit)
+            vm->VM_AtivarJIT();
+
+        bool estendido = quirks_estendido(vm->VM_Quirks());
+        GravadorVideo video;
+        if (!video.abrir(arq_video, formato_video(arq_video), estendido ? LARGURA_ALTA : LARGURA_TELA,
+                         estendido ? ALTURA_ALTA : ALTURA_TELA, vm->VM_Quirks() == QUIRKS_XOCHIP ? PLANOS : 1,
+                         escala_video))
+            return 1;
+        ResultadoHeadless res = exportar_video(*vm, hz, instr_por_frame, frames, eventos, video);
+        bool ok = video.fechar();
+        imprimir_resultado_headless(res);
+        printf("video:      %llu quadros, %llu bytes (%.1fx o tempo real)\n", (unsigned long long)video.quadros(),
+               (unsigned long long)video.bytes(), res.segundos > 0.0 ? double(res.frames) / 60.0 / res.segundos : 0.0);
+        return ok ? 0 : 1;
+    }
+
+    if (arq_reproducao)
+    {
+        GravacaoEntrada gravacao;
+        if (n_posicionais != 0 || !carregar_gravacao(gravacao, arq_reproducao))
+        {
+            if (n_posicionais != 0)
+                imprimir_uso(argv[0]);
+            return 1;
+        }
+        bool ok;
+        std::unique_ptr<RastroChip8> rastro = abrir_rastro(arq_rastro, (Quirks)gravacao.inicial->quirks, ok);
+        if (!ok)
+            return 1;
+        ResultadoReproducao res;
+        reproduzir_gravacao(gravacao, usar_jit, res, rastro.get());
+        imprimir_resultado_headless(res.execucao);
+        if (!fechar_rastro(rastro.get()))
+            return 1;
+        printf("hash_tela:  %016llx\n", (unsigned long long)res.hash_final);
+        if (!res.identica)
+        {
+            printf("DIVERGENTE: tela difere da gravação no frame %llu\n", (unsigned long long)res.frame_divergente);
+            return 2;
+        }
+        printf("idêntica:   %zu telas conferidas\n", gravacao.hashes.size());
+        return 0;
+    }
+
+    if (arq_lote)
+    {
+        if (n_posicionais != 1)
+        {
+            imprimir_uso(argv[0]);
+            return 1;
+        }
+        std::vector<TarefaLote> tarefas;
+        if (!ler_lista_tarefas(arq_lote, tarefas))
+            return 1;
+        std::vector<ResultadoLote> resultados;
+        auto t_inicio = std::chrono::steady_clock::now();
+        executar_lote(tarefas, resultados, n_threads, atoi(posicionais[0]), usar_jit);
+        std::chrono::duration<double> dur = std::chrono::steady_clock::now() - t_inicio;
+
+        FILE *saida = arq_saida ? fopen(arq_saida, "w") : stdout;
+        if (!saida)
+        {
+            perror(arq_saida);
+            return 1;
+        }
+        imprimir_resultados_lote(saida, tarefas, resultados);
+        if (saida != stdout)
+            fclose(saida);
+
+        uint64_t total = 0, puladas = 0;
+        for (const ResultadoLote &r : resultados)
+        {
+            total += r.instrucoes;
+            puladas += r.puladas;
+        }
+        fprintf(stderr, "%zu tarefas, %llu instrucoes (%llu puladas) em %.3f s (%.0f inst/s)\n", tarefas.size(),
+                (unsigned long long)total, (unsigned long long)puladas, dur.count(),
+                dur.count() > 0.0 ? double(total) / dur.count() : 0.0);
+        return 0;
+    }
+
+    if ((headless && n_posicionais != 2) || (!headless && n_posicionais != 3))
+    {
+        imprimir_uso(argv[0]);
         return 1;
     }
 
-    int Hz = atoi(argv[2]);    // Recebe a velocidade em Hz como parâmetro
-    int escala = atoi(argv[3]); // Recebe a escala de renderização como parâmetro
+    int Hz = atoi(posicionais[1]); // Recebe a velocidade em Hz como parâmetro
 
     Chip8 chip8;
 
     chip8.VM_inicializar(0x200);
 
-    chip8.VM_CarregarROM(argv[1], 0x200);
+    if (!chip8.VM_CarregarROM(posicionais[0], 0x200))
+        return 1;
+    chip8.VM_DefinirSemente(semente);
+
+    if (arq_estado_inicial)
+    {
+        std::unique_ptr<EstadoChip8> estado(new EstadoChip8());
+        if (!carregar_estado_arquivo(*estado, arq_estado_inicial))
+            return 1;
+        chip8.VM_RestaurarEstado(*estado);
+    }
+    if (forcar_quirks)
+        chip8.VM_DefinirQuirks(quirks);
+
+    if (usar_jit && !chip8.VM_AtivarJIT())
+        std::cerr << "JIT indisponível nesta plataforma, usando o interpretador" << std::endl;
+    else if (usar_jit && chip8.VM_Quirks() != QUIRKS_MODERNO)
+        std::cerr << "JIT só implementa o perfil moderno; perfil " << nome_quirks(chip8.VM_Quirks())
+                  << " roda no interpretador" << std::endl;
 
 #ifdef DEBUG
     chip8.VM_ImprimirRegistradores();
 #endif
 
+    if (headless)
+    {
+        // sem limite explícito, roda 10 segundos virtuais
+        if (max_frames == 0 && max_instrucoes == 0)
+            max_frames = 600;
+        if (usar_feixe)
+        {
+            if (chip8.VM_Quirks() != QUIRKS_MODERNO)
+            {
+                std::cerr << "o feixe só implementa o perfil moderno (perfil atual: " << nome_quirks(chip8.VM_Quirks())
+                          << ")" << std::endl;
+                return 1;
+            }
+            std::unique_ptr<FeixeChip8> feixe(new FeixeChip8());
+            feixe->VM_Iniciar(chip8);
+            ResultadoHeadless res = rodar_feixe_headless(*feixe, Hz, max_instrucoes, max_frames, instr_por_frame);
+            imprimir_resultado_headless(res);
+            uint64_t passos = feixe->passos_uniformes() + feixe->passos_divergentes();
+            printf("uniformes:  %.1f%% dos passos\n",
+                   passos ? 100.0 * double(feixe->passos_uniformes()) / double(passos) : 0.0);
+            return 0;
+        }
+        bool ok;
+        std::unique_ptr<RastroChip8> rastro = abrir_rastro(arq_rastro, chip8.VM_Quirks(), ok);
+        if (!ok)
+            return 1;
+        chip8.VM_Rastrear(rastro.get());
+        ResultadoHeadless res = chip8.rodarHeadless(Hz, max_instrucoes, max_frames, instr_por_frame);
+        chip8.VM_Rastrear(nullptr);
+#ifdef DEBUG
+        chip8.VM_ImprimirRegistradores();
+#endif
+        imprimir_resultado_headless(res);
+        if (!fechar_rastro(rastro.get()))
+            return 1;
+        gravar_perfil(chip8, arq_perfil);
+        if (arq_estado_final)
+        {
+            std::unique_ptr<EstadoChip8> estado(new EstadoChip8());
+            chip8.VM_SalvarEstado(*estado);
+            if (!salvar_estado_arquivo(*estado, arq_estado_final))
+                return 1;
+        }
+        return 0;
+    }
+
+#ifdef CHIP8_SEM_SDL
+    std::cerr << "Compilado sem SDL: use --headless" << std::endl;
+    return 1;
+#else
+    int escala = atoi(posicionais[2]); // Recebe a escala de renderização como parâmetro
+
 #ifdef DEBUG
     chip8.VM_ImprimirRegistradores();
 #endif
-    chip8.rodarSDL(Hz, escala); // Deve receber a velocidade em Hz como parâmetro e receber a escala de renderização
+    opcoes_sdl.instr_por_frame = instr_por_frame;
+    chip8.rodarSDL(Hz, escala, opcoes_sdl); // Deve receber a velocidade em Hz como parâmetro e receber a escala de renderização
+    gravar_perfil(chip8, arq_perfil);
     return 0;
+#endif
 }
@@ -0,0 +1,106 @@
+#include "../lib/chip8.hpp"
+#include <algorithm>
+#include <vector>
+
+#ifdef CHIP8_PERFIL
+
+static const char *nome_opcode(int op)
+{
+    static const char *const nomes[OP_TOTAL] = {
+        "?", "NOP", "CLS", "RET", "JP", "CALL", "SE_BYTE", "SNE_BYTE", "SE_REG", "LD_BYTE",
+        "ADD_BYTE", "LD_REG", "OR", "AND", "XOR", "ADD_REG", "SUB", "SHR", "SUBN", "SHL",
+        "SNE_REG", "LD_I", "JP_V0", "RND", "DRW", "SKP", "SKNP", "LD_VX_DT", "LD_VX_K",
+        "LD_DT_VX", "LD_ST_VX", "ADD_I_VX", "LD_F_VX", "LD_B_VX", "LD_I_VX", "LD_VX_I", "SCD",
+        "SCU", "SCR", "SCL", "EXIT", "LOW", "HIGH", "SAVE_VX_VY", "LOAD_VX_VY", "LD_I_LONGO", "PLANO",
+        "AUDIO", "LD_HF_VX", "LD_TOM_VX", "LD_R_VX", "LD_VX_R"};
+    return op >= 0 && op < OP_TOTAL ? nomes[op] : "?";
+}
+
+// Quantos endereços quentes entram no relatório
+static const size_t PCS_NO_RELATORIO = 20;
+
+void Chip8::VM_ImprimirPerfil(FILE *texto, FILE *json) const
+{
+    const PerfilChip8 &p = perfil;
+
+    uint64_t interpretadas = 0;
+    for (int op = 0; op < OP_TOTAL; ++op)
+        interpretadas += p.por_opcode[op];
+
+    // classes em ordem decrescente de execuções
+    std::vector<int> ops;
+    for (int op = 0; op < OP_TOTAL; ++op)
+        if (p.por_opcode[op])
+            ops.push_back(op);
+    std::sort(ops.begin(), ops.end(), [&](int a, int b)
+              { return p.por_opcode[a] > p.por_opcode[b]; });
+
+    std::vector<uint16_t> pcs;
+    for (int end = 0; end < 4096; ++end)
+        if (p.por_pc[end])
+            pcs.push_back((uint16_t)end);
+    size_t n_pcs = std::min(pcs.size(), PCS_NO_RELATORIO);
+    std::partial_sort(pcs.begin(), pcs.begin() + n_pcs, pcs.end(), [&](uint16_t a, uint16_t b)
+                      { return p.por_pc[a] > p.por_pc[b]; });
+
+    uint64_t frames = p.frames_desenhados + p.frames_pulados;
+    double pct_drw = p.ns_execucao ? 100.0 * double(p.ns_drw) / double(p.ns_execucao) : 0.0;
+
+    if (texto)
+    {
+        fprintf(texto, "== perfil ==\n");
+        fprintf(texto, "instrucoes: %llu interpretadas, %llu no JIT\n",
+                (unsigned long long)interpretadas, (unsigned long long)p.instrucoes_jit);
+        fprintf(texto, "tempo:      %.3f ms executando, %.3f ms em DRW (%.1f%%)\n",
+                p.ns_execucao / 1e6, p.ns_drw / 1e6, pct_drw);
+        fprintf(texto, "frames:     %llu desenhados, %llu pulados (%.1f%% pulados), %llu de recuperação\n",
+                (unsigned long long)p.frames_desenhados, (unsigned long long)p.frames_pulados,
+                frames ? 100.0 * double(p.frames_pulados) / double(frames) : 0.0,
+                (unsigned long long)p.frames_atrasados);
+        fprintf(texto, "por classe:\n");
+        for (int op : ops)
+            fprintf(texto, "  %-9s %12llu  %5.1f%%\n", nome_opcode(op), (unsigned long long)p.por_opcode[op],
+                    100.0 * double(p.por_opcode[op]) / double(interpretadas));
+        fprintf(texto, "pcs mais executados:\n");
+        for (size_t i = 0; i < n_pcs; ++i)
+        {
+            uint16_t end = pcs[i];
+            fprintf(texto, "  %03X %02X%02X %-9s %12llu  %5.1f%%\n", end, memoria[end], memoria[(end + 1) & 0xFFF],
+                    nome_opcode(cache_decod[end].op), (unsigned long long)p.por_pc[end],
+                    100.0 * double(p.por_pc[end]) / double(interpretadas));
+        }
+    }
+
+    if (json)
+    {
+        fprintf(json, "{\n  \"instrucoes_interpretadas\": %llu,\n  \"instrucoes_jit\": %llu,\n",
+                (unsigned long long)interpretadas, (unsigned long long)p.instrucoes_jit);
+        fprintf(json, "  \"ns_execucao\": %llu,\n  \"ns_drw\": %llu,\n",
+                (unsigned long long)p.ns_execucao, (unsigned long long)p.ns_drw);
+        fprintf(json, "  \"frames_desenhados\": %llu,\n  \"frames_pulados\": %llu,\n  \"frames_atrasados\": %llu,\n",
+                (unsigned long long)p.frames_desenhados, (unsigned long long)p.frames_pulados,
+                (unsigned long long)p.frames_atrasados);
+        fprintf(json, "  \"por_opcode\": {");
+        for (size_t i = 0; i < ops.size(); ++i)
+            fprintf(json, "%s\n    \"%s\": %llu", i ? "," : "", nome_opcode(ops[i]),
+                    (unsigned long long)p.por_opcode[ops[i]]);
+        fprintf(json, "\n  },\n  \"por_pc\": [");
+        // histograma completo, não só o topo: ferramentas externas fazem o próprio corte
+        std::sort(pcs.begin(), pcs.end());
+        for (size_t i = 0; i < pcs.size(); ++i)
+            fprintf(json, "%s\n    {\"pc\": %u, \"opcode\": %u, \"n\": %llu}", i ? "," : "", pcs[i],
+                    (unsigned)(memoria[pcs[i]] << 8 | memoria[(pcs[i] + 1) & 0xFFF]),
+                    (unsigned long long)p.por_pc[pcs[i]]);
+        fprintf(json, "\n  ]\n}\n");
+    }
+}
+
+#else
+
+void Chip8::VM_ImprimirPerfil(FILE *texto, FILE *) const
+{
+    if (texto)
+        fprintf(texto, "perfil indisponível: use o executável -perfil (make PERFIL=1)\n");
+}
+
+#endif
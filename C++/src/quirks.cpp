@@ -0,0 +1,58 @@
+#include "../lib/quirks.hpp"
+#include <string>
+
+bool ler_quirks(const char *nome, Quirks &q)
+{
+    std::string n = nome;
+    if (n == "moderno")
+        q = QUIRKS_MODERNO;
+    else if (n == "vip")
+        q = QUIRKS_COSMAC_VIP;
+    else if (n == "chip48")
+        q = QUIRKS_CHIP48;
+    else if (n == "schip")
+        q = QUIRKS_SCHIP;
+    else if (n == "xochip")
+        q = QUIRKS_XOCHIP;
+    else
+        return false;
+    return true;
+}
+
+const char *nome_quirks(Quirks q)
+{
+    switch (q)
+    {
+    case QUIRKS_COSMAC_VIP:
+        return "vip";
+    case QUIRKS_CHIP48:
+        return "chip48";
+    case QUIRKS_SCHIP:
+        return "schip";
+    case QUIRKS_XOCHIP:
+        return "xochip";
+    default:
+        return "moderno";
+    }
+}
+
+// ROMs que dependem de um perfil diferente do moderno, pelo hash do conteúdo (--indexar)
+struct QuirksROM
+{
+    uint64_t hash;
+    Quirks quirks;
+    const char *nome; // só documentação
+};
+
+static const QuirksROM TABELA_QUIRKS[] = {
+    // os prédios desenhados na borda direita precisam ser cortados, não dar a volta
+    {0x29bcab9b664d212bULL, QUIRKS_COSMAC_VIP, "c8games/BLITZ"},
+};
+
+Quirks quirks_da_rom(uint64_t hash)
+{
+    for (const QuirksROM &r : TABELA_QUIRKS)
+        if (r.hash == hash)
+            return r.quirks;
+    return QUIRKS_MODERNO;
+}
@@ -0,0 +1,468 @@
+#include "../lib/rastro.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+static uint8_t *escrever_leb128(uint8_t *p, uint64_t x)
+{
+    do
+    {
+        uint8_t b = x & 0x7F;
+        x >>= 7;
+        *p++ = b | (x ? 0x80 : 0);
+    } while (x);
+    return p;
+}
+
+static bool ler_leb128(FILE *f, uint64_t &x)
+{
+    x = 0;
+    for (int desloc = 0; desloc <= 63; desloc += 7)
+    {
+        int c = fgetc(f);
+        if (c == EOF)
+            return false;
+        x |= (uint64_t)(c & 0x7F) << desloc;
+        if (!(c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// ---- gravação -------------------------------------------------------------------------------
+
+RastroChip8::RastroChip8()
+    : anel(new EntradaRastro[CAPACIDADE]), cabeca(0), consumido_visto(0), publicado(0), consumido(0), parar(false),
+      arq(nullptr), erro(false), quirks(0), pc_previsto(0), n_instrucoes(0), n_frames(0), n_bytes(0)
+{
+}
+
+RastroChip8::~RastroChip8()
+{
+    if (escritora.joinable())
+        fechar();
+}
+
+bool RastroChip8::abrir(const char *caminho, uint8_t quirks)
+{
+    this->caminho = caminho;
+    this->quirks = quirks;
+    arq = fopen(caminho, "wb");
+    if (!arq)
+    {
+        perror(caminho);
+        return false;
+    }
+    CabecalhoRastro cab;
+    std::memset(&cab, 0, sizeof(cab));
+    cab.magica = MAGICA_RASTRO;
+    cab.versao = VERSAO_RASTRO;
+    cab.quirks = quirks;
+    if (fwrite(&cab, sizeof(cab), 1, arq) != 1)
+    {
+        perror(caminho);
+        fclose(arq);
+        arq = nullptr;
+        return false;
+    }
+    n_bytes = sizeof(cab);
+    escritora = std::thread(&RastroChip8::escrever_entradas, this);
+    return true;
+}
+
+bool RastroChip8::fechar()
+{
+    if (!escritora.joinable())
+        return false;
+    parar.store(true, std::memory_order_release);
+    escritora.join();
+
+    // os totais só são conhecidos agora
+    CabecalhoRastro cab;
+    std::memset(&cab, 0, sizeof(cab));
+    cab.magica = MAGICA_RASTRO;
+    cab.versao = VERSAO_RASTRO;
+    cab.quirks = quirks;
+    cab.instrucoes = n_instrucoes;
+    cab.frames = n_frames;
+    if (!erro && (fseek(arq, 0, SEEK_SET) != 0 || fwrite(&cab, sizeof(cab), 1, arq) != 1))
+    {
+        perror(caminho.c_str());
+        erro = true;
+    }
+    if (fclose(arq) != 0)
+        erro = true;
+    arq = nullptr;
+    return !erro;
+}
+
+uint64_t RastroChip8::esperar_espaco(uint64_t ate)
+{
+    publicar(ate);
+    while ((consumido_visto = consumido.load(std::memory_order_acquire)) + CAPACIDADE <= ate)
+        std::this_thread::yield();
+    return limite();
+}
+
+void RastroChip8::marcar(TipoRastro tipo, uint64_t n)
+{
+    while (n > 0)
+    {
+        uint64_t c = cabeca;
+        if (c == limite())
+            esperar_espaco(c);
+        EntradaRastro &e = anel[c & (CAPACIDADE - 1)];
+        e.tipo = tipo;
+        e.mudou = (uint32_t)std::min<uint64_t>(n, UINT32_MAX);
+        n -= e.mudou;
+        publicar(c + 1);
+    }
+}
+
+// Thread escritora: codifica em blocos e devolve o espaço do anel antes de gravar
+void RastroChip8::escrever_entradas()
+{
+    const uint64_t BLOCO = 4096;
+    std::vector<uint8_t> buf(BLOCO * sizeof(EntradaRastro));
+    uint64_t lido = 0;
+    for (;;)
+    {
+        uint64_t ate = publicado.load(std::memory_order_acquire);
+        if (ate == lido)
+        {
+            // parar vem depois da última publicação: confere de novo antes de sair
+            if (parar.load(std::memory_order_acquire) && publicado.load(std::memory_order_acquire) == lido)
+                break;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+        uint64_t fim = std::min(ate, lido + BLOCO);
+        size_t n = 0;
+        for (uint64_t k = lido; k < fim; ++k)
+            n += codificar(anel[k & (CAPACIDADE - 1)], &buf[n]);
+        consumido.store(fim, std::memory_order_release);
+        lido = fim;
+        // com erro de gravação o anel continua sendo esvaziado, para a VM não travar
+        if (!erro && fwrite(buf.data(), 1, n, arq) != n)
+        {
+            perror(caminho.c_str());
+            erro = true;
+        }
+        n_bytes += n;
+    }
+}
+
+size_t RastroChip8::codificar(const EntradaRastro &e, uint8_t *saida)
+{
+    uint8_t *p = saida + 1;
+    if (e.tipo != RASTRO_INSTRUCAO)
+    {
+        *saida = e.tipo == RASTRO_FRAMES ? MARCA_FRAMES : MARCA_PULO;
+        p = escrever_leb128(p, e.mudou);
+        (e.tipo == RASTRO_FRAMES ? n_frames : n_instrucoes) += e.mudou;
+        return p - saida;
+    }
+
+    uint8_t marca = 0;
+    if (e.pc != pc_previsto)
+    {
+        marca |= MARCA_PC;
+        *p++ = (uint8_t)e.pc;
+        *p++ = (uint8_t)(e.pc >> 8);
+    }
+    *p++ = (uint8_t)(e.opcode >> 8);
+    *p++ = (uint8_t)e.opcode;
+    if (e.mudou)
+    {
+        marca |= MARCA_MUDANCAS;
+        p = escrever_leb128(p, e.mudou);
+        for (uint32_t m = e.mudou & 0xFFFF; m; m &= m - 1)
+            *p++ = e.v[__builtin_ctz(m)];
+        if (e.mudou & MUDOU_I)
+        {
+            *p++ = (uint8_t)e.i;
+            *p++ = (uint8_t)(e.i >> 8);
+        }
+        if (e.mudou & MUDOU_SP)
+            *p++ = e.sp;
+        if (e.mudou & MUDOU_DT)
+            *p++ = e.dt;
+        if (e.mudou & MUDOU_ST)
+            *p++ = e.st;
+    }
+    *saida = marca;
+    pc_previsto = e.pc + 2;
+    ++n_instrucoes;
+    return p - saida;
+}
+
+// ---- leitura --------------------------------------------------------------------------------
+
+LeitorRastro::LeitorRastro() : arq(nullptr), invalido(false)
+{
+    std::memset(&atual, 0, sizeof(atual));
+    atual.pc = 0xFFFE; // a primeira instrução sem pc explícito está em 0 (pc_previsto da gravação)
+}
+
+LeitorRastro::~LeitorRastro()
+{
+    if (arq)
+        fclose(arq);
+}
+
+bool LeitorRastro::abrir(const char *caminho)
+{
+    arq = fopen(caminho, "rb");
+    if (!arq)
+    {
+        perror(caminho);
+        return false;
+    }
+    if (fread(&cab, sizeof(cab), 1, arq) != 1 || cab.magica != MAGICA_RASTRO || cab.versao != VERSAO_RASTRO)
+    {
+        fprintf(stderr, "%s: não é um rastro .c8t versão %u\n", caminho, VERSAO_RASTRO);
+        return false;
+    }
+    return true;
+}
+
+bool LeitorRastro::proximo(RegistroRastro &r)
+{
+    int marca = fgetc(arq);
+    if (marca == EOF)
+        return false;
+
+    if (marca == MARCA_FRAMES || marca == MARCA_PULO)
+    {
+        if (!ler_leb128(arq, atual.n))
+        {
+            invalido = true;
+            return false;
+        }
+        atual.tipo = marca == MARCA_FRAMES ? RASTRO_FRAMES : RASTRO_PULO;
+        r = atual;
+        if (atual.tipo == RASTRO_FRAMES)
+            atual.frame += atual.n;
+        else
+            atual.indice += atual.n;
+        return true;
+    }
+    if (marca & ~(MARCA_PC | MARCA_MUDANCAS))
+    {
+        invalido = true;
+        return false;
+    }
+
+    uint8_t b[2];
+    atual.tipo = RASTRO_INSTRUCAO;
+    atual.n = 0;
+    if (marca & MARCA_PC)
+    {
+        if (fread(b, 1, 2, arq) != 2)
+        {
+            invalido = true;
+            return false;
+        }
+        atual.pc = (uint16_t)(b[0] | b[1] << 8);
+    }
+    else
+    {
+        atual.pc += 2;
+    }
+    if (fread(b, 1, 2, arq) != 2)
+    {
+        invalido = true;
+        return false;
+    }
+    atual.opcode = (uint16_t)(b[0] << 8 | b[1]);
+    atual.mudou = 0;
+    if (marca & MARCA_MUDANCAS)
+    {
+        uint64_t mudou;
+        if (!ler_leb128(arq, mudou) || mudou >= (MUDOU_ST << 1))
+        {
+            invalido = true;
+            return false;
+        }
+        atual.mudou = (uint32_t)mudou;
+        uint8_t valores[16 + 2 + 3];
+        size_t n = __builtin_popcount(atual.mudou & 0xFFFF) + (atual.mudou & MUDOU_I ? 2 : 0) +
+                   __builtin_popcount(atual.mudou & (MUDOU_SP | MUDOU_DT | MUDOU_ST));
+        if (fread(valores, 1, n, arq) != n)
+        {
+            invalido = true;
+            return false;
+        }
+        const uint8_t *p = valores;
+        for (uint32_t m = atual.mudou & 0xFFFF; m; m &= m - 1)
+            atual.v[__builtin_ctz(m)] = *p++;
+        if (atual.mudou & MUDOU_I)
+        {
+            atual.i = (uint16_t)(p[0] | p[1] << 8);
+            p += 2;
+        }
+        if (atual.mudou & MUDOU_SP)
+            atual.sp = *p++;
+        if (atual.mudou & MUDOU_DT)
+            atual.dt = *p++;
+        if (atual.mudou & MUDOU_ST)
+            atual.st = *p++;
+    }
+    r = atual;
+    ++atual.indice;
+    return true;
+}
+
+// ---- desmontagem ----------------------------------------------------------------------------
+
+std::string desmontar_opcode(uint16_t op)
+{
+    unsigned x = (op >> 8) & 0xF, y = (op >> 4) & 0xF, n = op & 0xF, nn = op & 0xFF, nnn = op & 0xFFF;
+    char s[32];
+    switch (op >> 12)
+    {
+    case 0x0:
+        if (op == 0x00E0)
+            return "CLS";
+        if (op == 0x00EE)
+            return "RET";
+        if (op == 0x00FB)
+            return "SCR";
+        if (op == 0x00FC)
+            return "SCL";
+        if (op == 0x00FD)
+            return "EXIT";
+        if (op == 0x00FE)
+            return "LOW";
+        if (op == 0x00FF)
+            return "HIGH";
+        if ((op & 0xFFF0) == 0x00C0)
+            snprintf(s, sizeof(s), "SCD %u", n);
+        else if ((op & 0xFFF0) == 0x00D0)
+            snprintf(s, sizeof(s), "SCU %u", n);
+        else
+            snprintf(s, sizeof(s), "SYS %03X", nnn);
+        break;
+    case 0x1:
+        snprintf(s, sizeof(s), "JP %03X", nnn);
+        break;
+    case 0x2:
+        snprintf(s, sizeof(s), "CALL %03X", nnn);
+        break;
+    case 0x3:
+        snprintf(s, sizeof(s), "SE V%X, %02X", x, nn);
+        break;
+    case 0x4:
+        snprintf(s, sizeof(s), "SNE V%X, %02X", x, nn);
+        break;
+    case 0x5:
+        if (n == 2)
+            snprintf(s, sizeof(s), "SAVE V%X-V%X", x, y);
+        else if (n == 3)
+            snprintf(s, sizeof(s), "LOAD V%X-V%X", x, y);
+        else
+            snprintf(s, sizeof(s), "SE V%X, V%X", x, y);
+        break;
+    case 0x6:
+        snprintf(s, sizeof(s), "LD V%X, %02X", x, nn);
+        break;
+    case 0x7:
+        snprintf(s, sizeof(s), "ADD V%X, %02X", x, nn);
+        break;
+    case 0x8:
+    {
+        static const char *const ALU[16] = {"LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN",
+                                            nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, "SHL", nullptr};
+        if (!ALU[n])
+            snprintf(s, sizeof(s), "DW %04X", op);
+        else
+            snprintf(s, sizeof(s), "%s V%X, V%X", ALU[n], x, y);
+        break;
+    }
+    case 0x9:
+        snprintf(s, sizeof(s), "SNE V%X, V%X", x, y);
+        break;
+    case 0xA:
+        snprintf(s, sizeof(s), "LD I, %03X", nnn);
+        break;
+    case 0xB:
+        snprintf(s, sizeof(s), "JP V0, %03X", nnn);
+        break;
+    case 0xC:
+        snprintf(s, sizeof(s), "RND V%X, %02X", x, nn);
+        break;
+    case 0xD:
+        snprintf(s, sizeof(s), "DRW V%X, V%X, %u", x, y, n);
+        break;
+    case 0xE:
+        if (nn == 0x9E)
+            snprintf(s, sizeof(s), "SKP V%X", x);
+        else if (nn == 0xA1)
+            snprintf(s, sizeof(s), "SKNP V%X", x);
+        else
+            snprintf(s, sizeof(s), "DW %04X", op);
+        break;
+    default:
+        switch (nn)
+        {
+        case 0x00:
+            if (x == 0)
+                return "LD I, NNNN"; // o endereço é a palavra seguinte
+            snprintf(s, sizeof(s), "DW %04X", op);
+            break;
+        case 0x01:
+            snprintf(s, sizeof(s), "PLANE %u", x);
+            break;
+        case 0x02:
+            if (x == 0)
+                return "AUDIO";
+            snprintf(s, sizeof(s), "DW %04X", op);
+            break;
+        case 0x07:
+            snprintf(s, sizeof(s), "LD V%X, DT", x);
+            break;
+        case 0x0A:
+            snprintf(s, sizeof(s), "LD V%X, K", x);
+            break;
+        case 0x15:
+            snprintf(s, sizeof(s), "LD DT, V%X", x);
+            break;
+        case 0x18:
+            snprintf(s, sizeof(s), "LD ST, V%X", x);
+            break;
+        case 0x1E:
+            snprintf(s, sizeof(s), "ADD I, V%X", x);
+            break;
+        case 0x29:
+            snprintf(s, sizeof(s), "LD F, V%X", x);
+            break;
+        case 0x30:
+            snprintf(s, sizeof(s), "LD HF, V%X", x);
+            break;
+        case 0x33:
+            snprintf(s, sizeof(s), "LD B, V%X", x);
+            break;
+        case 0x3A:
+            snprintf(s, sizeof(s), "PITCH V%X", x);
+            break;
+        case 0x55:
+            snprintf(s, sizeof(s), "LD [I], V%X", x);
+            break;
+        case 0x65:
+            snprintf(s, sizeof(s), "LD V%X, [I]", x);
+            break;
+        case 0x75:
+            snprintf(s, sizeof(s), "LD R, V%X", x);
+            break;
+        case 0x85:
+            snprintf(s, sizeof(s), "LD V%X, R", x);
+            break;
+        default:
+            snprintf(s, sizeof(s), "DW %04X", op);
+            break;
+        }
+        break;
+    }
+    return s;
+}
@@ -0,0 +1,163 @@
+#include "../lib/rom.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ROM_MMAP
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+uint64_t hash_rom(const uint8_t *dados, size_t tamanho)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < tamanho; ++i)
+    {
+        h ^= dados[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+ImagemROM::ImagemROM() : ptr(nullptr), tam(0), h(0), mapeada(false)
+{
+}
+
+ImagemROM::~ImagemROM()
+{
+#ifdef ROM_MMAP
+    if (mapeada)
+        munmap((void *)ptr, tam);
+#endif
+}
+
+bool ImagemROM::abrir(const std::string &caminho, std::string &erro)
+{
+    arq = caminho;
+#ifdef ROM_MMAP
+    int fd = open(caminho.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        erro = strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        erro = "não é um arquivo regular";
+        close(fd);
+        return false;
+    }
+    tam = (size_t)st.st_size;
+    if (tam == 0 || tam > TAM_MAX_ROM)
+    {
+        erro = tam == 0 ? "arquivo vazio" : "maior que " + std::to_string(TAM_MAX_ROM) + " bytes";
+        close(fd);
+        return false;
+    }
+    void *m = mmap(nullptr, tam, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // o mapeamento continua válido sem o descritor
+    if (m == MAP_FAILED)
+    {
+        erro = strerror(errno);
+        return false;
+    }
+    ptr = (const uint8_t *)m;
+    mapeada = true;
+#else
+    FILE *f = fopen(caminho.c_str(), "rb");
+    if (!f)
+    {
+        erro = strerror(errno);
+        return false;
+    }
+    // lê um byte além do limite para detectar arquivos grandes demais
+    copia.resize(TAM_MAX_ROM + 1);
+    tam = fread(copia.data(), 1, copia.size(), f);
+    fclose(f);
+    if (tam == 0 || tam > TAM_MAX_ROM)
+    {
+        erro = tam == 0 ? "arquivo vazio" : "maior que " + std::to_string(TAM_MAX_ROM) + " bytes";
+        return false;
+    }
+    copia.resize(tam);
+    ptr = copia.data();
+#endif
+    h = hash_rom(ptr, tam);
+    return true;
+}
+
+const ImagemROM *BibliotecaROM::abrir(const std::string &caminho)
+{
+    auto it = por_caminho.find(caminho);
+    if (it != por_caminho.end())
+        return it->second.get();
+
+    std::unique_ptr<ImagemROM> img(new ImagemROM());
+    std::string erro;
+    if (!img->abrir(caminho, erro))
+    {
+        fprintf(stderr, "%s: %s\n", caminho.c_str(), erro.c_str());
+        return nullptr;
+    }
+    const ImagemROM *p = img.get();
+    por_hash.emplace(p->hash(), p);
+    por_caminho.emplace(caminho, std::move(img));
+    return p;
+}
+
+size_t BibliotecaROM::indexar(const std::string &diretorio)
+{
+    size_t aceitas = 0;
+#ifdef ROM_MMAP
+    DIR *d = opendir(diretorio.c_str());
+    if (!d)
+    {
+        perror(diretorio.c_str());
+        return 0;
+    }
+    std::vector<std::string> nomes;
+    while (struct dirent *e = readdir(d))
+    {
+        if (e->d_name[0] != '.')
+            nomes.push_back(e->d_name);
+    }
+    closedir(d);
+    std::sort(nomes.begin(), nomes.end());
+    for (const std::string &nome : nomes)
+    {
+        if (abrir(diretorio + "/" + nome))
+            ++aceitas;
+    }
+#else
+    fprintf(stderr, "%s: indexação de diretório não suportada nesta plataforma\n", diretorio.c_str());
+#endif
+    return aceitas;
+}
+
+const ImagemROM *BibliotecaROM::buscar_hash(uint64_t hash) const
+{
+    auto it = por_hash.find(hash);
+    return it == por_hash.end() ? nullptr : it->second;
+}
+
+void BibliotecaROM::imprimir_indice(FILE *saida) const
+{
+    for (const auto &par : por_caminho)
+    {
+        const ImagemROM &img = *par.second;
+        fprintf(saida, "%016llx %4zu %s\n", (unsigned long long)img.hash(), img.tamanho(), img.caminho().c_str());
+    }
+}
+
+std::vector<const ImagemROM *> BibliotecaROM::imagens() const
+{
+    std::vector<const ImagemROM *> v;
+    for (const auto &par : por_caminho)
+        v.push_back(par.second.get());
+    return v;
+}
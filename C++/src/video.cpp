@@ -0,0 +1,588 @@
+#include "../lib/video.hpp"
+#include "../lib/escalonador.hpp"
+#include <algorithm>
+#include <chrono>
+
+// Mesmos tons da janela (tela.hpp): fundo, só plano 0, só plano 1, os dois
+static const uint8_t CINZA[4] = {0x00, 0xFF, 0xAA, 0x55};
+
+FormatoVideo formato_video(const std::string &caminho)
+{
+    auto termina = [&](const char *ext)
+    {
+        size_t n = strlen(ext);
+        return caminho.size() >= n && caminho.compare(caminho.size() - n, n, ext) == 0;
+    };
+    if (termina(".c8v"))
+        return VIDEO_C8V;
+    if (termina(".y4m"))
+        return VIDEO_Y4M;
+    return VIDEO_PNG;
+}
+
+int QuadroVideo::pixel(int x, int y) const
+{
+    int por_linha = largura / 64;
+    int cor = 0;
+    for (int p = 0; p < planos; ++p)
+    {
+        uint64_t w = palavras[(p * altura + y) * por_linha + x / 64];
+        cor |= (int)((w >> (63 - x % 64)) & 1) << p;
+    }
+    return cor;
+}
+
+static void acrescentar_leb128(std::vector<uint8_t> &v, uint64_t x)
+{
+    do
+    {
+        uint8_t b = x & 0x7F;
+        x >>= 7;
+        v.push_back(b | (x ? 0x80 : 0));
+    } while (x);
+}
+
+static bool ler_leb128(FILE *f, uint64_t &x)
+{
+    x = 0;
+    for (int desloc = 0; desloc <= 63; desloc += 7)
+    {
+        int c = fgetc(f);
+        if (c == EOF)
+            return false;
+        x |= (uint64_t)(c & 0x7F) << desloc;
+        if (!(c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static bool ler_leb128(const uint8_t *&p, const uint8_t *fim, uint64_t &x)
+{
+    x = 0;
+    for (int desloc = 0; desloc <= 63 && p < fim; desloc += 7)
+    {
+        uint8_t c = *p++;
+        x |= (uint64_t)(c & 0x7F) << desloc;
+        if (!(c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// Corridas de um bloco de bytes (ver o formato em video.hpp). Um zero isolado fica dentro dos
+// literais: abrir um par novo custaria mais que ele.
+static void codificar_corridas(const uint8_t *bytes, size_t n, std::vector<uint8_t> &saida)
+{
+    size_t i = 0;
+    while (i < n)
+    {
+        size_t z = i;
+        while (z < n && bytes[z] == 0)
+            ++z;
+        if (z == n)
+            break;
+        size_t l = z;
+        while (l < n && !(bytes[l] == 0 && l + 1 < n && bytes[l + 1] == 0))
+            ++l;
+        acrescentar_leb128(saida, z - i);
+        acrescentar_leb128(saida, l - z);
+        saida.insert(saida.end(), bytes + z, bytes + l);
+        i = l;
+    }
+}
+
+// Aplica as corridas com XOR sobre bytes; false se passam do tamanho do quadro
+static bool aplicar_corridas(const uint8_t *p, const uint8_t *fim, uint8_t *bytes, size_t n)
+{
+    size_t i = 0;
+    while (p < fim)
+    {
+        uint64_t zeros, literais;
+        if (!ler_leb128(p, fim, zeros) || !ler_leb128(p, fim, literais) ||
+            zeros > n - i || literais > n - i - zeros || literais > (uint64_t)(fim - p))
+            return false;
+        i += zeros;
+        for (uint64_t k = 0; k < literais; ++k)
+            bytes[i++] ^= *p++;
+    }
+    return true;
+}
+
+static void palavras_para_bytes(const QuadroVideo &q, const uint64_t *xor_com, uint8_t *bytes)
+{
+    for (int i = 0; i < q.n_palavras(); ++i)
+    {
+        uint64_t w = q.palavras[i] ^ (xor_com ? xor_com[i] : 0);
+        for (int b = 0; b < 8; ++b)
+            bytes[i * 8 + b] = (uint8_t)(w >> (56 - 8 * b));
+    }
+}
+
+// ---- PNG sem compressão (blocos "stored" do deflate) --------------------------------------
+
+static uint32_t crc32_png(const uint8_t *dados, size_t n, uint32_t crc = 0)
+{
+    static uint32_t tabela[256];
+    static bool pronta = false;
+    if (!pronta)
+    {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            tabela[i] = c;
+        }
+        pronta = true;
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < n; ++i)
+        crc = tabela[(crc ^ dados[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void acrescentar_be32(std::vector<uint8_t> &v, uint32_t x)
+{
+    for (int b = 24; b >= 0; b -= 8)
+        v.push_back((uint8_t)(x >> b));
+}
+
+static void acrescentar_bloco_png(std::vector<uint8_t> &png, const char *tipo, const uint8_t *dados, size_t n)
+{
+    acrescentar_be32(png, (uint32_t)n);
+    size_t inicio = png.size();
+    png.insert(png.end(), tipo, tipo + 4);
+    png.insert(png.end(), dados, dados + n);
+    acrescentar_be32(png, crc32_png(&png[inicio], n + 4));
+}
+
+// ---- gravador -------------------------------------------------------------------------------
+
+GravadorVideo::GravadorVideo() : arq(nullptr), erro(false), escala(1), n_quadros(0), n_bytes(0), repeticoes(0), desde_chave(0)
+{
+}
+
+GravadorVideo::~GravadorVideo()
+{
+    if (arq)
+        fechar();
+}
+
+bool GravadorVideo::abrir(const std::string &caminho, FormatoVideo formato, int largura, int altura, int planos, int escala)
+{
+    this->caminho = caminho;
+    this->formato = formato;
+    this->escala = std::max(1, escala);
+    anterior.largura = largura;
+    anterior.altura = altura;
+    anterior.planos = planos;
+    n_quadros = n_bytes = repeticoes = desde_chave = 0;
+    erro = false;
+    if (formato == VIDEO_PNG)
+        return true; // um arquivo por quadro
+
+    arq = fopen(caminho.c_str(), "wb");
+    if (!arq)
+    {
+        perror(caminho.c_str());
+        return false;
+    }
+    if (formato == VIDEO_C8V)
+    {
+        CabecalhoVideo cab;
+        std::memset(&cab, 0, sizeof(cab));
+        cab.magica = MAGICA_VIDEO;
+        cab.versao = VERSAO_VIDEO;
+        cab.largura = (uint16_t)largura;
+        cab.altura = (uint16_t)altura;
+        cab.planos = (uint16_t)planos;
+        cab.quadros_por_segundo = 60;
+        escrever(&cab, sizeof(cab));
+    }
+    else
+    {
+        char cab[128];
+        int n = snprintf(cab, sizeof(cab), "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n",
+                         largura * this->escala, altura * this->escala);
+        escrever(cab, (size_t)n);
+    }
+    return !erro;
+}
+
+void GravadorVideo::escrever(const void *dados, size_t n)
+{
+    if (!erro && fwrite(dados, 1, n, arq) != n)
+    {
+        perror(caminho.c_str());
+        erro = true;
+    }
+    n_bytes += n;
+}
+
+void GravadorVideo::quadro(const QuadroVideo &q)
+{
+    size_t n = (size_t)q.n_palavras();
+    if (n_quadros > 0 && std::memcmp(q.palavras, anterior.palavras, n * sizeof(uint64_t)) == 0)
+    {
+        repetir(1);
+        return;
+    }
+
+    if (formato == VIDEO_C8V)
+    {
+        emitir_repeticoes();
+        bool chave = n_quadros == 0 || desde_chave >= INTERVALO_CHAVE;
+        uint8_t bytes[sizeof(q.palavras)];
+        palavras_para_bytes(q, chave ? nullptr : anterior.palavras, bytes);
+        std::vector<uint8_t> corridas;
+        codificar_corridas(bytes, n * sizeof(uint64_t), corridas);
+        codificado.clear();
+        codificado.push_back(chave ? REGISTRO_CHAVE : REGISTRO_DELTA);
+        acrescentar_leb128(codificado, corridas.size());
+        codificado.insert(codificado.end(), corridas.begin(), corridas.end());
+        escrever(codificado.data(), codificado.size());
+        desde_chave = chave ? 1 : desde_chave + 1;
+    }
+    else
+    {
+        if (formato == VIDEO_Y4M)
+            codificar_y4m(q);
+        else
+            codificar_png(q);
+        gravar_codificado();
+    }
+    std::memcpy(anterior.palavras, q.palavras, n * sizeof(uint64_t));
+    ++n_quadros;
+}
+
+void GravadorVideo::repetir(uint64_t n)
+{
+    if (n_quadros == 0 || n == 0)
+        return;
+    if (formato == VIDEO_C8V)
+    {
+        repeticoes += n;
+        desde_chave += n;
+        n_quadros += n;
+        return;
+    }
+    for (uint64_t i = 0; i < n && !erro; ++i)
+    {
+        gravar_codificado();
+        ++n_quadros;
+    }
+}
+
+void GravadorVideo::emitir_repeticoes()
+{
+    if (!repeticoes)
+        return;
+    std::vector<uint8_t> reg;
+    reg.push_back(REGISTRO_REPETIR);
+    acrescentar_leb128(reg, repeticoes);
+    escrever(reg.data(), reg.size());
+    repeticoes = 0;
+}
+
+// Plano Y em tons de cinza e U/V neutros; a escala repete cada linha e coluna
+void GravadorVideo::codificar_y4m(const QuadroVideo &q)
+{
+    int w = q.largura * escala, h = q.altura * escala;
+    const char cab_quadro[] = "FRAME\n";
+    codificado.assign(cab_quadro, cab_quadro + 6);
+    size_t inicio_y = codificado.size();
+    codificado.resize(inicio_y + (size_t)w * h + 2 * (size_t)(w / 2) * (h / 2), 128);
+    for (int y = 0; y < q.altura; ++y)
+    {
+        uint8_t *linha = &codificado[inicio_y + (size_t)y * escala * w];
+        for (int x = 0; x < q.largura; ++x)
+            std::memset(linha + x * escala, CINZA[q.pixel(x, y)], escala);
+        for (int k = 1; k < escala; ++k)
+            std::memcpy(linha + (size_t)k * w, linha, w);
+    }
+}
+
+// PNG com paleta de 1 bit por pixel (2 bits com dois planos), dados sem compressão
+void GravadorVideo::codificar_png(const QuadroVideo &q)
+{
+    static const uint8_t ASSINATURA[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    int w = q.largura * escala, h = q.altura * escala;
+    int bits = q.planos > 1 ? 2 : 1;
+    size_t bytes_linha = ((size_t)w * bits + 7) / 8;
+
+    codificado.assign(ASSINATURA, ASSINATURA + 8);
+
+    uint8_t ihdr[13];
+    for (int b = 0; b < 4; ++b)
+    {
+        ihdr[b] = (uint8_t)(w >> (24 - 8 * b));
+        ihdr[4 + b] = (uint8_t)(h >> (24 - 8 * b));
+    }
+    ihdr[8] = (uint8_t)bits;
+    ihdr[9] = 3; // paleta
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+    acrescentar_bloco_png(codificado, "IHDR", ihdr, sizeof(ihdr));
+
+    uint8_t plte[12];
+    int cores = 1 << bits;
+    for (int c = 0; c < cores; ++c)
+        plte[3 * c] = plte[3 * c + 1] = plte[3 * c + 2] = CINZA[c];
+    acrescentar_bloco_png(codificado, "PLTE", plte, (size_t)cores * 3);
+
+    // imagem: cada linha com o filtro 0 na frente
+    std::vector<uint8_t> bruto((bytes_linha + 1) * h, 0);
+    for (int y = 0; y < h; ++y)
+    {
+        uint8_t *linha = &bruto[(bytes_linha + 1) * y + 1];
+        for (int x = 0; x < w; ++x)
+        {
+            int cor = q.pixel(x / escala, y / escala);
+            int pos = x * bits;
+            linha[pos / 8] |= (uint8_t)(cor << (8 - bits - pos % 8));
+        }
+    }
+
+    // zlib: cabeçalho, blocos "stored" de até 65535 bytes e Adler-32
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    size_t feito = 0;
+    do
+    {
+        size_t n = std::min<size_t>(bruto.size() - feito, 65535);
+        bool ultimo = feito + n == bruto.size();
+        zlib.push_back(ultimo ? 1 : 0);
+        zlib.push_back((uint8_t)n);
+        zlib.push_back((uint8_t)(n >> 8));
+        zlib.push_back((uint8_t)~n);
+        zlib.push_back((uint8_t)(~n >> 8));
+        zlib.insert(zlib.end(), bruto.begin() + feito, bruto.begin() + feito + n);
+        feito += n;
+    } while (feito < bruto.size());
+    uint32_t a = 1, b = 0;
+    for (uint8_t c : bruto)
+    {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    acrescentar_be32(zlib, (b << 16) | a);
+    acrescentar_bloco_png(codificado, "IDAT", zlib.data(), zlib.size());
+    acrescentar_bloco_png(codificado, "IEND", nullptr, 0);
+}
+
+// Y4M anexa ao arquivo único; PNG cria o arquivo do quadro n_quadros
+void GravadorVideo::gravar_codificado()
+{
+    if (formato == VIDEO_Y4M)
+    {
+        escrever(codificado.data(), codificado.size());
+        return;
+    }
+    char nome[32];
+    snprintf(nome, sizeof(nome), "/%06llu.png", (unsigned long long)n_quadros);
+    std::string arquivo = caminho + nome;
+    arq = fopen(arquivo.c_str(), "wb");
+    if (!arq)
+    {
+        if (!erro)
+            perror(arquivo.c_str());
+        erro = true;
+        return;
+    }
+    escrever(codificado.data(), codificado.size());
+    if (fclose(arq) != 0)
+        erro = true;
+    arq = nullptr;
+}
+
+bool GravadorVideo::fechar()
+{
+    if (formato == VIDEO_C8V && arq)
+    {
+        emitir_repeticoes();
+        // o número de quadros só é conhecido agora
+        size_t pos = offsetof(CabecalhoVideo, quadros);
+        if (fseek(arq, (long)pos, SEEK_SET) != 0 || fwrite(&n_quadros, sizeof(n_quadros), 1, arq) != 1)
+            erro = true;
+    }
+    if (arq && fclose(arq) != 0)
+        erro = true;
+    arq = nullptr;
+    return !erro;
+}
+
+// ---- leitor ---------------------------------------------------------------------------------
+
+LeitorVideo::LeitorVideo() : arq(nullptr), repeticoes(0), invalido(false)
+{
+}
+
+LeitorVideo::~LeitorVideo()
+{
+    if (arq)
+        fclose(arq);
+}
+
+bool LeitorVideo::abrir(const char *caminho)
+{
+    arq = fopen(caminho, "rb");
+    if (!arq)
+    {
+        perror(caminho);
+        return false;
+    }
+    if (fread(&cab, sizeof(cab), 1, arq) != 1 || cab.magica != MAGICA_VIDEO || cab.versao != VERSAO_VIDEO ||
+        (cab.largura != LARGURA_TELA && cab.largura != LARGURA_ALTA) ||
+        cab.altura != cab.largura / 2 || cab.planos < 1 || cab.planos > PLANOS)
+    {
+        fprintf(stderr, "%s: não é um vídeo .c8v versão %u\n", caminho, VERSAO_VIDEO);
+        return false;
+    }
+    atual.largura = cab.largura;
+    atual.altura = cab.altura;
+    atual.planos = cab.planos;
+    std::memset(atual.palavras, 0, sizeof(atual.palavras));
+    return true;
+}
+
+bool LeitorVideo::proximo(QuadroVideo &q)
+{
+    // um laço e não recursão: um arquivo com muitos REPETIR 0 seguidos não esgota a pilha
+    while (!repeticoes)
+    {
+        int tipo = fgetc(arq);
+        if (tipo == EOF)
+            return false;
+        uint64_t n;
+        if (!ler_leb128(arq, n))
+        {
+            invalido = true;
+            return false;
+        }
+        if (tipo == REGISTRO_REPETIR)
+        {
+            repeticoes = n;
+        }
+        else if (tipo == REGISTRO_DELTA || tipo == REGISTRO_CHAVE)
+        {
+            // o tamanho vem do arquivo: limita antes de alocar
+            size_t tam = (size_t)atual.n_palavras() * sizeof(uint64_t);
+            if (n > 16 * tam)
+            {
+                invalido = true;
+                return false;
+            }
+            std::vector<uint8_t> corridas(n);
+            uint8_t bytes[sizeof(atual.palavras)];
+            palavras_para_bytes(atual, nullptr, bytes);
+            if (tipo == REGISTRO_CHAVE)
+                std::memset(bytes, 0, tam);
+            if (fread(corridas.data(), 1, n, arq) != n ||
+                !aplicar_corridas(corridas.data(), corridas.data() + n, bytes, tam))
+            {
+                invalido = true;
+                return false;
+            }
+            for (int i = 0; i < atual.n_palavras(); ++i)
+            {
+                uint64_t w = 0;
+                for (int b = 0; b < 8; ++b)
+                    w = (w << 8) | bytes[i * 8 + b];
+                atual.palavras[i] = w;
+            }
+            repeticoes = 1;
+        }
+        else
+        {
+            invalido = true;
+            return false;
+        }
+    }
+    --repeticoes;
+    q = atual;
+    return true;
+}
+
+// ---- execução e conversão -------------------------------------------------------------------
+
+ResultadoHeadless exportar_video(Chip8 &vm, int hz, int instr_por_frame, uint64_t frames,
+                                 const std::vector<EventoTecla> &eventos, GravadorVideo &video)
+{
+    ResultadoHeadless res = {0, 0, 0, 0.0};
+    DivisorCiclos ciclos(hz, instr_por_frame);
+    size_t prox_evento = 0;
+
+    QuadroVideo q;
+    q.largura = vm.ext ? LARGURA_ALTA : LARGURA_TELA;
+    q.altura = vm.ext ? ALTURA_ALTA : ALTURA_TELA;
+    q.planos = vm.quirks == QUIRKS_XOCHIP ? PLANOS : 1; // o SUPER-CHIP só usa o plano 0
+    // copia a tela só quando algo foi desenhado; o gravador ainda descarta os quadros iguais
+    auto capturar = [&]()
+    {
+        if (!vm.linhas_sujas && video.quadros() > 0)
+        {
+            video.repetir(1);
+            return;
+        }
+        if (vm.ext)
+            std::memcpy(q.palavras, vm.ext->tela, sizeof(vm.ext->tela));
+        else
+            std::memcpy(q.palavras, vm.tela, sizeof(vm.tela));
+        vm.linhas_sujas = 0;
+        video.quadro(q);
+    };
+
+    auto t_inicio = std::chrono::steady_clock::now();
+
+    for (res.frames = 0; res.frames < frames; ++res.frames)
+    {
+        while (prox_evento < eventos.size() && eventos[prox_evento].frame <= res.frames)
+        {
+            const EventoTecla &ev = eventos[prox_evento++];
+            vm.VM_DefinirTecla(ev.tecla, ev.pressionada);
+        }
+
+        // parada em FX0A: a tela não muda até o próximo evento
+        if (vm.VM_AguardandoTecla())
+        {
+            uint64_t ate = prox_evento < eventos.size() ? std::min(eventos[prox_evento].frame, frames) : frames;
+            if (ate > res.frames)
+            {
+                uint64_t pular = ate - res.frames;
+                vm.VM_AvancarOcioso(pular);
+                res.puladas += ciclos.avancar(pular);
+                capturar();
+                video.repetir(pular - 1);
+                res.frames += pular - 1; // o ++ do for completa o salto
+                continue;
+            }
+        }
+
+        uint32_t a_executar = ciclos.proximo();
+        uint32_t executadas = vm.VM_Executar(a_executar);
+        res.instrucoes += executadas;
+        res.puladas += a_executar - executadas;
+        vm.tickTimers();
+        capturar();
+    }
+
+    std::chrono::duration<double> dur = std::chrono::steady_clock::now() - t_inicio;
+    res.segundos = dur.count();
+    return res;
+}
+
+bool converter_video(const char *entrada, const std::string &saida, int escala)
+{
+    LeitorVideo leitor;
+    if (!leitor.abrir(entrada))
+        return false;
+    const CabecalhoVideo &cab = leitor.cabecalho();
+    GravadorVideo gravador;
+    if (!gravador.abrir(saida, formato_video(saida), cab.largura, cab.altura, cab.planos, escala))
+        return false;
+    QuadroVideo q;
+    while (leitor.proximo(q))
+        gravador.quadro(q);
+    if (leitor.erro())
+        fprintf(stderr, "%s: vídeo truncado depois de %llu quadros\n", entrada, (unsigned long long)gravador.quadros());
+    return gravador.fechar() && !leitor.erro();
+}